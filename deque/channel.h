@@ -0,0 +1,392 @@
+#ifndef DEQUE__CHANNEL_H_
+#define DEQUE__CHANNEL_H_
+
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <sys/types.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../list/intrusive_list.h"
+#include "deque.h"
+
+// Runs coroutines handed to schedule(). A coroutine may be scheduled from
+// any thread, and is resumed exactly once per schedule() call.
+class Executor {
+public:
+  virtual ~Executor() = default;
+  virtual void schedule(std::coroutine_handle<> handle) = 0;
+};
+
+// Executor for a single thread: run() resumes the scheduled coroutines on the
+// calling thread until none is left. Not thread-safe.
+class SingleThreadExecutor : public Executor {
+public:
+  void schedule(std::coroutine_handle<> handle) override;
+  void run();
+
+private:
+  Deque<std::coroutine_handle<>> ready_;
+};
+
+// Executor resuming coroutines on a fixed set of threads. The destructor
+// lets the threads finish every coroutine scheduled so far, then joins them.
+class ThreadPoolExecutor : public Executor {
+public:
+  explicit ThreadPoolExecutor(size_t threads);
+  ThreadPoolExecutor(const ThreadPoolExecutor &other) = delete;
+  ~ThreadPoolExecutor() override;
+
+  ThreadPoolExecutor &operator=(const ThreadPoolExecutor &other) = delete;
+
+  void schedule(std::coroutine_handle<> handle) override;
+
+private:
+  void Work();
+
+  std::mutex mutex_;
+  std::condition_variable wake_up_;
+  Deque<std::coroutine_handle<>> ready_;
+  bool stopping_ = false;
+  std::vector<std::thread> threads_;
+};
+
+// Fire-and-forget coroutine. It starts suspended and runs once passed to
+// Spawn; its frame is freed when the body returns.
+class Task {
+public:
+  struct promise_type {
+    Task get_return_object() {
+      return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+
+  Task(Task &&other) noexcept;
+  Task(const Task &other) = delete;
+  ~Task();
+
+  Task &operator=(const Task &other) = delete;
+
+private:
+  friend void Spawn(Executor &executor, Task task);
+
+  explicit Task(std::coroutine_handle<promise_type> handle);
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+void Spawn(Executor &executor, Task task);
+
+// Bounded multi-producer multi-consumer queue for coroutines, buffering up
+// to capacity elements in a Deque:
+//
+//   co_await channel.push(value);           // false once closed
+//   std::optional<T> value = co_await channel.pop();  // nullopt once closed
+//                                                     // and drained
+//
+// push suspends while the buffer is full and pop while it is empty; a
+// channel of capacity zero hands every element from a pusher to a popper.
+// When an operation completes a waiting one, the awaiting coroutine
+// transfers control straight to the waiter on the same thread and is itself
+// scheduled on the executor. A suspended push or pop must not be destroyed.
+//
+// The buffer, like the ready queues of the executors, pushes at the back of
+// a Deque and pops at its front, which hands emptied chunks on to the back
+// and recentres its map, so memory stays in proportion to what is queued
+// however long the stream.
+template <typename T> class Channel {
+public:
+  class PushAwaiter;
+  class PopAwaiter;
+
+  Channel(size_t capacity, Executor &executor);
+  Channel(const Channel &other) = delete;
+
+  Channel &operator=(const Channel &other) = delete;
+
+  [[nodiscard]] PushAwaiter push(T value);
+  [[nodiscard]] PopAwaiter pop();
+  // Fails every waiting and later push and lets pop drain what is buffered.
+  void close();
+
+  [[nodiscard]] size_t size() const;
+  [[nodiscard]] size_t capacity() const;
+
+  class PushAwaiter {
+  public:
+    bool await_ready();
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> handle);
+    bool await_resume();
+
+  private:
+    friend class Channel;
+
+    PushAwaiter(Channel &channel, T &&value);
+
+    Channel &channel_;
+    T value_;
+    bool result_ = true;
+    std::unique_lock<std::mutex> lock_;
+    std::coroutine_handle<> handle_;
+    std::coroutine_handle<> woken_;
+    IntrusiveListHook hook_;
+  };
+
+  class PopAwaiter {
+  public:
+    bool await_ready();
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> handle);
+    std::optional<T> await_resume();
+
+  private:
+    friend class Channel;
+
+    explicit PopAwaiter(Channel &channel);
+
+    Channel &channel_;
+    std::optional<T> value_;
+    std::unique_lock<std::mutex> lock_;
+    std::coroutine_handle<> handle_;
+    std::coroutine_handle<> woken_;
+    IntrusiveListHook hook_;
+  };
+
+private:
+  size_t capacity_;
+  Executor &executor_;
+  mutable std::mutex mutex_;
+  Deque<T> buffer_;
+  bool closed_ = false;
+  IntrusiveList<PushAwaiter, &PushAwaiter::hook_> pushers_;
+  IntrusiveList<PopAwaiter, &PopAwaiter::hook_> poppers_;
+};
+
+inline void SingleThreadExecutor::schedule(std::coroutine_handle<> handle) {
+  ready_.push_back(handle);
+}
+
+inline void SingleThreadExecutor::run() {
+  while (ready_.size() != 0) {
+    auto handle = ready_[0];
+    ready_.pop_front();
+    handle.resume();
+  }
+}
+
+inline ThreadPoolExecutor::ThreadPoolExecutor(size_t threads) {
+  threads_.reserve(threads);
+  for (size_t i = 0; i < threads; ++i) {
+    threads_.emplace_back(&ThreadPoolExecutor::Work, this);
+  }
+}
+
+inline ThreadPoolExecutor::~ThreadPoolExecutor() {
+  {
+    std::lock_guard lock(mutex_);
+    stopping_ = true;
+  }
+  wake_up_.notify_all();
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+}
+
+inline void ThreadPoolExecutor::schedule(std::coroutine_handle<> handle) {
+  {
+    std::lock_guard lock(mutex_);
+    ready_.push_back(handle);
+  }
+  wake_up_.notify_one();
+}
+
+inline void ThreadPoolExecutor::Work() {
+  while (true) {
+    std::coroutine_handle<> handle;
+    {
+      std::unique_lock lock(mutex_);
+      wake_up_.wait(lock, [this] { return stopping_ || ready_.size() != 0; });
+      if (ready_.size() == 0) {
+        return;
+      }
+      handle = ready_[0];
+      ready_.pop_front();
+    }
+    handle.resume();
+  }
+}
+
+inline Task::Task(std::coroutine_handle<promise_type> handle)
+    : handle_(handle) {}
+
+inline Task::Task(Task &&other) noexcept
+    : handle_(std::exchange(other.handle_, nullptr)) {}
+
+inline Task::~Task() {
+  if (handle_) {
+    handle_.destroy();
+  }
+}
+
+inline void Spawn(Executor &executor, Task task) {
+  executor.schedule(std::exchange(task.handle_, nullptr));
+}
+
+template <typename T>
+Channel<T>::Channel(size_t capacity, Executor &executor)
+    : capacity_(capacity), executor_(executor) {}
+
+template <typename T>
+typename Channel<T>::PushAwaiter Channel<T>::push(T value) {
+  return PushAwaiter(*this, std::move(value));
+}
+
+template <typename T> typename Channel<T>::PopAwaiter Channel<T>::pop() {
+  return PopAwaiter(*this);
+}
+
+template <typename T> void Channel<T>::close() {
+  Deque<std::coroutine_handle<>> woken;
+  {
+    std::lock_guard lock(mutex_);
+    closed_ = true;
+    while (!pushers_.empty()) {
+      auto &pusher = pushers_.front();
+      pushers_.pop_front();
+      pusher.result_ = false;
+      woken.push_back(pusher.handle_);
+    }
+    while (!poppers_.empty()) {
+      auto &popper = poppers_.front();
+      poppers_.pop_front();
+      woken.push_back(popper.handle_);
+    }
+  }
+  for (auto handle : woken) {
+    executor_.schedule(handle);
+  }
+}
+
+template <typename T> size_t Channel<T>::size() const {
+  std::lock_guard lock(mutex_);
+  return buffer_.size();
+}
+
+template <typename T> size_t Channel<T>::capacity() const {
+  return capacity_;
+}
+
+template <typename T>
+Channel<T>::PushAwaiter::PushAwaiter(Channel &channel, T &&value)
+    : channel_(channel), value_(std::move(value)) {}
+
+// Decides under the channel lock whether the push completes right away. If
+// it has to wait, the lock stays held until await_suspend queues it.
+template <typename T> bool Channel<T>::PushAwaiter::await_ready() {
+  lock_ = std::unique_lock(channel_.mutex_);
+  if (channel_.closed_) {
+    result_ = false;
+    lock_.unlock();
+    return true;
+  }
+  if (!channel_.poppers_.empty()) {
+    // A popper only waits on an empty buffer, so it takes this value.
+    auto &popper = channel_.poppers_.front();
+    channel_.poppers_.pop_front();
+    popper.value_.emplace(std::move(value_));
+    woken_ = popper.handle_;
+    lock_.unlock();
+    return false;
+  }
+  if (channel_.buffer_.size() < channel_.capacity_) {
+    channel_.buffer_.emplace_back(std::move(value_));
+    lock_.unlock();
+    return true;
+  }
+  return false;
+}
+
+template <typename T>
+std::coroutine_handle<>
+Channel<T>::PushAwaiter::await_suspend(std::coroutine_handle<> handle) {
+  if (woken_) {
+    auto woken = woken_;
+    channel_.executor_.schedule(handle);
+    return woken;
+  }
+  handle_ = handle;
+  channel_.pushers_.push_back(*this);
+  // Once the mutex is free another thread may resume and destroy this
+  // awaiter, so lock_ must not be touched after unlocking.
+  lock_.release()->unlock();
+  return std::noop_coroutine();
+}
+
+template <typename T> bool Channel<T>::PushAwaiter::await_resume() {
+  return result_;
+}
+
+template <typename T>
+Channel<T>::PopAwaiter::PopAwaiter(Channel &channel) : channel_(channel) {}
+
+// Same protocol as PushAwaiter::await_ready.
+template <typename T> bool Channel<T>::PopAwaiter::await_ready() {
+  lock_ = std::unique_lock(channel_.mutex_);
+  auto &buffer = channel_.buffer_;
+  if (buffer.size() != 0) {
+    value_.emplace(std::move(buffer[0]));
+    buffer.pop_front();
+    if (!channel_.pushers_.empty()) {
+      // The freed slot goes to the longest waiting pusher.
+      auto &pusher = channel_.pushers_.front();
+      channel_.pushers_.pop_front();
+      buffer.emplace_back(std::move(pusher.value_));
+      woken_ = pusher.handle_;
+    }
+    lock_.unlock();
+    return !woken_;
+  }
+  if (!channel_.pushers_.empty()) {
+    // Only happens without a buffer: take the value from the pusher.
+    auto &pusher = channel_.pushers_.front();
+    channel_.pushers_.pop_front();
+    value_.emplace(std::move(pusher.value_));
+    woken_ = pusher.handle_;
+    lock_.unlock();
+    return false;
+  }
+  if (channel_.closed_) {
+    lock_.unlock();
+    return true;
+  }
+  return false;
+}
+
+template <typename T>
+std::coroutine_handle<>
+Channel<T>::PopAwaiter::await_suspend(std::coroutine_handle<> handle) {
+  if (woken_) {
+    auto woken = woken_;
+    channel_.executor_.schedule(handle);
+    return woken;
+  }
+  handle_ = handle;
+  channel_.poppers_.push_back(*this);
+  lock_.release()->unlock();
+  return std::noop_coroutine();
+}
+
+template <typename T> std::optional<T> Channel<T>::PopAwaiter::await_resume() {
+  return std::move(value_);
+}
+
+#endif // DEQUE__CHANNEL_H_
@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "channel.h"
+#include "heap_counter_test_util.h"
+
+namespace {
+
+Task Produce(Channel<int> &channel, int count, bool close) {
+  for (int i = 0; i < count; ++i) {
+    bool pushed = co_await channel.push(i);
+    EXPECT_TRUE(pushed);
+  }
+  if (close) {
+    channel.close();
+  }
+}
+
+Task Consume(Channel<int> &channel, std::atomic<long> &sum,
+             std::atomic<int> &count) {
+  while (auto value = co_await channel.pop()) {
+    sum += *value;
+    ++count;
+  }
+}
+
+Task Forward(Channel<int> &in, Channel<int> &out) {
+  while (auto value = co_await in.pop()) {
+    co_await out.push(*value + 1);
+  }
+  out.close();
+}
+
+Task PushAfterClose(Channel<std::unique_ptr<std::string>> &channel) {
+  co_await channel.push(std::make_unique<std::string>("hello"));
+  channel.close();
+  bool pushed = co_await channel.push(nullptr);
+  EXPECT_FALSE(pushed);
+}
+
+Task PopStrings(Channel<std::unique_ptr<std::string>> &channel,
+                std::vector<std::string> &values) {
+  while (auto value = co_await channel.pop()) {
+    values.push_back(**value);
+  }
+}
+
+class ChannelCapacityTest : public ::testing::TestWithParam<size_t> {};
+
+TEST_P(ChannelCapacityTest, PipelineDeliversEveryValue) {
+  const int kStages = 8;
+  const int kValues = 3000;
+  SingleThreadExecutor executor;
+  std::vector<std::unique_ptr<Channel<int>>> channels;
+  for (int i = 0; i <= kStages; ++i) {
+    channels.push_back(std::make_unique<Channel<int>>(GetParam(), executor));
+  }
+  std::atomic<long> sum{0};
+  std::atomic<int> count{0};
+  for (int i = 0; i < kStages; ++i) {
+    Spawn(executor, Forward(*channels[i], *channels[i + 1]));
+  }
+  Spawn(executor, Consume(*channels[kStages], sum, count));
+  Spawn(executor, Produce(*channels[0], kValues, true));
+  executor.run();
+  EXPECT_EQ(count, kValues);
+  EXPECT_EQ(sum, static_cast<long>(kValues) * (kValues - 1) / 2 +
+                     static_cast<long>(kValues) * kStages);
+}
+
+TEST_P(ChannelCapacityTest, ThreadPoolDeliversEveryValue) {
+  std::atomic<long> sum{0};
+  std::atomic<int> count{0};
+  auto executor = std::make_unique<ThreadPoolExecutor>(3);
+  Channel<int> channel(GetParam(), *executor);
+  for (int i = 0; i < 4; ++i) {
+    Spawn(*executor, Produce(channel, 500, false));
+  }
+  for (int i = 0; i < 4; ++i) {
+    Spawn(*executor, Consume(channel, sum, count));
+  }
+  while (count < 2000) {
+    std::this_thread::yield();
+  }
+  channel.close();
+  // The consumers close() woke still pop from the channel, so they have to
+  // finish before it is destroyed.
+  executor.reset();
+  EXPECT_EQ(sum, 4l * 499 * 500 / 2);
+}
+
+INSTANTIATE_TEST_SUITE_P(Capacities, ChannelCapacityTest,
+                         ::testing::Values(0, 1, 4, 64));
+
+TEST(ChannelTest, CloseFailsPushesAndDrainsPops) {
+  SingleThreadExecutor executor;
+  Channel<std::unique_ptr<std::string>> channel(0, executor);
+  std::vector<std::string> values;
+  Spawn(executor, PopStrings(channel, values));
+  Spawn(executor, PushAfterClose(channel));
+  executor.run();
+  EXPECT_EQ(values, std::vector<std::string>{"hello"});
+}
+
+// Buffer and ready queue are FIFOs over Deque, and a long stream must not
+// grow either of them past what the channel holds at a time.
+TEST(ChannelTest, LongStreamKeepsMemoryBounded) {
+  SingleThreadExecutor executor;
+  Channel<int> channel(64, executor);
+  std::atomic<long> sum{0};
+  std::atomic<int> count{0};
+  Spawn(executor, Consume(channel, sum, count));
+  Spawn(executor, Produce(channel, 100'000, false));
+  executor.run();
+  size_t settled = HeapInUse();
+  Spawn(executor, Produce(channel, 2'000'000, true));
+  executor.run();
+  EXPECT_EQ(count, 2'100'000);
+  EXPECT_LT(HeapInUse(), settled + 4096);
+}
+
+} // namespace
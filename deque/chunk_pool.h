@@ -0,0 +1,368 @@
+#ifndef DEQUE__CHUNK_POOL_H_
+#define DEQUE__CHUNK_POOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// Thread-safe memory resource keeping freed blocks for reuse by blocks of
+// the same size and alignment, meant to be shared by many deques:
+//
+//   Deque<Message> queue(&ChunkPool::Global());
+//
+// Deques of one element type all ask for one chunk size, so a chunk freed
+// by any of them serves the next one to grow, and the memory held tracks
+// the chunks in use across all of them rather than the sum of their peaks.
+// A deque gives a chunk back as soon as pops empty it, keeping one spare,
+// and the others when destroyed, through shrink_to_fit(), and when chunk
+// handles taken by drain_front() go away.
+//
+// Every thread keeps a few free blocks per pool and size in a cache of its
+// own, and goes to the lists shared under the pool mutex only to refill or
+// to hand back half of the cache when it overflows. Blocks come from the
+// upstream resource one at a time. The pool keeps them for reuse, so it
+// holds on to the peak of the chunks in use, until trim() or its
+// destruction, which has to happen after every block was deallocated.
+class ChunkPool : public std::pmr::memory_resource {
+public:
+  struct Stats {
+    // Bytes in blocks handed out and not yet deallocated.
+    size_t in_use;
+    // Bytes in blocks kept for reuse, including those in thread caches.
+    size_t pooled;
+  };
+
+  explicit ChunkPool(
+      std::pmr::memory_resource *upstream = std::pmr::new_delete_resource());
+  ChunkPool(const ChunkPool &other) = delete;
+  ~ChunkPool() override;
+
+  ChunkPool &operator=(const ChunkPool &other) = delete;
+
+  // The pool of the process. It is never destroyed, so deques with static
+  // or thread storage duration may use it too.
+  static ChunkPool &Global();
+
+  // Exact when no other thread allocates or deallocates meanwhile.
+  [[nodiscard]] Stats stats() const;
+
+  // Gives the blocks kept for reuse back to upstream: those on the shared
+  // lists and those in the cache of the calling thread. The caches of other
+  // threads keep theirs until the threads exit. Takes time in the number of
+  // blocks ever allocated.
+  void trim();
+
+private:
+  // Blocks a thread keeps per pool and size before handing half back.
+  static const size_t kCacheBlocks = 16;
+  // Pools and sizes a thread keeps blocks for at a time.
+  static const size_t kCacheEntries = 4;
+
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  struct FreeList {
+    size_t bytes;
+    size_t alignment;
+    FreeBlock *head;
+  };
+
+  struct Block {
+    void *address;
+    size_t bytes;
+    size_t alignment;
+  };
+
+  // Pools are told apart by an id which is never reused, so that an entry
+  // left behind by a destroyed pool never matches another one.
+  struct CacheEntry {
+    uint64_t pool_id = 0;
+    size_t bytes = 0;
+    size_t alignment = 0;
+    FreeBlock *head = nullptr;
+    size_t count = 0;
+  };
+
+  struct ThreadCache {
+    ~ThreadCache();
+
+    CacheEntry entries[kCacheEntries];
+  };
+
+  void *do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void *block, size_t bytes, size_t alignment) override;
+  bool do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override;
+
+  static bool &CacheGone();
+  static ThreadCache *LocalCache();
+  static void Flush(CacheEntry &entry);
+  CacheEntry *FindEntry(ThreadCache *cache, size_t bytes, size_t alignment);
+  FreeList *FindFreeList(size_t bytes, size_t alignment);
+  void *AllocateShared(size_t bytes, size_t alignment, CacheEntry *entry);
+  void Return(FreeBlock *first, FreeBlock *last, size_t bytes,
+              size_t alignment);
+
+  static inline std::atomic<uint64_t> next_id_{1};
+  // Live pools, for threads handing back their caches on exit.
+  static inline std::mutex registry_mutex_;
+  static inline std::vector<ChunkPool *> registry_;
+
+  const uint64_t id_;
+  std::pmr::memory_resource *upstream_;
+  mutable std::mutex mutex_;
+  std::vector<FreeList> free_lists_;
+  std::vector<Block> blocks_;
+  std::atomic<size_t> allocated_bytes_{0};
+  std::atomic<size_t> in_use_bytes_{0};
+};
+
+inline ChunkPool::ChunkPool(std::pmr::memory_resource *upstream)
+    : id_(next_id_.fetch_add(1, std::memory_order_relaxed)),
+      upstream_(upstream) {
+  std::lock_guard lock(registry_mutex_);
+  registry_.push_back(this);
+}
+
+inline ChunkPool::~ChunkPool() {
+  {
+    std::lock_guard lock(registry_mutex_);
+    registry_.erase(std::find(registry_.begin(), registry_.end(), this));
+  }
+  for (auto [address, bytes, alignment] : blocks_) {
+    upstream_->deallocate(address, bytes, alignment);
+  }
+}
+
+inline ChunkPool &ChunkPool::Global() {
+  static ChunkPool *pool = new ChunkPool();
+  return *pool;
+}
+
+inline ChunkPool::Stats ChunkPool::stats() const {
+  size_t in_use = in_use_bytes_.load(std::memory_order_relaxed);
+  size_t allocated = allocated_bytes_.load(std::memory_order_relaxed);
+  return Stats{in_use, allocated - std::min(in_use, allocated)};
+}
+
+inline void ChunkPool::trim() {
+  ThreadCache *cache = LocalCache();
+  if (cache != nullptr) {
+    for (auto &entry : cache->entries) {
+      if (entry.pool_id == id_) {
+        Flush(entry);
+      }
+    }
+  }
+  std::lock_guard lock(mutex_);
+  // Sorted, to find the record of every free block, which is marked by
+  // zeroing its size and dropped in the end.
+  auto by_address = [](const Block &lhs, const Block &rhs) {
+    return lhs.address < rhs.address;
+  };
+  std::sort(blocks_.begin(), blocks_.end(), by_address);
+  for (auto &list : free_lists_) {
+    while (list.head != nullptr) {
+      FreeBlock *block = list.head;
+      list.head = block->next;
+      auto record = std::lower_bound(blocks_.begin(), blocks_.end(),
+                                     Block{block, 0, 0}, by_address);
+      record->bytes = 0;
+      allocated_bytes_.fetch_sub(list.bytes, std::memory_order_relaxed);
+      upstream_->deallocate(block, list.bytes, list.alignment);
+    }
+  }
+  blocks_.erase(std::remove_if(blocks_.begin(), blocks_.end(),
+                               [](const Block &block) {
+                                 return block.bytes == 0;
+                               }),
+                blocks_.end());
+}
+
+inline ChunkPool::ThreadCache::~ThreadCache() {
+  for (auto &entry : entries) {
+    Flush(entry);
+  }
+  CacheGone() = true;
+}
+
+// Trivially destructible, so it can still be read after the cache is gone,
+// by deques destroyed later during thread exit.
+inline bool &ChunkPool::CacheGone() {
+  thread_local bool gone = false;
+  return gone;
+}
+
+inline ChunkPool::ThreadCache *ChunkPool::LocalCache() {
+  if (CacheGone()) {
+    return nullptr;
+  }
+  thread_local ThreadCache cache;
+  return &cache;
+}
+
+// Hands the blocks of entry back to its pool, if that still exists, and
+// frees the entry.
+inline void ChunkPool::Flush(CacheEntry &entry) {
+  if (entry.head != nullptr) {
+    std::lock_guard lock(registry_mutex_);
+    for (ChunkPool *pool : registry_) {
+      if (pool->id_ == entry.pool_id) {
+        FreeBlock *last = entry.head;
+        while (last->next != nullptr) {
+          last = last->next;
+        }
+        pool->Return(entry.head, last, entry.bytes, entry.alignment);
+        break;
+      }
+    }
+  }
+  entry = CacheEntry();
+}
+
+// Finds the entry of cache for blocks of this pool with the given size and
+// alignment, taking over a free one or else the last one if there is none.
+inline ChunkPool::CacheEntry *
+ChunkPool::FindEntry(ThreadCache *cache, size_t bytes, size_t alignment) {
+  CacheEntry *free = nullptr;
+  for (auto &entry : cache->entries) {
+    if (entry.pool_id == id_ && entry.bytes == bytes &&
+        entry.alignment == alignment) {
+      return &entry;
+    }
+    if (free == nullptr && entry.pool_id == 0) {
+      free = &entry;
+    }
+  }
+  if (free == nullptr) {
+    free = &cache->entries[kCacheEntries - 1];
+    Flush(*free);
+  }
+  free->pool_id = id_;
+  free->bytes = bytes;
+  free->alignment = alignment;
+  return free;
+}
+
+// Deques ask for few sizes, so the lists are few and a linear search is
+// enough. Called with mutex_ held.
+inline ChunkPool::FreeList *ChunkPool::FindFreeList(size_t bytes,
+                                                    size_t alignment) {
+  for (auto &list : free_lists_) {
+    if (list.bytes == bytes && list.alignment == alignment) {
+      return &list;
+    }
+  }
+  return nullptr;
+}
+
+// Takes a block from the shared lists, moving up to half a cache worth of
+// further blocks into entry if there is one, or else from upstream.
+inline void *ChunkPool::AllocateShared(size_t bytes, size_t alignment,
+                                       CacheEntry *entry) {
+  {
+    std::lock_guard lock(mutex_);
+    FreeList *list = FindFreeList(bytes, alignment);
+    if (list == nullptr) {
+      // Created here, so that deallocation never allocates.
+      free_lists_.push_back(FreeList{bytes, alignment, nullptr});
+      list = &free_lists_.back();
+    }
+    if (list->head != nullptr) {
+      FreeBlock *block = list->head;
+      list->head = block->next;
+      for (size_t i = 0; entry != nullptr && i < kCacheBlocks / 2 &&
+                         list->head != nullptr;
+           ++i) {
+        FreeBlock *next = list->head->next;
+        list->head->next = entry->head;
+        entry->head = list->head;
+        ++entry->count;
+        list->head = next;
+      }
+      return block;
+    }
+    // Reserved before allocating, so that recording the block cannot throw.
+    if (blocks_.size() == blocks_.capacity()) {
+      blocks_.reserve(2 * blocks_.size() + 1);
+    }
+  }
+  void *block = upstream_->allocate(bytes, alignment);
+  std::lock_guard lock(mutex_);
+  blocks_.push_back(Block{block, bytes, alignment});
+  allocated_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  return block;
+}
+
+inline void ChunkPool::Return(FreeBlock *first, FreeBlock *last, size_t bytes,
+                              size_t alignment) {
+  std::lock_guard lock(mutex_);
+  FreeList *list = FindFreeList(bytes, alignment);
+  last->next = list->head;
+  list->head = first;
+}
+
+inline void *ChunkPool::do_allocate(size_t bytes, size_t alignment) {
+  // A free block has to hold the link to the next one.
+  bytes = std::max(bytes, sizeof(FreeBlock));
+  alignment = std::max(alignment, alignof(FreeBlock));
+  ThreadCache *cache = LocalCache();
+  CacheEntry *entry =
+      cache == nullptr ? nullptr : FindEntry(cache, bytes, alignment);
+  void *block;
+  if (entry != nullptr && entry->head != nullptr) {
+    block = entry->head;
+    entry->head = entry->head->next;
+    --entry->count;
+  } else {
+    block = AllocateShared(bytes, alignment, entry);
+  }
+  in_use_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  return block;
+}
+
+inline void ChunkPool::do_deallocate(void *block, size_t bytes,
+                                     size_t alignment) {
+  bytes = std::max(bytes, sizeof(FreeBlock));
+  alignment = std::max(alignment, alignof(FreeBlock));
+  in_use_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+  auto freed = static_cast<FreeBlock *>(block);
+  ThreadCache *cache = LocalCache();
+  if (cache == nullptr) {
+    freed->next = nullptr;
+    Return(freed, freed, bytes, alignment);
+    return;
+  }
+  CacheEntry *entry = FindEntry(cache, bytes, alignment);
+  freed->next = entry->head;
+  entry->head = freed;
+  if (++entry->count <= kCacheBlocks) {
+    return;
+  }
+  // Keeps the most recently freed half, likely still in the cache.
+  FreeBlock *last = entry->head;
+  for (size_t i = 1; i < kCacheBlocks / 2; ++i) {
+    last = last->next;
+  }
+  FreeBlock *first = last->next;
+  last->next = nullptr;
+  last = first;
+  while (last->next != nullptr) {
+    last = last->next;
+  }
+  entry->count = kCacheBlocks / 2;
+  Return(first, last, bytes, alignment);
+}
+
+inline bool
+ChunkPool::do_is_equal(const std::pmr::memory_resource &other) const noexcept {
+  return this == &other;
+}
+
+#endif // DEQUE__CHUNK_POOL_H_
@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "chunk_pool.h"
+#include "deque.h"
+
+namespace {
+
+// Upstream counting the bytes the pool holds, from any thread.
+class CountingResource : public std::pmr::memory_resource {
+public:
+  size_t in_use() const { return in_use_; }
+
+private:
+  void *do_allocate(size_t bytes, size_t alignment) override {
+    in_use_ += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void *block, size_t bytes, size_t alignment) override {
+    in_use_ -= bytes;
+    std::pmr::new_delete_resource()->deallocate(block, bytes, alignment);
+  }
+  bool do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override {
+    return this == &other;
+  }
+
+  std::atomic<size_t> in_use_{0};
+};
+
+constexpr size_t kChunkBytes = 64 + 512 * sizeof(long);
+
+TEST(ChunkPoolTest, QueueStreamKeepsFewChunksInUse) {
+  ChunkPool pool;
+  Deque<long> queue(&pool);
+  for (long i = 0; i < 100; ++i) {
+    queue.push_back(i);
+  }
+  for (long i = 100; i < 1'000'000; ++i) {
+    queue.push_back(i);
+    queue.pop_front();
+    // A few map slots given chunks by eager growth, and the spare.
+    ASSERT_LE(pool.stats().in_use, 6 * kChunkBytes);
+  }
+  EXPECT_EQ(queue[0], 1'000'000 - 100);
+}
+
+TEST(ChunkPoolTest, PopsHandChunksBack) {
+  ChunkPool pool;
+  Deque<long> stack(&pool);
+  for (long i = 0; i < 100'000; ++i) {
+    stack.push_back(i);
+  }
+  size_t peak = pool.stats().in_use;
+  while (stack.size() > 0) {
+    stack.pop_back();
+  }
+  ChunkPool::Stats stats = pool.stats();
+  // Eager growth gave the map chunks past the back which no pop emptied.
+  EXPECT_LE(stats.in_use, peak - (100'000 / 512 - 1) * kChunkBytes);
+  EXPECT_GE(stats.pooled, (100'000 / 512 - 1) * kChunkBytes);
+}
+
+TEST(ChunkPoolTest, DequesShareFreedChunks) {
+  ChunkPool pool;
+  std::vector<Deque<std::string>> queues;
+  std::vector<std::deque<std::string>> expected(100);
+  for (int i = 0; i < 100; ++i) {
+    queues.emplace_back(&pool);
+  }
+  std::mt19937 random(1);
+  for (int i = 0; i < 300'000; ++i) {
+    size_t q = random() % queues.size();
+    if (random() % 2 == 0) {
+      queues[q].push_back(std::to_string(i));
+      expected[q].push_back(std::to_string(i));
+    } else if (!expected[q].empty()) {
+      queues[q].pop_front();
+      expected[q].pop_front();
+    }
+    if (random() % 5000 == 0) {
+      for (auto &chunk : queues[q].drain_front(700)) {
+        for (auto &value : chunk) {
+          ASSERT_EQ(value, expected[q].front());
+          expected[q].pop_front();
+        }
+      }
+    }
+  }
+  for (size_t q = 0; q < queues.size(); ++q) {
+    const auto &queue = queues[q];
+    ASSERT_EQ(queue.size(), expected[q].size());
+    for (size_t i = 0; i < queue.size(); ++i) {
+      ASSERT_EQ(queue[i], expected[q][i]);
+    }
+  }
+  queues.clear();
+  EXPECT_EQ(pool.stats().in_use, 0u);
+}
+
+TEST(ChunkPoolTest, TrimGivesPooledBlocksUpstream) {
+  CountingResource upstream;
+  ChunkPool pool(&upstream);
+  {
+    std::vector<Deque<long>> deques;
+    for (int i = 0; i < 20; ++i) {
+      deques.emplace_back(&pool);
+      for (long k = 0; k < 5000; ++k) {
+        deques.back().push_back(k);
+      }
+    }
+  }
+  EXPECT_EQ(pool.stats().in_use, 0u);
+  EXPECT_GT(pool.stats().pooled, 0u);
+  pool.trim();
+  EXPECT_EQ(pool.stats().pooled, 0u);
+  EXPECT_EQ(upstream.in_use(), 0u);
+
+  // Trimmed pools keep working, and free what they got later on.
+  Deque<long> deque(&pool);
+  for (long k = 0; k < 5000; ++k) {
+    deque.push_back(k);
+  }
+  EXPECT_GT(upstream.in_use(), 0u);
+}
+
+TEST(ChunkPoolTest, TrimAfterThreadsExitReleasesTheirCaches) {
+  CountingResource upstream;
+  ChunkPool pool(&upstream);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&pool, t] {
+      std::mt19937 random(t);
+      std::vector<Deque<long>> deques;
+      for (int i = 0; i < 20; ++i) {
+        deques.emplace_back(&pool);
+      }
+      for (long i = 0; i < 100'000; ++i) {
+        auto &deque = deques[random() % deques.size()];
+        if (random() % 3 != 0) {
+          deque.push_back(i);
+        } else if (deque.size() != 0) {
+          deque.pop_front();
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(pool.stats().in_use, 0u);
+  pool.trim();
+  EXPECT_EQ(upstream.in_use(), 0u);
+}
+
+} // namespace
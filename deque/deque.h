@@ -5,9 +5,29 @@
 #ifndef DEQUE__DEQUE_H_
 #define DEQUE__DEQUE_H_
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <iterator>
+#include <memory_resource>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Tells whether a T can be moved to other memory by copying its bytes, with
+// the source then treated as raw storage. Types which do not refer to their
+// own address may specialize this to get the memmove paths of Deque.
+template <typename T>
+struct IsTriviallyRelocatable : std::is_trivially_copyable<T> {};
+
 template <typename T> class Deque {
 private:
   static const size_t kSizeOfInnerArray = 512;
+  // Chunks start on a cache line, so that no element whose size divides 64
+  // straddles two lines.
+  static const size_t kChunkAlignment = alignof(T) > 64 ? alignof(T) : 64;
 
   template <bool is_const> class CommonIterator;
 
@@ -20,41 +40,76 @@ public:
   using reverse_iterator = std::reverse_iterator<iterator>;
   using const_reverse_iterator = std::reverse_iterator<const_iterator>;
 
+  class Chunk;
+  class Snapshot;
+
 private:
   iterator very_begin_iterator_;
   iterator very_end_iterator_;
   iterator begin_;
   iterator end_;
 
-  struct Memento {
-    T** deque;
-    size_t outer_size;
-    typename Deque<T>::iterator very_begin;
-    typename Deque<T>::iterator very_end;
-    typename Deque<T>::iterator begin;
-    typename Deque<T>::iterator end;
-  };
-
 public:
   using size_type = size_t;
   using value_type = T;
   using reference = T &;
   using const_reference = const T &;
 
+  // kEager grows the map at once, with a chunk for every new slot, when a
+  // push finds no room. kIncremental starts building the larger map while
+  // there is room left, copies a few slots per push and leaves new chunks
+  // to be allocated when first written, so that no push does more than a
+  // constant amount of work. Either mode moves the chunks back to the middle
+  // of the map instead of growing it while they fill at most half of it, so
+  // a deque used as a queue keeps a map in proportion to its size.
+  enum class GrowthMode { kEager, kIncremental };
+
   Deque();
+  // Takes the chunks from resource, which has to outlive the deque. Copies
+  // of the deque use the same resource.
+  explicit Deque(std::pmr::memory_resource *resource);
   ~Deque();
   Deque(const Deque<value_type> &other);
+  Deque(Deque<value_type> &&other) noexcept;
   explicit Deque(size_type count);
   Deque(size_type count, const_reference value);
   Deque<value_type> &operator=(const Deque<value_type> &other);
 
   [[nodiscard]] size_type size() const;
+  // Number of elements that can be pushed at either end before the deque
+  // has to allocate.
+  [[nodiscard]] size_type capacity_front() const;
+  [[nodiscard]] size_type capacity_back() const;
+
+  // Make room for count pushes at the respective end in one allocation.
+  void reserve_front(size_type count);
+  void reserve_back(size_type count);
+  // Gives every chunk holding no elements back to the memory resource. The
+  // map keeps its size, and its empty slots get chunks again when written.
+  void shrink_to_fit();
+
+  void set_growth_mode(GrowthMode mode);
+  [[nodiscard]] GrowthMode growth_mode() const;
+
+  [[nodiscard]] std::pmr::memory_resource *resource() const;
+
+  // Returns a read-only view of the current elements which shares the
+  // chunks of this deque instead of copying them, in O(chunks). This deque
+  // copies a chunk only when it is about to change it, which includes every
+  // non-const access to its elements: operator[], at() and dereferencing an
+  // iterator from the non-const begin() or end(). Copying a chunk moves
+  // this deque's elements, so references to them are invalidated, and
+  // iterators taken before this deque was moved from keep writing to the
+  // chunks of the moved-from object.
+  [[nodiscard]] Snapshot snapshot();
 
   reference operator[](size_type pos);
   const_reference operator[](size_type pos) const;
   reference at(size_type pos);
   const_reference at(size_type pos) const;
 
+  // A pop which empties a chunk gives it back to the resource, except for
+  // one kept to serve the next push needing a chunk.
   void push_back(const_reference value);
   void pop_back();
   void push_front(const_reference value);
@@ -78,14 +133,79 @@ public:
   template <class... Args> void emplace_back(Args &&...args);
   iterator erase(const_iterator pos);
 
+  // Takes whole chunks off the front, as long as their elements number no
+  // more than max in total, and hands them over without moving any element.
+  // A chunk still shared with a snapshot is copied first.
+  [[nodiscard]] std::vector<Chunk> drain_front(size_type max);
+  // Appends the elements of chunk. The chunk itself becomes part of the
+  // deque if it can: the deque is empty or ends on a chunk boundary, chunk
+  // holds elements from its start on or the deque is empty, and both use
+  // equal resources. Otherwise its elements are moved one by one.
+  void adopt_back(Chunk &&chunk);
+
 private:
+  Deque(const Deque<value_type> &other, std::pmr::memory_resource *resource);
+
+  // Precedes every chunk, padded so that the elements stay aligned. refs
+  // counts the deques sharing the chunk.
+  struct alignas(kChunkAlignment) ChunkHeader {
+    std::atomic<size_t> refs;
+  };
+
+  static ChunkHeader *Header(T *chunk);
+  T *NewChunk();
+  static void DeleteChunk(std::pmr::memory_resource *resource, T *chunk);
+  void DeleteChunk(T *chunk);
+  void SetChunk(T **slot, T *chunk);
+  void RetireChunk(T **slot);
+  bool IsShared(T *chunk) const;
+  void ReleaseChunk(T *chunk, size_t first, size_t last);
+  void Unshare(T **slot);
+  void Detach();
+  Deque<T> Share() const;
+  iterator Writable(iterator it);
+  void ReleaseElements();
   void Deallocate(size_t allocated_until);
   void SafeAllocation();
   void SafeCopy(const_iterator other_iter);
-  Memento Save();
-  void Restore(const Memento& memento);
+  void AllocateChunks(T **outer, size_t from, size_t to);
+  void DeallocateChunks(T **outer, size_t from, size_t to);
+  void GrowMap(size_t front_chunks, size_t back_chunks);
+  void Recentre();
+  void EnsureMargins();
+  void AdoptMap(T **outer, size_t size, ptrdiff_t shift);
+  void ProvisionChunk(T **slot);
+  void ProvisionChunks(size_t from, size_t to);
+  void Step();
+  void Migrate(size_t count);
+  void FinishMigration();
+  size_t LiveChunks() const;
+  void CopyElements(const Deque<T> &other);
+  void Swap(Deque<T> &other);
+  static constexpr bool ShiftsInPlace();
+  void Relocate(iterator first, iterator last, iterator d_first);
 
   void resize();
+
+  static const size_t kMigrationStep = 4;
+
+  std::pmr::memory_resource *resource_ = std::pmr::new_delete_resource();
+  GrowthMode growth_mode_ = GrowthMode::kEager;
+  // Set once a snapshot was taken of this deque or this deque is one, while
+  // its chunks may be shared. A shared chunk always holds elements of every deque
+  // sharing it, and none of them changes it.
+  bool shared_ = false;
+  // Chunk a pop emptied, kept for the next slot to be written.
+  T *spare_ = nullptr;
+  // Map under construction in incremental mode. Its first migrated_ slots
+  // are filled in: slot i of the current map goes to slot i + next_shift_,
+  // and slots it leaves out are dropped, the rest is empty. Until the switch
+  // deque_ stays authoritative, and chunks allocated meanwhile are mirrored
+  // into the filled part.
+  T **next_deque_ = nullptr;
+  size_t next_size_ = 0;
+  ptrdiff_t next_shift_ = 0;
+  size_t migrated_ = 0;
 };
 
 template <typename T> template <bool is_const> class Deque<T>::CommonIterator {
@@ -124,12 +244,229 @@ public:
   operator CommonIterator<true>() const;
 
   friend class CommonIterator<!is_const>;
+  friend class Deque;
 
 private:
+  void UnshareChunk();
+
   T **outer_pointer_;
   size_t idx_;
+  // Deque whose chunks the iterator may write, set on the iterators it
+  // hands out.
+  Deque *owner_ = nullptr;
+};
+
+// Owns one chunk taken out of a deque along with the elements it holds,
+// which are contiguous. Destroying the handle destroys the elements and
+// gives the chunk back to the memory resource of the deque, which has to
+// outlive the handle.
+template <typename T> class Deque<T>::Chunk {
+public:
+  Chunk() = default;
+  Chunk(const Chunk &other) = delete;
+  Chunk(Chunk &&other) noexcept;
+  ~Chunk();
+
+  Chunk &operator=(const Chunk &other) = delete;
+  Chunk &operator=(Chunk &&other) noexcept;
+
+  [[nodiscard]] size_type size() const;
+  [[nodiscard]] bool empty() const;
+
+  T *data();
+  const T *data() const;
+  T *begin();
+  const T *begin() const;
+  T *end();
+  const T *end() const;
+  reference operator[](size_type pos);
+  const_reference operator[](size_type pos) const;
+
+private:
+  friend class Deque;
+
+  Chunk(std::pmr::memory_resource *resource, T *chunk, size_t first,
+        size_t last);
+
+  void Release();
+
+  std::pmr::memory_resource *resource_ = nullptr;
+  T *chunk_ = nullptr;
+  size_t first_ = 0;
+  size_t last_ = 0;
+};
+
+template <typename T>
+Deque<T>::Chunk::Chunk(std::pmr::memory_resource *resource, T *chunk,
+                       size_t first, size_t last)
+    : resource_(resource), chunk_(chunk), first_(first), last_(last) {}
+
+template <typename T>
+Deque<T>::Chunk::Chunk(Chunk &&other) noexcept
+    : resource_(other.resource_), chunk_(std::exchange(other.chunk_, nullptr)),
+      first_(other.first_), last_(other.last_) {}
+
+template <typename T> Deque<T>::Chunk::~Chunk() { Release(); }
+
+template <typename T>
+typename Deque<T>::Chunk &Deque<T>::Chunk::operator=(Chunk &&other) noexcept {
+  if (this != &other) {
+    Release();
+    resource_ = other.resource_;
+    chunk_ = std::exchange(other.chunk_, nullptr);
+    first_ = other.first_;
+    last_ = other.last_;
+  }
+  return *this;
+}
+
+template <typename T>
+typename Deque<T>::size_type Deque<T>::Chunk::size() const {
+  return chunk_ == nullptr ? 0 : last_ - first_;
+}
+
+template <typename T> bool Deque<T>::Chunk::empty() const {
+  return size() == 0;
+}
+
+template <typename T> T *Deque<T>::Chunk::data() { return chunk_ + first_; }
+
+template <typename T> const T *Deque<T>::Chunk::data() const {
+  return chunk_ + first_;
+}
+
+template <typename T> T *Deque<T>::Chunk::begin() { return data(); }
+
+template <typename T> const T *Deque<T>::Chunk::begin() const {
+  return data();
+}
+
+template <typename T> T *Deque<T>::Chunk::end() { return data() + size(); }
+
+template <typename T> const T *Deque<T>::Chunk::end() const {
+  return data() + size();
+}
+
+template <typename T>
+typename Deque<T>::reference Deque<T>::Chunk::operator[](size_type pos) {
+  return data()[pos];
+}
+
+template <typename T>
+typename Deque<T>::const_reference
+Deque<T>::Chunk::operator[](size_type pos) const {
+  return data()[pos];
+}
+
+template <typename T> void Deque<T>::Chunk::Release() {
+  if (chunk_ == nullptr) {
+    return;
+  }
+  if constexpr (!std::is_trivially_destructible_v<T>) {
+    for (size_t i = first_; i < last_; ++i) {
+      chunk_[i].~T();
+    }
+  }
+  DeleteChunk(resource_, std::exchange(chunk_, nullptr));
+}
+
+// Read-only view of the elements a deque held when the snapshot was taken.
+// It shares the chunks of the deque, which copies a chunk before changing
+// it, so the view never changes. Copies of a snapshot share the chunks as
+// well. A snapshot may be read and dropped on another thread while the
+// deque keeps changing, and has to be dropped before the memory resource.
+template <typename T> class Deque<T>::Snapshot {
+public:
+  Snapshot() = default;
+  Snapshot(const Snapshot &other);
+  Snapshot(Snapshot &&other) noexcept = default;
+
+  Snapshot &operator=(const Snapshot &other);
+  Snapshot &operator=(Snapshot &&other) noexcept;
+
+  [[nodiscard]] size_type size() const;
+  [[nodiscard]] bool empty() const;
+
+  const_reference operator[](size_type pos) const;
+  const_reference at(size_type pos) const;
+
+  const_iterator begin() const;
+  const_iterator end() const;
+  const_reverse_iterator rbegin() const;
+  const_reverse_iterator rend() const;
+
+private:
+  friend class Deque;
+
+  explicit Snapshot(Deque &&deque);
+
+  Deque deque_;
 };
 
+template <typename T>
+Deque<T>::Snapshot::Snapshot(Deque &&deque) : deque_(std::move(deque)) {}
+
+template <typename T>
+Deque<T>::Snapshot::Snapshot(const Snapshot &other)
+    : deque_(other.deque_.Share()) {}
+
+template <typename T>
+typename Deque<T>::Snapshot &
+Deque<T>::Snapshot::operator=(const Snapshot &other) {
+  Deque shared = other.deque_.Share();
+  deque_.Swap(shared);
+  return *this;
+}
+
+template <typename T>
+typename Deque<T>::Snapshot &
+Deque<T>::Snapshot::operator=(Snapshot &&other) noexcept {
+  deque_.Swap(other.deque_);
+  return *this;
+}
+
+template <typename T>
+typename Deque<T>::size_type Deque<T>::Snapshot::size() const {
+  return deque_.size();
+}
+
+template <typename T> bool Deque<T>::Snapshot::empty() const {
+  return deque_.size() == 0;
+}
+
+template <typename T>
+typename Deque<T>::const_reference
+Deque<T>::Snapshot::operator[](size_type pos) const {
+  return deque_[pos];
+}
+
+template <typename T>
+typename Deque<T>::const_reference
+Deque<T>::Snapshot::at(size_type pos) const {
+  return deque_.at(pos);
+}
+
+template <typename T>
+typename Deque<T>::const_iterator Deque<T>::Snapshot::begin() const {
+  return deque_.begin();
+}
+
+template <typename T>
+typename Deque<T>::const_iterator Deque<T>::Snapshot::end() const {
+  return deque_.end();
+}
+
+template <typename T>
+typename Deque<T>::const_reverse_iterator
+Deque<T>::Snapshot::rbegin() const {
+  return deque_.rbegin();
+}
+
+template <typename T>
+typename Deque<T>::const_reverse_iterator Deque<T>::Snapshot::rend() const {
+  return deque_.rend();
+}
+
 template <typename T>
 template <bool is_const>
 Deque<T>::CommonIterator<is_const>::CommonIterator() = default;
@@ -144,7 +481,8 @@ template <typename T>
 template <bool is_const>
 Deque<T>::CommonIterator<is_const>::CommonIterator(
     const CommonIterator<is_const> &other)
-    : outer_pointer_(other.outer_pointer_), idx_(other.idx_) {}
+    : outer_pointer_(other.outer_pointer_), idx_(other.idx_),
+      owner_(other.owner_) {}
 
 template <typename T>
 template <bool is_const>
@@ -300,6 +638,7 @@ template <typename T>
 template <bool is_const>
 typename Deque<T>::template CommonIterator<is_const>::reference
 Deque<T>::CommonIterator<is_const>::operator*() {
+  UnshareChunk();
   return (*outer_pointer_)[idx_];
 }
 
@@ -307,6 +646,7 @@ template <typename T>
 template <bool is_const>
 typename Deque<T>::template CommonIterator<is_const>::pointer
 Deque<T>::CommonIterator<is_const>::operator->() {
+  UnshareChunk();
   return *outer_pointer_ + idx_;
 }
 
@@ -316,6 +656,18 @@ Deque<T>::CommonIterator<is_const>::operator CommonIterator<true>() const {
   return CommonIterator<true>(outer_pointer_, idx_);
 }
 
+// Elements reached through an iterator of the deque may be changed, so a
+// chunk shared with a snapshot is copied first, as in operator[].
+template <typename T>
+template <bool is_const>
+void Deque<T>::CommonIterator<is_const>::UnshareChunk() {
+  if constexpr (!is_const) {
+    if (owner_ != nullptr && owner_->shared_) {
+      owner_->Unshare(outer_pointer_);
+    }
+  }
+}
+
 /////////////////////////////////////////////// DEQUE ////////////////////////
 
 template <typename T>
@@ -324,9 +676,64 @@ Deque<T>::Deque()
       very_end_iterator_(very_begin_iterator_), begin_(very_begin_iterator_),
       end_(very_end_iterator_) {}
 
+template <typename T>
+Deque<T>::Deque(std::pmr::memory_resource *resource) : Deque() {
+  resource_ = resource;
+}
+
+template <typename T>
+typename Deque<T>::ChunkHeader *Deque<T>::Header(T *chunk) {
+  return reinterpret_cast<ChunkHeader *>(chunk) - 1;
+}
+
+template <typename T> T *Deque<T>::NewChunk() {
+  auto header = static_cast<ChunkHeader *>(resource_->allocate(
+      sizeof(ChunkHeader) + sizeof(T) * kSizeOfInnerArray, kChunkAlignment));
+  new (header) ChunkHeader{{1}};
+  return reinterpret_cast<T *>(header + 1);
+}
+
+template <typename T>
+void Deque<T>::DeleteChunk(std::pmr::memory_resource *resource, T *chunk) {
+  if (chunk != nullptr) {
+    resource->deallocate(Header(chunk),
+                         sizeof(ChunkHeader) + sizeof(T) * kSizeOfInnerArray,
+                         kChunkAlignment);
+  }
+}
+
+template <typename T> void Deque<T>::DeleteChunk(T *chunk) {
+  DeleteChunk(resource_, chunk);
+}
+
+// Puts chunk into slot of the map, and into the map under construction if
+// the slot is migrated already.
+template <typename T> void Deque<T>::SetChunk(T **slot, T *chunk) {
+  *slot = chunk;
+  if (next_deque_ != nullptr) {
+    ptrdiff_t next_slot = next_shift_ + (slot - deque_);
+    if (next_slot >= 0 && static_cast<size_t>(next_slot) < migrated_) {
+      next_deque_[next_slot] = chunk;
+    }
+  }
+}
+
+// Takes the chunk out of slot, once a pop left no element in it. One such
+// chunk is kept for the next slot to be written, so that a queue passes its
+// chunks from the front to the back instead of going to the resource.
+template <typename T> void Deque<T>::RetireChunk(T **slot) {
+  T *chunk = *slot;
+  SetChunk(slot, nullptr);
+  if (spare_ == nullptr) {
+    spare_ = chunk;
+  } else {
+    DeleteChunk(chunk);
+  }
+}
+
 template <typename T> void Deque<T>::Deallocate(size_t allocated_until) {
   for (size_t j = 0; j < allocated_until; ++j) {
-    operator delete[](deque_[j]);
+    DeleteChunk(deque_[j]);
   }
   delete[] deque_;
 }
@@ -335,8 +742,7 @@ template <typename T> void Deque<T>::SafeAllocation() {
   deque_ = new T *[outer_array_size_];
   for (size_t i = 0; i < outer_array_size_; ++i) {
     try {
-      deque_[i] =
-          static_cast<T *>(operator new[](sizeof(T) * kSizeOfInnerArray));
+      deque_[i] = NewChunk();
     } catch (...) {
       Deallocate(i);
       throw;
@@ -362,30 +768,286 @@ template <typename T> void Deque<T>::SafeCopy(const_iterator other_iter) {
 }
 
 template <typename T>
-Deque<T>::Deque(const Deque<value_type> &other) : Deque() {
-  if (other.deque_ == nullptr) {
+void Deque<T>::AllocateChunks(T **outer, size_t from, size_t to) {
+  for (size_t i = from; i < to; ++i) {
+    try {
+      outer[i] = NewChunk();
+    } catch (...) {
+      DeallocateChunks(outer, from, i);
+      throw;
+    }
+  }
+}
+
+template <typename T>
+void Deque<T>::DeallocateChunks(T **outer, size_t from, size_t to) {
+  for (size_t i = from; i < to; ++i) {
+    DeleteChunk(outer[i]);
+  }
+}
+
+// Moves the map to a new one with front_chunks new slots before the current
+// ones and back_chunks after them. Elements and chunks stay where they are,
+// only the chunk pointers are copied. The new slots get their chunks now in
+// eager mode and on first use in incremental mode.
+template <typename T>
+void Deque<T>::GrowMap(size_t front_chunks, size_t back_chunks) {
+  FinishMigration();
+  size_t old_size = outer_array_size_;
+  if (growth_mode_ == GrowthMode::kIncremental) {
+    // Either side gets more than the margin below which Step() starts a
+    // migration, so that no push finds a side run out before it ends.
+    size_t slack = (old_size + front_chunks + back_chunks) / 4 + 2;
+    front_chunks = std::max(front_chunks, slack);
+    back_chunks = std::max(back_chunks, slack);
+  }
+  size_t new_size = front_chunks + old_size + back_chunks;
+  T **outer = new T *[new_size];
+  if (growth_mode_ == GrowthMode::kIncremental) {
+    std::fill(outer, outer + front_chunks, nullptr);
+    std::fill(outer + front_chunks + old_size, outer + new_size, nullptr);
+  } else {
+    try {
+      AllocateChunks(outer, 0, front_chunks);
+      try {
+        AllocateChunks(outer, front_chunks + old_size, new_size);
+      } catch (...) {
+        DeallocateChunks(outer, 0, front_chunks);
+        throw;
+      }
+    } catch (...) {
+      delete[] outer;
+      throw;
+    }
+  }
+  if (old_size != 0) {
+    std::memcpy(outer + front_chunks, deque_, old_size * sizeof(T *));
+  }
+  AdoptMap(outer, new_size, static_cast<ptrdiff_t>(front_chunks));
+}
+
+// Moves the slots holding elements to the middle of the map, rotating the
+// others around them, so that every chunk stays in the map. Elements stay
+// where they are.
+template <typename T> void Deque<T>::Recentre() {
+  size_t chunks = LiveChunks();
+  T **first = begin_.outer_pointer_;
+  T **target = deque_ + (outer_array_size_ - chunks) / 2;
+  if (target < first) {
+    std::rotate(target, first, first + chunks);
+  } else {
+    std::rotate(first, first + chunks, target + chunks);
+  }
+  size_t size = this->size();
+  begin_ = iterator(target, chunks == 0 ? 0 : begin_.idx_);
+  end_ = begin_ + size;
+}
+
+// Grows maps built in one go, by copies, assignments and switches to
+// incremental mode, which may leave a side with less than the margin of
+// Step(), too little to migrate the map in the pushes it takes.
+template <typename T> void Deque<T>::EnsureMargins() {
+  size_t margin = outer_array_size_ / 8 + 1;
+  // Small maps are grown at once by resize().
+  if (growth_mode_ != GrowthMode::kIncremental || margin < 3) {
     return;
   }
+  size_t front_free = begin_.outer_pointer_ - deque_;
+  size_t back_free = deque_ + outer_array_size_ - end_.outer_pointer_;
+  if (front_free < margin || back_free < margin) {
+    GrowMap(0, 0);
+  }
+}
 
-  outer_array_size_ = other.outer_array_size_;
+// Replaces the map with outer, in which slot i of the current map is at
+// slot i + shift.
+template <typename T>
+void Deque<T>::AdoptMap(T **outer, size_t size, ptrdiff_t shift) {
+  auto offset = shift * static_cast<ptrdiff_t>(kSizeOfInnerArray);
+  auto begin_shift = begin_ - very_begin_iterator_ + offset;
+  auto end_shift = end_ - very_begin_iterator_ + offset;
+
+  delete[] deque_;
+  deque_ = outer;
+  outer_array_size_ = size;
+
+  very_begin_iterator_ = iterator(deque_, 0);
+  very_end_iterator_ = iterator(deque_ + outer_array_size_, 0);
+
+  begin_ = very_begin_iterator_ + begin_shift;
+  end_ = very_begin_iterator_ + end_shift;
+}
+
+template <typename T> void Deque<T>::ProvisionChunk(T **slot) {
+  if (*slot == nullptr) {
+    SetChunk(slot, spare_ != nullptr ? std::exchange(spare_, nullptr)
+                                     : NewChunk());
+  }
+}
+
+template <typename T>
+void Deque<T>::ProvisionChunks(size_t from, size_t to) {
+  for (size_t i = from; i < to; ++i) {
+    ProvisionChunk(deque_ + i);
+  }
+}
+
+// Runs before every push in incremental mode: advances a pending migration,
+// or starts one once either side of the map has less than an eighth of it
+// free. A side loses at most one slot per kSizeOfInnerArray pushes, while
+// the migration of the doubled map takes 2 * size / kMigrationStep pushes,
+// so it always completes before the side runs out.
+//
+// If the elements fill at most half of the map, the new map keeps its size
+// and has them in the middle. They end up with a quarter of the map free on
+// either side, far more than they can move by until the switch.
+template <typename T> void Deque<T>::Step() {
+  if (growth_mode_ != GrowthMode::kIncremental) {
+    return;
+  }
+  if (next_deque_ != nullptr) {
+    Migrate(kMigrationStep);
+    return;
+  }
+  size_t margin = outer_array_size_ / 8;
+  // Small maps are cheap to grow at once.
+  if (margin < 2) {
+    return;
+  }
+  size_t front_free = begin_.outer_pointer_ - deque_;
+  size_t back_free = deque_ + outer_array_size_ - end_.outer_pointer_;
+  if (front_free >= margin && back_free >= margin) {
+    return;
+  }
+  size_t chunks = LiveChunks();
+  size_t next_size = outer_array_size_;
+  ptrdiff_t next_shift = static_cast<ptrdiff_t>((next_size - chunks) / 2) -
+                         static_cast<ptrdiff_t>(front_free);
+  if (2 * chunks > outer_array_size_) {
+    next_size = 2 * outer_array_size_;
+    next_shift = static_cast<ptrdiff_t>(outer_array_size_ / 2);
+  }
+  next_deque_ = new T *[next_size];
+  next_size_ = next_size;
+  next_shift_ = next_shift;
+  migrated_ = 0;
+}
+
+template <typename T> void Deque<T>::Migrate(size_t count) {
+  size_t last = std::min(migrated_ + count, next_size_);
+  for (; migrated_ < last; ++migrated_) {
+    ptrdiff_t slot = static_cast<ptrdiff_t>(migrated_) - next_shift_;
+    next_deque_[migrated_] =
+        slot >= 0 && static_cast<size_t>(slot) < outer_array_size_
+            ? deque_[slot]
+            : nullptr;
+  }
+  if (migrated_ != next_size_) {
+    return;
+  }
+  // Slots left out of the new map hold no elements, but may hold chunks.
+  for (size_t i = 0; i < outer_array_size_; ++i) {
+    ptrdiff_t next_slot = static_cast<ptrdiff_t>(i) + next_shift_;
+    if (next_slot < 0 || static_cast<size_t>(next_slot) >= next_size_) {
+      DeleteChunk(deque_[i]);
+    }
+  }
+  AdoptMap(std::exchange(next_deque_, nullptr), next_size_, next_shift_);
+}
+
+template <typename T> void Deque<T>::FinishMigration() {
+  if (next_deque_ != nullptr) {
+    Migrate(next_size_);
+  }
+}
+
+template <typename T> size_t Deque<T>::LiveChunks() const {
+  if (begin_ == end_) {
+    return 0;
+  }
+  return (end_ - 1).outer_pointer_ - begin_.outer_pointer_ + 1;
+}
+
+// Copies the elements of other to begin_, which has the same offset in its
+// chunk as other.begin_, so both sequences split into chunks alike.
+template <typename T> void Deque<T>::CopyElements(const Deque<T> &other) {
+  if constexpr (std::is_trivially_copyable_v<T>) {
+    iterator to = begin_;
+    for (const_iterator from = other.begin_; from != other.end_;) {
+      size_t count = kSizeOfInnerArray - from.idx_;
+      if (from.outer_pointer_ == other.end_.outer_pointer_) {
+        count = other.end_.idx_ - from.idx_;
+      }
+      std::memcpy(*to.outer_pointer_ + to.idx_,
+                  *from.outer_pointer_ + from.idx_, count * sizeof(T));
+      from += count;
+      to += count;
+    }
+  } else {
+    SafeCopy(other.begin_);
+  }
+}
+
+template <typename T> void Deque<T>::Swap(Deque<T> &other) {
+  std::swap(deque_, other.deque_);
+  std::swap(outer_array_size_, other.outer_array_size_);
+  std::swap(resource_, other.resource_);
+  std::swap(very_begin_iterator_, other.very_begin_iterator_);
+  std::swap(very_end_iterator_, other.very_end_iterator_);
+  std::swap(begin_, other.begin_);
+  std::swap(end_, other.end_);
+  std::swap(growth_mode_, other.growth_mode_);
+  std::swap(shared_, other.shared_);
+  std::swap(spare_, other.spare_);
+  std::swap(next_deque_, other.next_deque_);
+  std::swap(next_size_, other.next_size_);
+  std::swap(next_shift_, other.next_shift_);
+  std::swap(migrated_, other.migrated_);
+}
+
+template <typename T>
+Deque<T>::Deque(const Deque<value_type> &other)
+    : Deque(other, other.resource_) {}
+
+template <typename T>
+Deque<T>::Deque(const Deque<value_type> &other,
+                std::pmr::memory_resource *resource)
+    : Deque(resource) {
+  growth_mode_ = other.growth_mode_;
+  size_t chunks = other.LiveChunks();
+  if (chunks == 0) {
+    return;
+  }
+
+  // Only the chunks holding elements are copied, however large the map of
+  // other has grown. resize() needs at least two slots to work with.
+  outer_array_size_ = std::max(chunks, 2ul);
 
   SafeAllocation();
 
   very_begin_iterator_ = iterator(deque_, 0);
   very_end_iterator_ = iterator(deque_ + outer_array_size_, 0);
 
-  begin_ = very_begin_iterator_ + (other.begin_ - other.very_begin_iterator_);
-  end_ = very_begin_iterator_ + (other.end_ - other.very_begin_iterator_);
+  begin_ = iterator(deque_, other.begin_.idx_);
+  end_ = begin_ + other.size();
+
+  CopyElements(other);
+  EnsureMargins();
+}
 
-  SafeCopy(other.begin_);
+template <typename T>
+Deque<T>::Deque(Deque<value_type> &&other) noexcept : Deque() {
+  Swap(other);
 }
 
 template <typename T> Deque<T>::Deque(size_type count) : Deque(count, T()) {}
 
 template<typename T>
 void Destroy(typename Deque<T>::iterator begin, typename Deque<T>::iterator end) {
-  for (typename Deque<T>::iterator it = begin; it < end; ++it) {
-    it->~T();
+  if constexpr (!std::is_trivially_destructible_v<T>) {
+    for (typename Deque<T>::iterator it = begin; it < end; ++it) {
+      it->~T();
+    }
   }
 }
 
@@ -410,57 +1072,173 @@ template <typename T> Deque<T>::Deque(size_type count, const_reference value) {
 }
 
 template <typename T>
-typename Deque<T>::Memento Deque<T>::Save() {
-  return {
-    deque_,
-    outer_array_size_,
-    very_begin_iterator_,
-    very_end_iterator_,
-    begin_,
-    end_
-  };
+Deque<T> &Deque<T>::operator=(const Deque<value_type> &other) {
+  if (this == &other) {
+    return *this;
+  }
+  if constexpr (!std::is_nothrow_copy_constructible_v<T>) {
+    // A throwing copy must leave this deque untouched, so build aside.
+    Deque<T> tmp(other, resource_);
+    Swap(tmp);
+    return *this;
+  }
+
+  // The copies go anywhere in the map, also to slots a pending migration
+  // would drop.
+  FinishMigration();
+  if (shared_) {
+    // Shared chunks cannot take the copies. Dropping them leaves their
+    // slots empty for ProvisionChunks to fill.
+    ReleaseElements();
+    end_ = begin_;
+  }
+  // The copies go to the chunks this deque already owns; new chunks are
+  // allocated only when other spans more of them than the whole map.
+  size_t chunks = other.LiveChunks();
+  if (chunks > outer_array_size_) {
+    GrowMap(0, std::max(chunks, 2ul) - outer_array_size_);
+  }
+  size_t first = (outer_array_size_ - chunks) / 2;
+  ProvisionChunks(first, first + chunks);
+
+  Destroy<T>(begin_, end_);
+  begin_ = iterator(deque_ + first, chunks == 0 ? 0 : other.begin_.idx_);
+  end_ = begin_ + other.size();
+  CopyElements(other);
+  EnsureMargins();
+
+  return *this;
 }
 
-template <typename T>
-void Deque<T>::Restore(const Memento &memento){
-  deque_ = memento.deque;
-  outer_array_size_ = memento.outer_size;
-  very_begin_iterator_ = memento.very_begin;
-  very_end_iterator_ = memento.very_end;
-  begin_ = memento.begin;
-  end_ = memento.end;
+template <typename T> bool Deque<T>::IsShared(T *chunk) const {
+  return shared_ && chunk != nullptr &&
+         Header(chunk)->refs.load(std::memory_order_acquire) != 1;
 }
 
+// Drops a reference to chunk, whose elements in this deque are those from
+// first to last. The last deque to let go destroys them and frees it.
 template <typename T>
-Deque<T> &Deque<T>::operator=(const Deque<value_type> &other) {
-  if (deque_ == other.deque_) {
-    return *this;
+void Deque<T>::ReleaseChunk(T *chunk, size_t first, size_t last) {
+  if (Header(chunk)->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+    return;
+  }
+  if constexpr (!std::is_trivially_destructible_v<T>) {
+    for (size_t i = first; i < last; ++i) {
+      chunk[i].~T();
+    }
   }
-  auto memento = Save();
+  DeleteChunk(chunk);
+}
 
-  outer_array_size_ = other.outer_array_size_;
+// Gives slot, which holds elements of this deque, a chunk of its own.
+template <typename T> void Deque<T>::Unshare(T **slot) {
+  T *chunk = *slot;
+  if (!IsShared(chunk)) {
+    return;
+  }
+  size_t first = slot == begin_.outer_pointer_ ? begin_.idx_ : 0;
+  size_t last =
+      slot == end_.outer_pointer_ ? end_.idx_ : kSizeOfInnerArray;
+  T *copy = NewChunk();
+  if constexpr (std::is_trivially_copyable_v<T>) {
+    std::memcpy(copy + first, chunk + first, (last - first) * sizeof(T));
+  } else if constexpr (std::is_copy_constructible_v<T>) {
+    // Move-only elements cannot be shared in the first place.
+    size_t i = first;
+    try {
+      for (; i < last; ++i) {
+        new (copy + i) T(chunk[i]);
+      }
+    } catch (...) {
+      while (i-- != first) {
+        copy[i].~T();
+      }
+      DeleteChunk(copy);
+      throw;
+    }
+  }
+  SetChunk(slot, copy);
+  ReleaseChunk(chunk, first, last);
+}
 
-  SafeAllocation();
+// Unshares every chunk, so that elements may be changed anywhere.
+template <typename T> void Deque<T>::Detach() {
+  if (!shared_ || begin_ == end_) {
+    shared_ = false;
+    return;
+  }
+  T **last = (end_ - 1).outer_pointer_;
+  for (T **slot = begin_.outer_pointer_; slot <= last; ++slot) {
+    Unshare(slot);
+  }
+  shared_ = false;
+}
 
-  very_begin_iterator_ = iterator(deque_, 0);
-  very_end_iterator_ = iterator(deque_ + outer_array_size_, 0);
-  begin_ = very_begin_iterator_ + (other.begin_ - other.very_begin_iterator_);
-  end_ = very_begin_iterator_ + (other.end_ - other.very_begin_iterator_);
+// Destroys the elements, except in shared chunks, which are released and
+// leave their slots empty.
+template <typename T> void Deque<T>::ReleaseElements() {
+  if (!shared_ || begin_ == end_) {
+    Destroy<T>(begin_, end_);
+    shared_ = false;
+    return;
+  }
+  T **last = (end_ - 1).outer_pointer_;
+  for (T **slot = begin_.outer_pointer_; slot <= last; ++slot) {
+    size_t first = slot == begin_.outer_pointer_ ? begin_.idx_ : 0;
+    size_t end =
+        slot == end_.outer_pointer_ ? end_.idx_ : kSizeOfInnerArray;
+    if (IsShared(*slot)) {
+      ReleaseChunk(*slot, first, end);
+      SetChunk(slot, nullptr);
+    } else if constexpr (!std::is_trivially_destructible_v<T>) {
+      for (size_t i = first; i < end; ++i) {
+        (*slot)[i].~T();
+      }
+    }
+  }
+  shared_ = false;
+}
 
-  try {
-    SafeCopy(other.begin_);
-  } catch (...) {
-    Restore(memento);
-    throw;
+template <typename T> typename Deque<T>::Snapshot Deque<T>::snapshot() {
+  Deque<T> shared = Share();
+  shared_ = shared_ || shared.shared_;
+  return Snapshot(std::move(shared));
+}
+
+// Returns a deque holding the chunks of this one, each with one more
+// reference. This deque has to be marked shared as well unless it is empty.
+template <typename T> Deque<T> Deque<T>::Share() const {
+  static_assert(std::is_copy_constructible_v<T>,
+                "Snapshots need copyable elements");
+  Deque<T> result(resource_);
+  result.growth_mode_ = growth_mode_;
+  size_t chunks = LiveChunks();
+  if (chunks == 0) {
+    return result;
   }
 
-  Destroy<T>(memento.begin, memento.end);
-  for (size_t i = 0; i < memento.outer_size; ++i) {
-    operator delete[](memento.deque[i]);
+  result.outer_array_size_ = std::max(chunks, 2ul);
+  result.deque_ = new T *[result.outer_array_size_];
+  std::fill(result.deque_, result.deque_ + result.outer_array_size_, nullptr);
+  for (size_t i = 0; i < chunks; ++i) {
+    T *chunk = begin_.outer_pointer_[i];
+    Header(chunk)->refs.fetch_add(1, std::memory_order_relaxed);
+    result.deque_[i] = chunk;
   }
-  delete[] memento.deque;
+  result.very_begin_iterator_ = iterator(result.deque_, 0);
+  result.very_end_iterator_ =
+      iterator(result.deque_ + result.outer_array_size_, 0);
+  result.begin_ = iterator(result.deque_, begin_.idx_);
+  result.end_ = result.begin_ + size();
+  result.shared_ = true;
+  result.EnsureMargins();
+  return result;
+}
 
-  return *this;
+template <typename T>
+typename Deque<T>::iterator Deque<T>::Writable(iterator it) {
+  it.owner_ = this;
+  return it;
 }
 
 template <typename T> typename Deque<T>::size_type Deque<T>::size() const {
@@ -469,7 +1247,11 @@ template <typename T> typename Deque<T>::size_type Deque<T>::size() const {
 
 template <typename T>
 typename Deque<T>::reference Deque<T>::operator[](size_type pos) {
-  return *(begin_ + pos);
+  iterator it = begin_ + pos;
+  if (shared_) {
+    Unshare(it.outer_pointer_);
+  }
+  return *it;
 }
 
 template <typename T>
@@ -495,25 +1277,58 @@ typename Deque<T>::const_reference Deque<T>::at(size_type pos) const {
 }
 
 template <typename T> void Deque<T>::push_back(const_reference value) {
+  Step();
   if (end_ == very_end_iterator_) {
     resize();
   }
-  *end_ = value;
+  ProvisionChunk(end_.outer_pointer_);
+  if (shared_ && end_.idx_ != 0) {
+    Unshare(end_.outer_pointer_);
+  }
+  new (&*end_) T(value);
+  ++end_;
+}
+
+template <typename T>
+template <class... Args>
+void Deque<T>::emplace_back(Args &&...args) {
+  Step();
+  if (end_ == very_end_iterator_) {
+    resize();
+  }
+  ProvisionChunk(end_.outer_pointer_);
+  if (shared_ && end_.idx_ != 0) {
+    Unshare(end_.outer_pointer_);
+  }
+  new (&*end_) T(std::forward<Args>(args)...);
   ++end_;
 }
 
 template <typename T> void Deque<T>::pop_back() {
-  end_->~T();
+  if (shared_) {
+    Unshare((end_ - 1).outer_pointer_);
+  }
   --end_;
+  if constexpr (!std::is_trivially_destructible_v<T>) {
+    end_->~T();
+  }
+  if (end_.idx_ == 0) {
+    RetireChunk(end_.outer_pointer_);
+  }
 }
 
 template <typename T> void Deque<T>::push_front(const_reference value) {
+  Step();
   if (begin_ == very_begin_iterator_) {
     resize();
   }
+  if (shared_ && begin_.idx_ != 0) {
+    Unshare(begin_.outer_pointer_);
+  }
   --begin_;
   try {
-    *begin_ = value;
+    ProvisionChunk(begin_.outer_pointer_);
+    new (&*begin_) T(value);
   } catch (...) {
     ++begin_;
     throw;
@@ -521,12 +1336,20 @@ template <typename T> void Deque<T>::push_front(const_reference value) {
 }
 
 template <typename T> void Deque<T>::pop_front() {
-  begin_->~T();
+  if (shared_) {
+    Unshare(begin_.outer_pointer_);
+  }
+  if constexpr (!std::is_trivially_destructible_v<T>) {
+    begin_->~T();
+  }
   ++begin_;
+  if (begin_.idx_ == 0) {
+    RetireChunk(begin_.outer_pointer_ - 1);
+  }
 }
 
 template <typename T> typename Deque<T>::iterator Deque<T>::begin() {
-  return begin_;
+  return Writable(begin_);
 }
 
 template <typename T>
@@ -540,7 +1363,7 @@ typename Deque<T>::const_iterator Deque<T>::cbegin() const {
 }
 
 template <typename T> typename Deque<T>::iterator Deque<T>::end() {
-  return end_;
+  return Writable(end_);
 }
 
 template <typename T> typename Deque<T>::const_iterator Deque<T>::end() const {
@@ -552,7 +1375,7 @@ template <typename T> typename Deque<T>::const_iterator Deque<T>::cend() const {
 }
 
 template <typename T> typename Deque<T>::reverse_iterator Deque<T>::rbegin() {
-  return reverse_iterator(end_);
+  return reverse_iterator(end());
 }
 
 template <typename T>
@@ -566,7 +1389,7 @@ typename Deque<T>::const_reverse_iterator Deque<T>::crbegin() const {
 }
 
 template <typename T> typename Deque<T>::reverse_iterator Deque<T>::rend() {
-  return reverse_iterator(begin_);
+  return reverse_iterator(begin());
 }
 
 template <typename T>
@@ -579,89 +1402,291 @@ typename Deque<T>::const_reverse_iterator Deque<T>::crend() const {
   return const_reverse_iterator(begin_);
 }
 
+// Whether insert and erase may shift elements within the deque. A move
+// throwing halfway would leave a slot in the middle without an element, so
+// otherwise they build the result aside.
+template <typename T> constexpr bool Deque<T>::ShiftsInPlace() {
+  return std::is_nothrow_move_constructible_v<T> &&
+         (IsTriviallyRelocatable<T>::value ||
+          std::is_nothrow_move_assignable_v<T>);
+}
+
+// Moves [first, last) one slot over to d_first, which is first - 1 or
+// first + 1. The destination slot outside of [first, last) has to be raw
+// memory; the source slot left outside of the destination becomes raw.
+// Only for types which ShiftsInPlace().
+template <typename T>
+void Deque<T>::Relocate(iterator first, iterator last, iterator d_first) {
+  if (first == last) {
+    return;
+  }
+  if constexpr (IsTriviallyRelocatable<T>::value) {
+    if (d_first < first) {
+      while (first != last) {
+        size_t count = std::min({kSizeOfInnerArray - first.idx_,
+                                 kSizeOfInnerArray - d_first.idx_,
+                                 static_cast<size_t>(last - first)});
+        std::memmove(&*d_first, &*first, count * sizeof(T));
+        first += count;
+        d_first += count;
+      }
+    } else {
+      iterator d_last = d_first + (last - first);
+      while (last != first) {
+        size_t count =
+            std::min({last.idx_ == 0 ? kSizeOfInnerArray : last.idx_,
+                      d_last.idx_ == 0 ? kSizeOfInnerArray : d_last.idx_,
+                      static_cast<size_t>(last - first)});
+        last -= count;
+        d_last -= count;
+        std::memmove(&*d_last, &*last, count * sizeof(T));
+      }
+    }
+  } else if (d_first < first) {
+    new (&*d_first) T(std::move(*first));
+    for (iterator it = first + 1; it != last; ++it) {
+      *(it - 1) = std::move(*it);
+    }
+    (last - 1)->~T();
+  } else {
+    new (&*last) T(std::move(*(last - 1)));
+    for (iterator it = last - 1; it != first; --it) {
+      *it = std::move(*(it - 1));
+    }
+    first->~T();
+  }
+}
+
 template <typename T>
 typename Deque<T>::iterator Deque<T>::insert(Deque<T>::const_iterator pos,
                                              const_reference value) {
-  Deque<T> deque_tmp = *this;
-  auto shift = pos - begin_;
-  auto iter = deque_tmp.begin_ + shift;
+  size_t index = pos - begin_;
+  if constexpr (!ShiftsInPlace()) {
+    Deque<T> result(resource_);
+    result.growth_mode_ = growth_mode_;
+    result.reserve_back(size() + 1);
+    const_iterator it = begin_;
+    for (; it != begin_ + index; ++it) {
+      result.push_back(*it);
+    }
+    result.push_back(value);
+    for (; it != end_; ++it) {
+      result.push_back(*it);
+    }
+    Swap(result);
+    return Writable(begin_ + index);
+  }
+  // value may be an element of this deque, so copy it before shifting.
   T tmp = value;
-  while (iter < deque_tmp.end_) {
-    std::swap(*iter, tmp);
-    ++iter;
+  Detach();
+  Step();
+  // Whichever side of pos is shorter moves by one slot.
+  if (index < size() / 2) {
+    if (begin_ == very_begin_iterator_) {
+      resize();
+    }
+    ProvisionChunk((begin_ - 1).outer_pointer_);
+    --begin_;
+    Relocate(begin_ + 1, begin_ + 1 + index, begin_);
+  } else {
+    if (end_ == very_end_iterator_) {
+      resize();
+    }
+    ProvisionChunk(end_.outer_pointer_);
+    Relocate(begin_ + index, end_, begin_ + index + 1);
+    ++end_;
   }
-  deque_tmp.push_back(tmp);
-  *this = deque_tmp;
-  return begin_ + shift;
+  iterator ret = begin_ + index;
+  new (&*ret) T(std::move(tmp));
+  return Writable(ret);
 }
 
 template <typename T>
 typename Deque<T>::iterator Deque<T>::erase(Deque<T>::const_iterator pos) {
-  Deque<T> deque_tmp = *this;
-  auto shift = pos - begin_;
-  auto iter = deque_tmp.begin_ + shift;
-  while (iter < deque_tmp.end_ - 1) {
-    *iter = *(iter + 1);
-    ++iter;
+  size_t index = pos - begin_;
+  if constexpr (!ShiftsInPlace()) {
+    Deque<T> result(resource_);
+    result.growth_mode_ = growth_mode_;
+    result.reserve_back(size() - 1);
+    for (const_iterator it = begin_; it != end_; ++it) {
+      if (it != begin_ + index) {
+        result.push_back(*it);
+      }
+    }
+    Swap(result);
+    return Writable(begin_ + index);
+  }
+  Detach();
+  iterator it = begin_ + index;
+  if constexpr (!std::is_trivially_destructible_v<T>) {
+    it->~T();
+  }
+  if (index < size() / 2) {
+    Relocate(begin_, it, begin_ + 1);
+    ++begin_;
+    if (begin_.idx_ == 0) {
+      RetireChunk(begin_.outer_pointer_ - 1);
+    }
+  } else {
+    Relocate(it + 1, end_, it);
+    --end_;
+    if (end_.idx_ == 0) {
+      RetireChunk(end_.outer_pointer_);
+    }
   }
-  --deque_tmp.end_;
-  *this = deque_tmp;
-  return begin_ + shift;
+  return Writable(begin_ + index);
 }
 
-template <typename T> void Deque<T>::resize() {
-  if (deque_ != nullptr) {
-    Memento memento = Save();
-    outer_array_size_ *= 2;
-    try {
-      SafeAllocation();
-    } catch (...) {
-      Restore(memento);
-      throw;
+template <typename T>
+std::vector<typename Deque<T>::Chunk> Deque<T>::drain_front(size_type max) {
+  std::vector<Chunk> chunks;
+  // Reserved up front, so that handing over a chunk cannot throw.
+  chunks.reserve(std::min(LiveChunks(), max / kSizeOfInnerArray + 2));
+  while (begin_ != end_) {
+    T **slot = begin_.outer_pointer_;
+    size_t last = slot == end_.outer_pointer_ ? end_.idx_ : kSizeOfInnerArray;
+    size_t count = last - begin_.idx_;
+    if (count > max || chunks.size() == chunks.capacity()) {
+      break;
     }
+    if (shared_) {
+      Unshare(slot);
+    }
+    chunks.push_back(Chunk(resource_, *slot, begin_.idx_, last));
+    // Left empty, to get a new chunk on the next write.
+    SetChunk(slot, nullptr);
+    begin_ += count;
+    max -= count;
+  }
+  return chunks;
+}
 
-    auto begin_shift = begin_ - very_begin_iterator_;
-    auto end_shift = end_ - very_begin_iterator_;
-
-    auto shift = outer_array_size_ / 4;
-    for (size_t i = shift; i < shift + outer_array_size_ / 2; ++i) {
-      deque_[i] = memento.deque[i - shift];
+template <typename T> void Deque<T>::adopt_back(Chunk &&chunk) {
+  if (chunk.empty()) {
+    return;
+  }
+  bool empty = begin_ == end_;
+  if ((!empty && (end_.idx_ != 0 || chunk.first_ != 0)) ||
+      *chunk.resource_ != *resource_) {
+    for (T &value : chunk) {
+      emplace_back(std::move_if_noexcept(value));
     }
+    chunk = Chunk();
+    return;
+  }
+  // The chunk takes a whole slot, which push_back fills only after as many
+  // calls, so a pending migration has to advance as far.
+  for (size_t i = 0; i < kSizeOfInnerArray; ++i) {
+    Step();
+  }
+  if (empty) {
+    // An empty deque may stop partway into its current slot. With no
+    // elements to keep, the chunk takes that slot from its start, and the
+    // chunk the slot held is retired below.
+    begin_ = end_ = iterator(end_.outer_pointer_, 0);
+  }
+  if (end_ == very_end_iterator_) {
+    resize();
+  }
+  T **slot = end_.outer_pointer_;
+  if (*slot != nullptr) {
+    RetireChunk(slot);
+  }
+  SetChunk(slot, std::exchange(chunk.chunk_, nullptr));
+  if (empty) {
+    begin_ = iterator(slot, chunk.first_);
+  }
+  end_ = iterator(slot, chunk.first_) + (chunk.last_ - chunk.first_);
+}
 
-    delete[] memento.deque;
+template <typename T> void Deque<T>::shrink_to_fit() {
+  DeleteChunk(std::exchange(spare_, nullptr));
+  T **first = begin_.outer_pointer_;
+  T **last = first + LiveChunks();
+  for (T **slot = deque_; slot != deque_ + outer_array_size_; ++slot) {
+    if (slot < first || slot >= last) {
+      DeleteChunk(*slot);
+      SetChunk(slot, nullptr);
+    }
+  }
+}
 
-    very_begin_iterator_ = iterator(deque_, 0);
-    very_end_iterator_ = iterator(deque_ + outer_array_size_, 0);
+template <typename T> void Deque<T>::resize() {
+  // Step() ends every migration before a side runs out, so that no push
+  // takes time in the size of the map: every push and insert steps first,
+  // adopt_back() steps as often as filling the slot would, switching to
+  // eager mode finishes the migration and maps built in one go get their
+  // margins from EnsureMargins().
+  assert(next_deque_ == nullptr);
+  // Recentring has to leave a free slot on either side, and a quarter of
+  // the map, so that it takes as many pushes as it moves slots to need it
+  // again.
+  size_t chunks = LiveChunks();
+  if (2 * chunks <= outer_array_size_ && outer_array_size_ - chunks >= 2) {
+    Recentre();
+    return;
+  }
+  // Doubles the map, with the old chunks in the middle of the new one.
+  size_t grow = std::max<size_t>(outer_array_size_ / 2, 1);
+  GrowMap(grow, grow);
+}
 
-    auto relative_begin = iterator(deque_ + shift, 0);
-    begin_ = relative_begin + begin_shift;
-    end_ = relative_begin + end_shift;
-  } else {
-    auto memento = Save();
-    outer_array_size_ = 2;
-    try {
-      SafeAllocation();
-    } catch (...) {
-      Restore(memento);
-    }
+template <typename T>
+typename Deque<T>::size_type Deque<T>::capacity_front() const {
+  return begin_ - very_begin_iterator_;
+}
 
-    very_begin_iterator_ = iterator(deque_, 0);
-    very_end_iterator_ = iterator(deque_ + outer_array_size_, 0);
+template <typename T>
+typename Deque<T>::size_type Deque<T>::capacity_back() const {
+  return very_end_iterator_ - end_;
+}
 
-    begin_ = iterator(deque_ + 1, 0);
-    end_ = begin_;
+template <typename T> void Deque<T>::reserve_front(size_type count) {
+  size_type free = capacity_front();
+  if (count > free) {
+    GrowMap((count - free + kSizeOfInnerArray - 1) / kSizeOfInnerArray, 0);
+  }
+  if (count != 0) {
+    ProvisionChunks((begin_ - count).outer_pointer_ - deque_,
+                    (begin_ - 1).outer_pointer_ - deque_ + 1);
   }
 }
 
-template <typename T> Deque<T>::~Deque() {
-  while (begin_ != end_) {
-    begin_->~T();
-    ++begin_;
+template <typename T> void Deque<T>::reserve_back(size_type count) {
+  size_type free = capacity_back();
+  if (count > free) {
+    GrowMap(0, (count - free + kSizeOfInnerArray - 1) / kSizeOfInnerArray);
   }
-  for (size_t i = 0; i < outer_array_size_; ++i) {
-    operator delete[](deque_[i]);
+  if (count != 0) {
+    ProvisionChunks(end_.outer_pointer_ - deque_,
+                    (end_ + (count - 1)).outer_pointer_ - deque_ + 1);
   }
+}
+
+template <typename T> void Deque<T>::set_growth_mode(GrowthMode mode) {
+  if (mode == GrowthMode::kEager) {
+    FinishMigration();
+  }
+  growth_mode_ = mode;
+  EnsureMargins();
+}
+
+template <typename T>
+typename Deque<T>::GrowthMode Deque<T>::growth_mode() const {
+  return growth_mode_;
+}
+
+template <typename T>
+std::pmr::memory_resource *Deque<T>::resource() const {
+  return resource_;
+}
+
+template <typename T> Deque<T>::~Deque() {
+  ReleaseElements();
+  DeallocateChunks(deque_, 0, outer_array_size_);
+  DeleteChunk(spare_);
   delete[] deque_;
+  delete[] next_deque_;
 }
 
 #endif // DEQUE__DEQUE_H_
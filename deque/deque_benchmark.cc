@@ -0,0 +1,93 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#include "deque.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Times every single push into a deque growing to state.range(0) elements
+// and reports the tail of the distribution, which is where the growth
+// modes differ: eager growth copies the whole map at once, incremental
+// growth a few slots per push.
+template <typename Container, typename Setup>
+void PushLatency(benchmark::State &state, Setup setup) {
+  const size_t count = state.range(0);
+  std::vector<double> latencies;
+  latencies.reserve(count);
+  for (auto _ : state) {
+    state.PauseTiming();
+    latencies.clear();
+    {
+      Container container;
+      setup(container);
+      state.ResumeTiming();
+      for (size_t i = 0; i < count; ++i) {
+        auto start = Clock::now();
+        container.push_back(static_cast<long>(i));
+        auto stop = Clock::now();
+        latencies.push_back(
+            std::chrono::duration<double, std::nano>(stop - start).count());
+      }
+      state.PauseTiming();
+    }
+    state.ResumeTiming();
+  }
+  std::sort(latencies.begin(), latencies.end());
+  auto quantile = [&latencies](double q) {
+    return latencies[static_cast<size_t>(q * (latencies.size() - 1))];
+  };
+  state.counters["p50_ns"] = quantile(0.5);
+  state.counters["p99.99_ns"] = quantile(0.9999);
+  state.counters["max_ns"] = latencies.back();
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+void BM_PushLatencyEager(benchmark::State &state) {
+  PushLatency<Deque<long>>(state, [](Deque<long> &) {});
+}
+
+void BM_PushLatencyIncremental(benchmark::State &state) {
+  PushLatency<Deque<long>>(state, [](Deque<long> &deque) {
+    deque.set_growth_mode(Deque<long>::GrowthMode::kIncremental);
+  });
+}
+
+void BM_PushLatencyStdDeque(benchmark::State &state) {
+  PushLatency<std::deque<long>>(state, [](std::deque<long> &) {});
+}
+
+BENCHMARK(BM_PushLatencyEager)->Arg(1 << 24)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_PushLatencyIncremental)
+    ->Arg(1 << 24)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_PushLatencyStdDeque)->Arg(1 << 24)->Unit(benchmark::kMillisecond);
+
+// A queue of fixed length streaming through the deque, which recentres its
+// map in place instead of growing it.
+template <typename Container> void BM_QueueStream(benchmark::State &state) {
+  Container queue;
+  for (long i = 0; i < state.range(0); ++i) {
+    queue.push_back(i);
+  }
+  long next = state.range(0);
+  for (auto _ : state) {
+    queue.push_back(next++);
+    benchmark::DoNotOptimize(queue[0]);
+    queue.pop_front();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_TEMPLATE(BM_QueueStream, Deque<long>)->Arg(64)->Arg(100'000);
+BENCHMARK_TEMPLATE(BM_QueueStream, std::deque<long>)->Arg(64)->Arg(100'000);
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,685 @@
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <deque>
+#include <memory_resource>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "deque.h"
+
+namespace {
+
+// Counts the bytes taken from it and not given back yet.
+class CountingResource : public std::pmr::memory_resource {
+public:
+  size_t in_use() const { return in_use_; }
+  size_t peak() const { return peak_; }
+
+private:
+  void *do_allocate(size_t bytes, size_t alignment) override {
+    in_use_ += bytes;
+    peak_ = std::max(peak_, in_use_);
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void *block, size_t bytes, size_t alignment) override {
+    in_use_ -= bytes;
+    std::pmr::new_delete_resource()->deallocate(block, bytes, alignment);
+  }
+  bool do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override {
+    return this == &other;
+  }
+
+  size_t in_use_ = 0;
+  size_t peak_ = 0;
+};
+
+template <typename T> size_t MapSlots(const Deque<T> &deque) {
+  return (deque.capacity_front() + deque.size() + deque.capacity_back()) / 512;
+}
+
+// Takes deques and their snapshots.
+template <typename Sequence, typename T>
+void ExpectEqual(const Sequence &deque, const std::deque<T> &expected) {
+  ASSERT_EQ(deque.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_EQ(deque[i], expected[i]) << "at " << i;
+  }
+}
+
+// Runs with eager growth for false and incremental growth for true.
+class DequeQueueTest : public ::testing::TestWithParam<bool> {
+protected:
+  template <typename T> void SetMode(Deque<T> &deque) {
+    deque.set_growth_mode(GetParam() ? Deque<T>::GrowthMode::kIncremental
+                                     : Deque<T>::GrowthMode::kEager);
+  }
+};
+
+TEST_P(DequeQueueTest, SteadyQueueKeepsMemoryBounded) {
+  CountingResource resource;
+  Deque<int> deque(&resource);
+  SetMode(deque);
+  for (int i = 0; i < 64; ++i) {
+    deque.push_back(i);
+  }
+  for (int i = 64; i < 4'000'000; ++i) {
+    deque.push_back(i);
+    ASSERT_EQ(deque[0], i - 64);
+    deque.pop_front();
+  }
+  EXPECT_LE(MapSlots(deque), 8u);
+  // The chunks holding the window and a spare one, and those the map had
+  // before the queue settled.
+  EXPECT_LE(resource.peak(), 8 * (64 + 512 * sizeof(int)));
+}
+
+TEST_P(DequeQueueTest, QueueShrinkingAndGrowingKeepsElements) {
+  Deque<std::string> deque;
+  SetMode(deque);
+  std::deque<std::string> expected;
+  int next = 0;
+  for (int round = 0; round < 40; ++round) {
+    size_t target = round % 2 == 0 ? 20'000 : 300;
+    while (expected.size() < target) {
+      std::string value = std::to_string(next++);
+      if (next % 3 == 0) {
+        deque.push_front(value);
+        expected.push_front(value);
+      } else {
+        deque.push_back(value);
+        expected.push_back(value);
+      }
+    }
+    while (expected.size() > target) {
+      if (next++ % 2 == 0) {
+        deque.pop_front();
+        expected.pop_front();
+      } else {
+        deque.pop_back();
+        expected.pop_back();
+      }
+    }
+    ExpectEqual(std::as_const(deque), expected);
+  }
+}
+
+TEST_P(DequeQueueTest, PopsGiveEmptiedChunksBack) {
+  CountingResource resource;
+  Deque<int> deque(&resource);
+  SetMode(deque);
+  for (int i = 0; i < 100'000; ++i) {
+    deque.push_back(i);
+  }
+  size_t full = resource.in_use();
+  while (deque.size() > 1000) {
+    deque.pop_front();
+  }
+  // All but the chunk kept as a spare, and the ones the ends are in.
+  size_t chunk = 64 + 512 * sizeof(int);
+  EXPECT_GE(full - resource.in_use(), (99'000 / 512 - 2) * chunk);
+  while (deque.size() > 0) {
+    deque.pop_back();
+  }
+  for (int i = 0; i < 1000; ++i) {
+    deque.push_front(i);
+  }
+  EXPECT_EQ(deque[0], 999);
+}
+
+INSTANTIATE_TEST_SUITE_P(GrowthModes, DequeQueueTest, ::testing::Bool());
+
+TEST_P(DequeQueueTest, AssignmentDuringMapMigrationKeepsElements) {
+  Deque<long> source;
+  for (long i = 0; i < 40 * 512; ++i) {
+    source.push_back(i);
+  }
+  // Each round stops a queue drifting to the end of its map at another
+  // push, some of them while the map is being recentred.
+  for (int pushes = 0; pushes < 40; ++pushes) {
+    Deque<long> deque;
+    SetMode(deque);
+    for (long i = 0; i < 64 * 512; ++i) {
+      deque.push_back(i);
+    }
+    for (long i = 0; i < 63 * 512; ++i) {
+      deque.pop_front();
+    }
+    for (int i = 0; i < pushes; ++i) {
+      deque.push_back(i);
+      deque.pop_front();
+    }
+    deque = source;
+    for (long i = 0; i < 3000; ++i) {
+      deque.push_back(i);
+    }
+    for (long i = 0; i < 40 * 512; ++i) {
+      ASSERT_EQ(std::as_const(deque)[i], i);
+    }
+  }
+}
+
+// Pushes in incremental mode have to find every migration done before a
+// side of the map runs out, which resize() asserts, whatever built the map.
+TEST(DequeTest, IncrementalPushesNeverFinishAMigration) {
+  using GrowthMode = Deque<long>::GrowthMode;
+  auto push_both = [](Deque<long> &deque, long count) {
+    for (long i = 0; i < count; ++i) {
+      deque.push_back(i);
+      deque.push_front(-i);
+    }
+  };
+
+  Deque<long> grown;
+  grown.set_growth_mode(GrowthMode::kIncremental);
+  push_both(grown, 500'000);
+
+  Deque<long> eager;
+  for (long i = 0; i < 200'000; ++i) {
+    eager.push_back(i);
+  }
+  Deque<long> switched = eager;
+  switched.set_growth_mode(GrowthMode::kIncremental);
+  push_both(switched, 200'000);
+
+  Deque<long> copy = grown;
+  push_both(copy, 200'000);
+  Deque<long>::Snapshot snapshot = grown.snapshot();
+  push_both(grown, 200'000);
+  EXPECT_EQ(snapshot.size(), 1'000'000u);
+  EXPECT_EQ(snapshot[0], -499'999);
+
+  Deque<long> assigned;
+  assigned.set_growth_mode(GrowthMode::kIncremental);
+  assigned.push_back(0);
+  assigned = eager;
+  push_both(assigned, 200'000);
+
+  Deque<long> reserved;
+  reserved.set_growth_mode(GrowthMode::kIncremental);
+  reserved.reserve_back(1'000'000);
+  for (long i = 0; i < 500'000; ++i) {
+    reserved.push_front(i);
+  }
+  EXPECT_EQ(reserved[0], 499'999);
+  EXPECT_EQ(switched[switched.size() - 1], 199'999);
+  EXPECT_EQ(assigned.size(), 600'000u);
+}
+
+// Every adopted chunk takes a slot of the map, so adopting has to keep a
+// migration as far ahead as pushes filling the slot would.
+TEST(DequeTest, AdoptBackDuringMigrationKeepsElements) {
+  Deque<long> deque;
+  deque.set_growth_mode(Deque<long>::GrowthMode::kIncremental);
+  std::deque<long> expected;
+  long next = 0;
+  for (int round = 0; round < 3000; ++round) {
+    Deque<long> source(deque.resource());
+    // Full chunks, so that the deque keeps ending on a chunk boundary and
+    // every one of them is adopted whole.
+    for (long i = 0; i < 512; ++i) {
+      source.push_back(next);
+      expected.push_back(next++);
+    }
+    for (auto &chunk : source.drain_front(512)) {
+      deque.adopt_back(std::move(chunk));
+    }
+    if (round % 3 == 2) {
+      for (int i = 0; i < 600; ++i) {
+        deque.pop_front();
+        expected.pop_front();
+      }
+    }
+  }
+  ExpectEqual(std::as_const(deque), expected);
+}
+
+// A copy gets only the chunks the elements are in, however large the map of
+// the source grew.
+TEST(DequeTest, CopiesTakeOnlyLiveChunks) {
+  CountingResource resource;
+  Deque<int> source(&resource);
+  for (int i = 0; i < 200'000; ++i) {
+    source.push_back(i);
+  }
+  while (source.size() > 1000) {
+    source.pop_front();
+  }
+  size_t before = resource.in_use();
+  Deque<int> copy = source;
+  EXPECT_LE(resource.in_use() - before, 3 * (64 + 512 * sizeof(int)));
+  EXPECT_LE(MapSlots(copy), 3u);
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_EQ(std::as_const(copy)[i], 199'000 + i);
+  }
+  copy.push_front(-1);
+  copy.push_back(-2);
+  EXPECT_EQ(copy.size(), 1002u);
+
+  Deque<std::string> strings;
+  std::deque<std::string> expected;
+  for (int i = 0; i < 5000; ++i) {
+    strings.push_front(std::to_string(i));
+    expected.push_front(std::to_string(i));
+  }
+  Deque<std::string> strings_copy = strings;
+  ExpectEqual(std::as_const(strings_copy), expected);
+}
+
+// Assigning a deque which fits the map of this one copies into the chunks it
+// has instead of allocating new ones.
+TEST(DequeTest, AssignmentReusesChunks) {
+  CountingResource resource;
+  Deque<long> deque(&resource);
+  for (long i = 0; i < 100'000; ++i) {
+    deque.push_back(-i);
+  }
+  Deque<long> source(&resource);
+  for (long i = 0; i < 50'000; ++i) {
+    source.push_front(i);
+  }
+  size_t peak = resource.peak();
+  deque = source;
+  EXPECT_EQ(resource.peak(), peak);
+  ASSERT_EQ(deque.size(), 50'000u);
+  for (long i = 0; i < 50'000; ++i) {
+    ASSERT_EQ(std::as_const(deque)[i], 49'999 - i);
+  }
+
+  for (long i = 0; i < 150'000; ++i) {
+    source.push_back(i);
+  }
+  deque = source;
+  ASSERT_EQ(deque.size(), 200'000u);
+  EXPECT_EQ(std::as_const(deque)[199'999], 149'999);
+  deque.push_back(1);
+  deque.push_front(2);
+  EXPECT_EQ(deque.size(), 200'002u);
+}
+
+// After reserving, a burst of pushes at that end takes nothing more from the
+// resource, in either growth mode.
+TEST_P(DequeQueueTest, ReservedPushesDoNotAllocate) {
+  CountingResource resource;
+  Deque<int> deque(&resource);
+  SetMode(deque);
+  for (int i = 0; i < 1000; ++i) {
+    deque.push_back(i);
+  }
+  deque.reserve_back(100'000);
+  EXPECT_GE(deque.capacity_back(), 100'000u);
+  size_t in_use = resource.in_use();
+  for (int i = 0; i < 100'000; ++i) {
+    deque.push_back(i);
+  }
+  EXPECT_EQ(resource.in_use(), in_use);
+
+  deque.reserve_front(50'000);
+  EXPECT_GE(deque.capacity_front(), 50'000u);
+  in_use = resource.in_use();
+  for (int i = 0; i < 50'000; ++i) {
+    deque.push_front(-i);
+  }
+  EXPECT_EQ(resource.in_use(), in_use);
+
+  ASSERT_EQ(deque.size(), 151'000u);
+  EXPECT_EQ(std::as_const(deque)[0], -49'999);
+  EXPECT_EQ(std::as_const(deque)[50'000], 0);
+  EXPECT_EQ(std::as_const(deque)[151'000 - 1], 99'999);
+}
+
+TEST(DequeTest, CapacityCountsPushesBeforeAllocating) {
+  CountingResource resource;
+  Deque<int> deque(&resource);
+  deque.push_back(0);
+  for (int round = 0; round < 3; ++round) {
+    size_t back = deque.capacity_back();
+    size_t in_use = resource.in_use();
+    for (size_t i = 0; i < back; ++i) {
+      deque.push_back(1);
+    }
+    EXPECT_EQ(deque.capacity_back(), 0u);
+    EXPECT_EQ(resource.in_use(), in_use);
+    deque.push_back(2);
+    EXPECT_GT(deque.capacity_back(), 0u);
+  }
+  size_t front = deque.capacity_front();
+  for (size_t i = 0; i < front; ++i) {
+    deque.push_front(3);
+  }
+  EXPECT_EQ(deque.capacity_front(), 0u);
+  // Reserving what already fits changes nothing.
+  size_t back = deque.capacity_back();
+  deque.reserve_back(back);
+  deque.reserve_front(0);
+  EXPECT_EQ(deque.capacity_back(), back);
+  EXPECT_EQ(deque.capacity_front(), 0u);
+}
+
+// Counts its live instances, and throws from the copy which copies_left
+// runs out on. Without a move constructor, moves are copies which throw.
+struct ThrowingCopy {
+  static inline int live = 0;
+  static inline int copies_left = -1;
+
+  explicit ThrowingCopy(int value) : value(value) { ++live; }
+  ThrowingCopy(const ThrowingCopy &other) : value(other.value) {
+    Copy();
+    ++live;
+  }
+  ~ThrowingCopy() { --live; }
+  ThrowingCopy &operator=(const ThrowingCopy &other) {
+    Copy();
+    value = other.value;
+    return *this;
+  }
+
+  static void Copy() {
+    if (copies_left >= 0 && copies_left-- == 0) {
+      throw std::runtime_error("copy");
+    }
+  }
+
+  int value;
+};
+
+// Throws from copies the same way, but moves without throwing.
+struct NothrowMove : ThrowingCopy {
+  using ThrowingCopy::ThrowingCopy;
+  NothrowMove(const NothrowMove &other) = default;
+  NothrowMove(NothrowMove &&other) noexcept : ThrowingCopy(other.value) {}
+  NothrowMove &operator=(const NothrowMove &other) = default;
+  NothrowMove &operator=(NothrowMove &&other) noexcept {
+    value = other.value;
+    return *this;
+  }
+};
+
+template <typename T> class DequeThrowingTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    live_before_ = T::live;
+    for (int i = 0; i < 2000; ++i) {
+      deque_.push_back(T(i));
+    }
+  }
+
+  void ExpectUnchanged() {
+    ASSERT_EQ(deque_.size(), 2000u);
+    for (int i = 0; i < 2000; ++i) {
+      ASSERT_EQ(std::as_const(deque_)[i].value, i);
+    }
+    EXPECT_EQ(T::live, live_before_ + 2000);
+  }
+
+  void TearDown() override { T::copies_left = -1; }
+
+  int live_before_ = 0;
+  Deque<T> deque_;
+};
+
+using ThrowingTypes = ::testing::Types<ThrowingCopy, NothrowMove>;
+TYPED_TEST_SUITE(DequeThrowingTest, ThrowingTypes);
+
+TYPED_TEST(DequeThrowingTest, ThrowingInsertLeavesDequeUnchanged) {
+  for (size_t pos : {0, 1, 700, 1000, 1500, 1999, 2000}) {
+    for (int copies : {0, 1, 2, 100, 1000}) {
+      TypeParam::copies_left = copies;
+      try {
+        this->deque_.insert(this->deque_.cbegin() + pos, TypeParam(-1));
+        TypeParam::copies_left = -1;
+        this->deque_.erase(this->deque_.cbegin() + pos);
+      } catch (const std::runtime_error &) {
+      }
+      TypeParam::copies_left = -1;
+      this->ExpectUnchanged();
+    }
+  }
+}
+
+TYPED_TEST(DequeThrowingTest, ThrowingEraseLeavesDequeUnchanged) {
+  for (size_t pos : {0, 1, 700, 1000, 1500, 1999}) {
+    for (int copies : {0, 1, 2, 100, 1000}) {
+      TypeParam::copies_left = copies;
+      try {
+        this->deque_.erase(this->deque_.cbegin() + pos);
+        TypeParam::copies_left = -1;
+        this->deque_.insert(this->deque_.cbegin() + pos,
+                            TypeParam(static_cast<int>(pos)));
+      } catch (const std::runtime_error &) {
+      }
+      TypeParam::copies_left = -1;
+      this->ExpectUnchanged();
+    }
+  }
+}
+
+TEST(DequeTest, InsertAndEraseMatchStdDeque) {
+  std::mt19937 random(3);
+  Deque<std::string> deque;
+  Deque<int> ints;
+  std::deque<std::string> expected;
+  for (int i = 0; i < 20'000; ++i) {
+    size_t size = expected.size();
+    if (size == 0 || random() % 5 < 3) {
+      size_t pos = random() % (size + 1);
+      std::string value = std::to_string(i);
+      // Inserting an element of the deque itself has to copy it first.
+      if (size != 0 && random() % 4 == 0) {
+        value = expected[pos % size];
+        deque.insert(deque.cbegin() + pos, std::as_const(deque)[pos % size]);
+      } else {
+        deque.insert(deque.cbegin() + pos, value);
+      }
+      ints.insert(ints.cbegin() + pos, i);
+      expected.insert(expected.begin() + pos, value);
+    } else {
+      size_t pos = random() % size;
+      deque.erase(deque.cbegin() + pos);
+      ints.erase(ints.cbegin() + pos);
+      expected.erase(expected.begin() + pos);
+    }
+  }
+  ExpectEqual(std::as_const(deque), expected);
+  EXPECT_EQ(ints.size(), expected.size());
+}
+
+// A snapshot takes no chunks; the deque copies each one when it first
+// writes to it, and the snapshot keeps the old contents.
+TEST(DequeSnapshotTest, SharesChunksUntilWritten) {
+  CountingResource resource;
+  size_t chunk = 64 + 512 * sizeof(long);
+  Deque<long> deque(&resource);
+  for (long i = 0; i < 100 * 512; ++i) {
+    deque.push_back(i);
+  }
+  size_t in_use = resource.in_use();
+  {
+    Deque<long>::Snapshot snapshot = deque.snapshot();
+    EXPECT_EQ(resource.in_use(), in_use);
+    ASSERT_EQ(snapshot.size(), deque.size());
+
+    deque[1000] = -1;
+    EXPECT_EQ(resource.in_use(), in_use + chunk);
+    deque[1001] = -2;
+    EXPECT_EQ(resource.in_use(), in_use + chunk);
+    *(deque.begin() + 2000) = -3;
+    EXPECT_EQ(resource.in_use(), in_use + 2 * chunk);
+    deque.pop_front();
+    deque.pop_back();
+    EXPECT_EQ(resource.in_use(), in_use + 4 * chunk);
+
+    const Deque<long> &original = deque;
+    EXPECT_EQ(original[999], -1);
+    EXPECT_EQ(original[1000], -2);
+    EXPECT_EQ(original[1999], -3);
+    EXPECT_EQ(snapshot[1000], 1000);
+    EXPECT_EQ(snapshot[1001], 1001);
+    EXPECT_EQ(snapshot[2000], 2000);
+    EXPECT_EQ(snapshot[0], 0);
+    EXPECT_EQ(snapshot.at(snapshot.size() - 1), 100 * 512 - 1);
+    EXPECT_THROW(snapshot.at(snapshot.size()), std::out_of_range);
+  }
+  // Dropping the snapshot frees the chunks only it still held, which leaves
+  // the deque with as many as before.
+  EXPECT_EQ(resource.in_use(), in_use);
+}
+
+// Iterating copies no chunk: a snapshot hands out only const iterators, and
+// those of the deque copy a chunk when dereferenced, not when taken.
+TEST(DequeSnapshotTest, IteratingCopiesNoChunk) {
+  CountingResource resource;
+  size_t chunk = 64 + 512 * sizeof(long);
+  Deque<long> deque(&resource);
+  for (long i = 0; i < 10 * 512; ++i) {
+    deque.push_back(i);
+  }
+  size_t in_use = resource.in_use();
+  Deque<long>::Snapshot snapshot = deque.snapshot();
+  long expected = 0;
+  for (auto &value : snapshot) {
+    ASSERT_EQ(value, expected++);
+  }
+  for (auto it = snapshot.rbegin(); it != snapshot.rend(); ++it) {
+    ASSERT_EQ(*it, --expected);
+  }
+  Deque<long>::iterator first = deque.begin();
+  Deque<long>::iterator last = deque.end();
+  EXPECT_EQ(last - first, 10 * 512);
+  EXPECT_TRUE(deque.rbegin() != deque.rend());
+  for (long value : std::as_const(deque)) {
+    ASSERT_EQ(value, expected++);
+  }
+  EXPECT_EQ(resource.in_use(), in_use);
+
+  // Writing through an iterator copies just the chunk written to.
+  *(first + 600) = -1;
+  *(last - 1) = -2;
+  *deque.rbegin() -= 1;
+  EXPECT_EQ(resource.in_use(), in_use + 2 * chunk);
+  EXPECT_EQ(snapshot[600], 600);
+  EXPECT_EQ(snapshot[10 * 512 - 1], 10 * 512 - 1);
+  EXPECT_EQ(std::as_const(deque)[600], -1);
+  EXPECT_EQ(std::as_const(deque)[10 * 512 - 1], -3);
+}
+
+// A deque of strings changes while snapshots of it, and copies of those,
+// are taken and dropped; no change may show through in any of them.
+TEST(DequeSnapshotTest, SnapshotsKeepTheirContents) {
+  std::mt19937 random(4);
+  Deque<std::string> deque;
+  std::deque<std::string> expected;
+  std::vector<Deque<std::string>::Snapshot> snapshots;
+  std::vector<std::deque<std::string>> expected_snapshots;
+  auto change = [&](int i) {
+    std::string value = std::to_string(i);
+    size_t size = expected.size();
+    switch (random() % 7) {
+    case 0:
+      deque.push_back(value);
+      expected.push_back(value);
+      break;
+    case 1:
+      deque.push_front(value);
+      expected.push_front(value);
+      break;
+    case 2:
+      if (size != 0) {
+        deque.pop_back();
+        expected.pop_back();
+      }
+      break;
+    case 3:
+      if (size != 0) {
+        deque.pop_front();
+        expected.pop_front();
+      }
+      break;
+    case 4:
+      if (size != 0) {
+        size_t pos = random() % size;
+        if (i % 2 == 0) {
+          deque[pos] = value;
+        } else {
+          *(deque.begin() + pos) = value;
+        }
+        expected[pos] = value;
+      }
+      break;
+    case 5: {
+      size_t pos = random() % (size + 1);
+      deque.insert(deque.cbegin() + pos, value);
+      expected.insert(expected.begin() + pos, value);
+      break;
+    }
+    default:
+      if (size != 0) {
+        size_t pos = random() % size;
+        deque.erase(deque.cbegin() + pos);
+        expected.erase(expected.begin() + pos);
+      }
+    }
+  };
+  for (int i = 0; i < 3000; ++i) {
+    deque.push_back(std::to_string(i));
+    expected.push_back(std::to_string(i));
+  }
+  for (int i = 0; i < 20'000; ++i) {
+    if (i % 1000 == 0) {
+      if (snapshots.size() == 4) {
+        snapshots.erase(snapshots.begin());
+        expected_snapshots.erase(expected_snapshots.begin());
+      }
+      snapshots.push_back(deque.snapshot());
+      expected_snapshots.push_back(expected);
+    }
+    change(i);
+    if (i % 2500 == 0) {
+      Deque<std::string>::Snapshot copy = snapshots.back();
+      size_t which = random() % snapshots.size();
+      snapshots[which] = copy;
+      expected_snapshots[which] = expected_snapshots.back();
+    }
+  }
+  ExpectEqual(std::as_const(deque), expected);
+  for (size_t i = 0; i < snapshots.size(); ++i) {
+    ExpectEqual(snapshots[i], expected_snapshots[i]);
+  }
+}
+
+// Snapshots are read and dropped on other threads while the deque they came
+// from keeps changing the chunks they share.
+TEST(DequeSnapshotTest, SnapshotsOnOtherThreads) {
+  Deque<long> deque;
+  for (long i = 0; i < 20 * 512; ++i) {
+    deque.push_back(i);
+  }
+  long next = 20 * 512;
+  std::vector<std::thread> readers;
+  for (int round = 0; round < 8; ++round) {
+    readers.emplace_back([snapshot = deque.snapshot()]() {
+      for (size_t i = 1; i < snapshot.size(); ++i) {
+        ASSERT_EQ(snapshot[i], snapshot[i - 1] + 1);
+      }
+    });
+    for (int i = 0; i < 2000; ++i) {
+      deque.push_back(next++);
+      deque.pop_front();
+      if (i % 100 == 0) {
+        *deque.begin() += 0;
+      }
+    }
+  }
+  for (auto &reader : readers) {
+    reader.join();
+  }
+  const Deque<long> &view = deque;
+  EXPECT_EQ(view[view.size() - 1], next - 1);
+  EXPECT_EQ(view.size(), 20u * 512);
+}
+
+} // namespace
@@ -0,0 +1,85 @@
+#ifndef DEQUE__HEAP_COUNTER_TEST_UTIL_H_
+#define DEQUE__HEAP_COUNTER_TEST_UTIL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Replaces the global operator new and delete to count the bytes allocated
+// and not freed yet, for tests bounding the memory of a container they
+// cannot hand a memory resource. Include it in one file per test binary.
+
+namespace heap_counter {
+
+inline std::atomic<size_t> in_use{0};
+
+// Every block carries its size in front, at the alignment it was asked for.
+inline void *New(size_t bytes, size_t alignment) {
+  alignment = std::max(alignment, alignof(std::max_align_t));
+  size_t offset = std::max(alignment, sizeof(size_t));
+  void *block = std::aligned_alloc(
+      alignment, (bytes + offset + alignment - 1) / alignment * alignment);
+  if (block == nullptr) {
+    throw std::bad_alloc();
+  }
+  in_use += bytes;
+  auto data = static_cast<char *>(block) + offset;
+  reinterpret_cast<size_t *>(data)[-1] = bytes;
+  return data;
+}
+
+inline void Delete(void *data, size_t alignment) {
+  if (data == nullptr) {
+    return;
+  }
+  alignment = std::max(alignment, alignof(std::max_align_t));
+  size_t offset = std::max(alignment, sizeof(size_t));
+  in_use -= static_cast<size_t *>(data)[-1];
+  std::free(static_cast<char *>(data) - offset);
+}
+
+} // namespace heap_counter
+
+inline size_t HeapInUse() { return heap_counter::in_use.load(); }
+
+void *operator new(size_t bytes) {
+  return heap_counter::New(bytes, alignof(std::max_align_t));
+}
+void *operator new[](size_t bytes) {
+  return heap_counter::New(bytes, alignof(std::max_align_t));
+}
+void *operator new(size_t bytes, std::align_val_t alignment) {
+  return heap_counter::New(bytes, static_cast<size_t>(alignment));
+}
+void *operator new[](size_t bytes, std::align_val_t alignment) {
+  return heap_counter::New(bytes, static_cast<size_t>(alignment));
+}
+void operator delete(void *data) noexcept {
+  heap_counter::Delete(data, alignof(std::max_align_t));
+}
+void operator delete[](void *data) noexcept {
+  heap_counter::Delete(data, alignof(std::max_align_t));
+}
+void operator delete(void *data, size_t) noexcept {
+  heap_counter::Delete(data, alignof(std::max_align_t));
+}
+void operator delete[](void *data, size_t) noexcept {
+  heap_counter::Delete(data, alignof(std::max_align_t));
+}
+void operator delete(void *data, std::align_val_t alignment) noexcept {
+  heap_counter::Delete(data, static_cast<size_t>(alignment));
+}
+void operator delete[](void *data, std::align_val_t alignment) noexcept {
+  heap_counter::Delete(data, static_cast<size_t>(alignment));
+}
+void operator delete(void *data, size_t, std::align_val_t alignment) noexcept {
+  heap_counter::Delete(data, static_cast<size_t>(alignment));
+}
+void operator delete[](void *data, size_t,
+                       std::align_val_t alignment) noexcept {
+  heap_counter::Delete(data, static_cast<size_t>(alignment));
+}
+
+#endif // DEQUE__HEAP_COUNTER_TEST_UTIL_H_
@@ -0,0 +1,153 @@
+#ifndef DEQUE__HUGE_PAGE_RESOURCE_H_
+#define DEQUE__HUGE_PAGE_RESOURCE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <sys/mman.h>
+#include <utility>
+#include <vector>
+
+// Memory resource carving blocks out of large mappings which are aligned to
+// and advised for transparent huge pages, so that a deque spanning
+// gigabytes is covered by a few thousand TLB entries instead of a million:
+//
+//   HugePageResource resource;
+//   Deque<long> deque(&resource);
+//
+// Freed blocks are kept for reuse by blocks of the same size and alignment;
+// the mappings go back to the system only when the resource is destroyed.
+// Not thread-safe.
+class HugePageResource : public std::pmr::memory_resource {
+public:
+  static const size_t kHugePageSize = size_t(2) << 20;
+
+  explicit HugePageResource(size_t region_size = 32 * kHugePageSize);
+  HugePageResource(const HugePageResource &other) = delete;
+  ~HugePageResource() override;
+
+  HugePageResource &operator=(const HugePageResource &other) = delete;
+
+private:
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  struct FreeList {
+    size_t bytes;
+    size_t alignment;
+    FreeBlock *head;
+  };
+
+  void *do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void *block, size_t bytes, size_t alignment) override;
+  bool do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override;
+
+  FreeList *FindFreeList(size_t bytes, size_t alignment);
+  void MapRegion(size_t size);
+
+  size_t region_size_;
+  std::vector<std::pair<char *, size_t>> regions_;
+  char *cursor_ = nullptr;
+  char *limit_ = nullptr;
+  std::vector<FreeList> free_lists_;
+};
+
+inline HugePageResource::HugePageResource(size_t region_size)
+    : region_size_((region_size + kHugePageSize - 1) / kHugePageSize *
+                   kHugePageSize) {}
+
+inline HugePageResource::~HugePageResource() {
+  for (auto [base, size] : regions_) {
+    munmap(base, size);
+  }
+}
+
+inline void *HugePageResource::do_allocate(size_t bytes, size_t alignment) {
+  // A free block has to hold the link to the next one.
+  bytes = std::max(bytes, sizeof(FreeBlock));
+  alignment = std::max(alignment, alignof(FreeBlock));
+  FreeList *list = FindFreeList(bytes, alignment);
+  if (list == nullptr) {
+    // Created here, so that deallocation never allocates.
+    free_lists_.push_back(FreeList{bytes, alignment, nullptr});
+  } else if (list->head != nullptr) {
+    return std::exchange(list->head, list->head->next);
+  }
+
+  auto Carve = [&]() -> char * {
+    auto address = reinterpret_cast<uintptr_t>(cursor_);
+    char *block = cursor_ + (-address & (alignment - 1));
+    return block <= limit_ && size_t(limit_ - block) >= bytes ? block
+                                                             : nullptr;
+  };
+  char *block = cursor_ == nullptr ? nullptr : Carve();
+  if (block == nullptr) {
+    // The rest of the current region is left unused.
+    MapRegion(std::max(region_size_, bytes + alignment));
+    block = Carve();
+  }
+  cursor_ = block + bytes;
+  return block;
+}
+
+inline void HugePageResource::do_deallocate(void *block, size_t bytes,
+                                            size_t alignment) {
+  bytes = std::max(bytes, sizeof(FreeBlock));
+  alignment = std::max(alignment, alignof(FreeBlock));
+  FreeList *list = FindFreeList(bytes, alignment);
+  list->head = new (block) FreeBlock{list->head};
+}
+
+inline bool HugePageResource::do_is_equal(
+    const std::pmr::memory_resource &other) const noexcept {
+  return this == &other;
+}
+
+// A deque asks for one size and alignment per element type, so the lists
+// are few and a linear search is enough.
+inline HugePageResource::FreeList *
+HugePageResource::FindFreeList(size_t bytes, size_t alignment) {
+  for (auto &list : free_lists_) {
+    if (list.bytes == bytes && list.alignment == alignment) {
+      return &list;
+    }
+  }
+  return nullptr;
+}
+
+// Maps size bytes rounded up to huge pages, starting on a huge page
+// boundary, and makes the new region current.
+inline void HugePageResource::MapRegion(size_t size) {
+  size = (size + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+  // Reserved up front, so that recording the mapping cannot throw.
+  regions_.reserve(regions_.size() + 1);
+  // Over-allocate by a huge page and trim both ends to get the alignment.
+  size_t mapped = size + kHugePageSize;
+  void *raw = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED) {
+    throw std::bad_alloc();
+  }
+  auto address = reinterpret_cast<uintptr_t>(raw);
+  size_t head = -address & (kHugePageSize - 1);
+  char *base = static_cast<char *>(raw) + head;
+  if (head != 0) {
+    munmap(raw, head);
+  }
+  if (mapped - head - size != 0) {
+    munmap(base + size, mapped - head - size);
+  }
+#ifdef MADV_HUGEPAGE
+  // Only a hint: without transparent huge pages the region stays usable.
+  madvise(base, size, MADV_HUGEPAGE);
+#endif
+  regions_.emplace_back(base, size);
+  cursor_ = base;
+  limit_ = base + size;
+}
+
+#endif // DEQUE__HUGE_PAGE_RESOURCE_H_
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "deque.h"
+#include "huge_page_resource.h"
+
+namespace {
+
+uintptr_t Address(const void *block) {
+  return reinterpret_cast<uintptr_t>(block);
+}
+
+TEST(HugePageResourceTest, RegionsStartOnHugePages) {
+  HugePageResource resource;
+  EXPECT_EQ(Address(resource.allocate(1, 1)) %
+                HugePageResource::kHugePageSize,
+            0u);
+  // Larger than a region, so it gets a mapping of its own.
+  size_t bytes = 40 * HugePageResource::kHugePageSize;
+  void *large = resource.allocate(bytes, 64);
+  EXPECT_EQ(Address(large) % HugePageResource::kHugePageSize, 0u);
+  std::memset(large, 1, bytes);
+  resource.deallocate(large, bytes, 64);
+}
+
+struct Block {
+  char *data;
+  size_t bytes;
+  size_t alignment;
+  char fill;
+};
+
+// Blocks of mixed sizes and alignments are aligned, do not overlap and keep
+// their contents while others come and go.
+TEST(HugePageResourceTest, BlocksAreAlignedAndDisjoint) {
+  HugePageResource resource(HugePageResource::kHugePageSize);
+  std::mt19937 random(1);
+  std::vector<Block> blocks;
+  auto expect_intact = [](const Block &block) {
+    for (size_t j = 0; j < block.bytes; ++j) {
+      ASSERT_EQ(block.data[j], block.fill);
+    }
+  };
+  for (int i = 0; i < 20'000; ++i) {
+    if (blocks.empty() || random() % 3 != 0) {
+      size_t bytes = size_t(1) << (random() % 13);
+      size_t alignment = size_t(1) << (random() % 8);
+      auto data = static_cast<char *>(resource.allocate(bytes, alignment));
+      ASSERT_EQ(Address(data) % alignment, 0u);
+      auto fill = static_cast<char>(i);
+      std::memset(data, fill, bytes);
+      blocks.push_back(Block{data, bytes, alignment, fill});
+    } else {
+      size_t index = random() % blocks.size();
+      expect_intact(blocks[index]);
+      resource.deallocate(blocks[index].data, blocks[index].bytes,
+                          blocks[index].alignment);
+      blocks[index] = blocks.back();
+      blocks.pop_back();
+    }
+  }
+  for (const Block &block : blocks) {
+    expect_intact(block);
+  }
+}
+
+TEST(HugePageResourceTest, FreedBlocksAreReusedBySameSize) {
+  HugePageResource resource;
+  void *first = resource.allocate(4160, 64);
+  void *second = resource.allocate(4160, 64);
+  resource.deallocate(first, 4160, 64);
+  void *other_size = resource.allocate(2048, 64);
+  EXPECT_NE(other_size, first);
+  EXPECT_EQ(resource.allocate(4160, 64), first);
+  resource.deallocate(second, 4160, 64);
+  // Smaller than the free list link, which is what the block stores.
+  void *tiny = resource.allocate(1, 1);
+  resource.deallocate(tiny, 1, 1);
+  EXPECT_EQ(resource.allocate(2, 2), tiny);
+}
+
+TEST(HugePageResourceTest, BacksDeque) {
+  HugePageResource resource;
+  Deque<std::string> deque(&resource);
+  std::deque<std::string> expected;
+  for (int i = 0; i < 200'000; ++i) {
+    if (i % 3 == 0) {
+      deque.push_front(std::to_string(i));
+      expected.push_front(std::to_string(i));
+    } else {
+      deque.push_back(std::to_string(i));
+      expected.push_back(std::to_string(i));
+    }
+    if (i % 5 == 0) {
+      deque.pop_back();
+      expected.pop_back();
+    }
+  }
+  Deque<std::string> copy = deque;
+  ASSERT_EQ(copy.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_EQ(std::as_const(copy)[i], expected[i]) << "at " << i;
+  }
+  EXPECT_EQ(copy.resource(), &resource);
+}
+
+} // namespace
@@ -0,0 +1,741 @@
+#ifndef DEQUE__SEGMENTED_SEQUENCE_H_
+#define DEQUE__SEGMENTED_SEQUENCE_H_
+
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <sys/types.h>
+#include <type_traits>
+#include <utility>
+
+#include "static_deque.h"
+
+// Sequence with O(log n) random access, insert and erase at any position.
+// Elements live in chunks of up to kChunkSize, which need not be full; the
+// chunks are the nodes of a treap ordered by position, each node counting
+// the elements of its subtree, so an index is found by one descent. An
+// insert into a full chunk splits it and an erase merges a chunk that drops
+// below a quarter of its capacity into a neighbour, so that shifting inside
+// a chunk stays bounded and chunks stay reasonably full.
+//
+// Iterators are bidirectional and cache the chunk, so a traversal costs
+// O(1) per element; nth() finds an index. Any insert or erase invalidates
+// all iterators.
+template <typename T> class SegmentedSequence {
+private:
+  static const size_t kChunkSize = 512;
+
+  struct Node {
+    StaticDeque<T, kChunkSize> chunk;
+    Node *left = nullptr;
+    Node *right = nullptr;
+    Node *parent = nullptr;
+    size_t priority = 0;
+    // Elements in the subtree rooted here.
+    size_t count = 0;
+  };
+
+  template <bool is_const> class CommonIterator;
+
+public:
+  using size_type = size_t;
+  using value_type = T;
+  using reference = T &;
+  using const_reference = const T &;
+  using iterator = CommonIterator<false>;
+  using const_iterator = CommonIterator<true>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  SegmentedSequence();
+  SegmentedSequence(const SegmentedSequence<value_type> &other);
+  ~SegmentedSequence();
+  SegmentedSequence<value_type> &
+  operator=(const SegmentedSequence<value_type> &other);
+
+  [[nodiscard]] size_type size() const;
+
+  reference operator[](size_type pos);
+  const_reference operator[](size_type pos) const;
+  reference at(size_type pos);
+  const_reference at(size_type pos) const;
+
+  void push_back(const_reference value);
+  void pop_back();
+  void push_front(const_reference value);
+  void pop_front();
+
+  iterator begin();
+  const_iterator begin() const;
+  const_iterator cbegin() const;
+  iterator end();
+  const_iterator end() const;
+  const_iterator cend() const;
+
+  reverse_iterator rbegin();
+  const_reverse_iterator rbegin() const;
+  const_reverse_iterator crbegin() const;
+  reverse_iterator rend();
+  const_reverse_iterator rend() const;
+  const_reverse_iterator crend() const;
+
+  // Iterator to the element at pos, or end() for pos == size().
+  iterator nth(size_type pos);
+  const_iterator nth(size_type pos) const;
+
+  iterator insert(const_iterator pos, const_reference value);
+  iterator insert(size_type pos, const_reference value);
+  iterator erase(const_iterator pos);
+  iterator erase(size_type pos);
+
+private:
+  static size_t Count(const Node *node);
+  static void Recount(Node *node);
+  template <typename NodePointer> static NodePointer First(NodePointer node);
+  template <typename NodePointer> static NodePointer Last(NodePointer node);
+  template <typename NodePointer> static NodePointer Next(NodePointer node);
+  template <typename NodePointer> static NodePointer Prev(NodePointer node);
+  static Node *Clone(const Node *node, Node *parent);
+  static void DeleteTree(Node *node);
+
+  // Finds the chunk holding index pos and turns pos into the offset in it.
+  Node *Find(size_t &pos) const;
+  iterator MakeIterator(Node *node, size_t offset) const;
+  void AddCount(Node *node, ssize_t delta);
+  void Replace(Node *node, Node *with);
+  void RotateUp(Node *node);
+  Node *InsertAfter(Node *node);
+  void Remove(Node *node);
+  void MoveBack(Node *from, size_t first, Node *to);
+  size_t NextPriority();
+
+  Node *root_ = nullptr;
+  size_t seed_ = 0x9e3779b97f4a7c15;
+};
+
+template <typename T>
+template <bool is_const>
+class SegmentedSequence<T>::CommonIterator {
+public:
+  using iterator_category = std::bidirectional_iterator_tag;
+  using value_type = T;
+  using difference_type = ssize_t;
+  using pointer = typename std::conditional<is_const, const T *, T *>::type;
+  using reference = typename std::conditional<is_const, const T &, T &>::type;
+  using node_pointer =
+      typename std::conditional<is_const, const Node *, Node *>::type;
+
+  CommonIterator() = default;
+  CommonIterator(node_pointer node, size_t offset);
+
+  CommonIterator<is_const> &operator++();
+  CommonIterator<is_const> &operator--();
+  CommonIterator<is_const> operator++(int);
+  CommonIterator<is_const> operator--(int);
+
+  bool operator==(const CommonIterator<true> &other) const;
+  bool operator!=(const CommonIterator<true> &other) const;
+
+  reference operator*() const;
+  pointer operator->() const;
+
+  operator CommonIterator<true>() const;
+
+  friend class CommonIterator<!is_const>;
+  friend class SegmentedSequence;
+
+private:
+  // end() is one past the last element of the last chunk, and the null
+  // node for an empty sequence.
+  node_pointer node_ = nullptr;
+  size_t offset_ = 0;
+};
+
+template <typename T>
+template <bool is_const>
+SegmentedSequence<T>::CommonIterator<is_const>::CommonIterator(
+    node_pointer node, size_t offset)
+    : node_(node), offset_(offset) {}
+
+template <typename T>
+template <bool is_const>
+typename SegmentedSequence<T>::template CommonIterator<is_const> &
+SegmentedSequence<T>::CommonIterator<is_const>::operator++() {
+  ++offset_;
+  if (offset_ == node_->chunk.size()) {
+    node_pointer next = Next(node_);
+    if (next != nullptr) {
+      node_ = next;
+      offset_ = 0;
+    }
+  }
+  return *this;
+}
+
+template <typename T>
+template <bool is_const>
+typename SegmentedSequence<T>::template CommonIterator<is_const> &
+SegmentedSequence<T>::CommonIterator<is_const>::operator--() {
+  if (offset_ == 0) {
+    node_ = Prev(node_);
+    offset_ = node_->chunk.size();
+  }
+  --offset_;
+  return *this;
+}
+
+template <typename T>
+template <bool is_const>
+typename SegmentedSequence<T>::template CommonIterator<is_const>
+SegmentedSequence<T>::CommonIterator<is_const>::operator++(int) {
+  CommonIterator<is_const> tmp = *this;
+  ++(*this);
+  return tmp;
+}
+
+template <typename T>
+template <bool is_const>
+typename SegmentedSequence<T>::template CommonIterator<is_const>
+SegmentedSequence<T>::CommonIterator<is_const>::operator--(int) {
+  CommonIterator<is_const> tmp = *this;
+  --(*this);
+  return tmp;
+}
+
+template <typename T>
+template <bool is_const>
+bool SegmentedSequence<T>::CommonIterator<is_const>::operator==(
+    const CommonIterator<true> &other) const {
+  return node_ == other.node_ && offset_ == other.offset_;
+}
+
+template <typename T>
+template <bool is_const>
+bool SegmentedSequence<T>::CommonIterator<is_const>::operator!=(
+    const CommonIterator<true> &other) const {
+  return !(*this == other);
+}
+
+template <typename T>
+template <bool is_const>
+typename SegmentedSequence<T>::template CommonIterator<is_const>::reference
+SegmentedSequence<T>::CommonIterator<is_const>::operator*() const {
+  return node_->chunk[offset_];
+}
+
+template <typename T>
+template <bool is_const>
+typename SegmentedSequence<T>::template CommonIterator<is_const>::pointer
+SegmentedSequence<T>::CommonIterator<is_const>::operator->() const {
+  return &node_->chunk[offset_];
+}
+
+template <typename T>
+template <bool is_const>
+SegmentedSequence<T>::CommonIterator<is_const>::operator CommonIterator<true>()
+    const {
+  return CommonIterator<true>(node_, offset_);
+}
+
+/////////////////////////////////////////////// TREE /////////////////////////
+
+template <typename T> size_t SegmentedSequence<T>::Count(const Node *node) {
+  return node == nullptr ? 0 : node->count;
+}
+
+template <typename T> void SegmentedSequence<T>::Recount(Node *node) {
+  node->count = Count(node->left) + node->chunk.size() + Count(node->right);
+}
+
+template <typename T>
+template <typename NodePointer>
+NodePointer SegmentedSequence<T>::First(NodePointer node) {
+  while (node->left != nullptr) {
+    node = node->left;
+  }
+  return node;
+}
+
+template <typename T>
+template <typename NodePointer>
+NodePointer SegmentedSequence<T>::Last(NodePointer node) {
+  while (node->right != nullptr) {
+    node = node->right;
+  }
+  return node;
+}
+
+template <typename T>
+template <typename NodePointer>
+NodePointer SegmentedSequence<T>::Next(NodePointer node) {
+  if (node->right != nullptr) {
+    return First<NodePointer>(node->right);
+  }
+  while (node->parent != nullptr && node->parent->right == node) {
+    node = node->parent;
+  }
+  return node->parent;
+}
+
+template <typename T>
+template <typename NodePointer>
+NodePointer SegmentedSequence<T>::Prev(NodePointer node) {
+  if (node->left != nullptr) {
+    return Last<NodePointer>(node->left);
+  }
+  while (node->parent != nullptr && node->parent->left == node) {
+    node = node->parent;
+  }
+  return node->parent;
+}
+
+template <typename T>
+typename SegmentedSequence<T>::Node *
+SegmentedSequence<T>::Clone(const Node *node, Node *parent) {
+  if (node == nullptr) {
+    return nullptr;
+  }
+  Node *copy = new Node{node->chunk, nullptr, nullptr, parent,
+                        node->priority, node->count};
+  try {
+    copy->left = Clone(node->left, copy);
+    copy->right = Clone(node->right, copy);
+  } catch (...) {
+    DeleteTree(copy);
+    throw;
+  }
+  return copy;
+}
+
+template <typename T> void SegmentedSequence<T>::DeleteTree(Node *node) {
+  if (node == nullptr) {
+    return;
+  }
+  DeleteTree(node->left);
+  DeleteTree(node->right);
+  delete node;
+}
+
+template <typename T>
+typename SegmentedSequence<T>::Node *
+SegmentedSequence<T>::Find(size_t &pos) const {
+  Node *node = root_;
+  while (true) {
+    size_t left = Count(node->left);
+    if (pos < left) {
+      node = node->left;
+      continue;
+    }
+    pos -= left;
+    if (pos < node->chunk.size() || node->right == nullptr) {
+      return node;
+    }
+    pos -= node->chunk.size();
+    node = node->right;
+  }
+}
+
+// Builds an iterator from a position which may be one past the end of a
+// chunk, moving it to the start of the next chunk if there is one.
+template <typename T>
+typename SegmentedSequence<T>::iterator
+SegmentedSequence<T>::MakeIterator(Node *node, size_t offset) const {
+  if (node != nullptr && offset == node->chunk.size()) {
+    Node *next = Next(node);
+    if (next != nullptr) {
+      return iterator(next, 0);
+    }
+  }
+  return iterator(node, offset);
+}
+
+template <typename T>
+void SegmentedSequence<T>::AddCount(Node *node, ssize_t delta) {
+  for (; node != nullptr; node = node->parent) {
+    node->count += delta;
+  }
+}
+
+// Puts with in the place of node under the parent of node.
+template <typename T>
+void SegmentedSequence<T>::Replace(Node *node, Node *with) {
+  Node *parent = node->parent;
+  if (with != nullptr) {
+    with->parent = parent;
+  }
+  if (parent == nullptr) {
+    root_ = with;
+  } else if (parent->left == node) {
+    parent->left = with;
+  } else {
+    parent->right = with;
+  }
+}
+
+// Swaps node with its parent, keeping the order of the chunks.
+template <typename T> void SegmentedSequence<T>::RotateUp(Node *node) {
+  Node *parent = node->parent;
+  Replace(parent, node);
+  if (parent->left == node) {
+    parent->left = node->right;
+    if (node->right != nullptr) {
+      node->right->parent = parent;
+    }
+    node->right = parent;
+  } else {
+    parent->right = node->left;
+    if (node->left != nullptr) {
+      node->left->parent = parent;
+    }
+    node->left = parent;
+  }
+  parent->parent = node;
+  Recount(parent);
+  Recount(node);
+}
+
+// Adds an empty chunk right after node, or first if node is null.
+template <typename T>
+typename SegmentedSequence<T>::Node *
+SegmentedSequence<T>::InsertAfter(Node *node) {
+  Node *created = new Node;
+  created->priority = NextPriority();
+  if (root_ == nullptr) {
+    root_ = created;
+    return created;
+  }
+  if (node == nullptr) {
+    created->parent = First(root_);
+    created->parent->left = created;
+  } else if (node->right == nullptr) {
+    created->parent = node;
+    node->right = created;
+  } else {
+    created->parent = First(node->right);
+    created->parent->left = created;
+  }
+  while (created->parent != nullptr &&
+         created->parent->priority < created->priority) {
+    RotateUp(created);
+  }
+  return created;
+}
+
+// Unlinks and frees node, whose chunk must be empty, so no count changes.
+template <typename T> void SegmentedSequence<T>::Remove(Node *node) {
+  while (node->left != nullptr && node->right != nullptr) {
+    RotateUp(node->left->priority > node->right->priority ? node->left
+                                                          : node->right);
+  }
+  Replace(node, node->left != nullptr ? node->left : node->right);
+  delete node;
+}
+
+// Appends the elements of from, starting at first, to the back of to and
+// drops them from from. Appending them there has to keep the sequence in
+// order: either to is empty and directly follows from, as when splitting,
+// or to directly precedes from and first is 0, as when merging. A throwing
+// copy leaves both chunks unchanged.
+template <typename T>
+void SegmentedSequence<T>::MoveBack(Node *from, size_t first, Node *to) {
+  size_t count = from->chunk.size() - first;
+  size_t moved = 0;
+  try {
+    for (; moved < count; ++moved) {
+      to->chunk.emplace_back(std::move_if_noexcept(from->chunk[first + moved]));
+    }
+  } catch (...) {
+    for (; moved != 0; --moved) {
+      to->chunk.pop_back();
+    }
+    throw;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    from->chunk.pop_back();
+  }
+  AddCount(from, -static_cast<ssize_t>(count));
+  AddCount(to, count);
+}
+
+// xorshift64: treap priorities only need to look random.
+template <typename T> size_t SegmentedSequence<T>::NextPriority() {
+  seed_ ^= seed_ << 13;
+  seed_ ^= seed_ >> 7;
+  seed_ ^= seed_ << 17;
+  return seed_;
+}
+
+/////////////////////////////////////////////// SEQUENCE /////////////////////
+
+template <typename T> SegmentedSequence<T>::SegmentedSequence() = default;
+
+template <typename T>
+SegmentedSequence<T>::SegmentedSequence(
+    const SegmentedSequence<value_type> &other)
+    : root_(Clone(other.root_, nullptr)), seed_(other.seed_) {}
+
+template <typename T> SegmentedSequence<T>::~SegmentedSequence() {
+  DeleteTree(root_);
+}
+
+template <typename T>
+SegmentedSequence<T> &
+SegmentedSequence<T>::operator=(const SegmentedSequence<value_type> &other) {
+  if (this == &other) {
+    return *this;
+  }
+  Node *root = Clone(other.root_, nullptr);
+  DeleteTree(root_);
+  root_ = root;
+  seed_ = other.seed_;
+  return *this;
+}
+
+template <typename T>
+typename SegmentedSequence<T>::size_type SegmentedSequence<T>::size() const {
+  return Count(root_);
+}
+
+template <typename T>
+typename SegmentedSequence<T>::reference
+SegmentedSequence<T>::operator[](size_type pos) {
+  Node *node = Find(pos);
+  return node->chunk[pos];
+}
+
+template <typename T>
+typename SegmentedSequence<T>::const_reference
+SegmentedSequence<T>::operator[](size_type pos) const {
+  const Node *node = Find(pos);
+  return node->chunk[pos];
+}
+
+template <typename T>
+typename SegmentedSequence<T>::reference
+SegmentedSequence<T>::at(size_type pos) {
+  if (size() <= pos) {
+    throw std::out_of_range("out of range");
+  }
+  return operator[](pos);
+}
+
+template <typename T>
+typename SegmentedSequence<T>::const_reference
+SegmentedSequence<T>::at(size_type pos) const {
+  if (size() <= pos) {
+    throw std::out_of_range("out of range");
+  }
+  return operator[](pos);
+}
+
+template <typename T>
+void SegmentedSequence<T>::push_back(const_reference value) {
+  insert(end(), value);
+}
+
+template <typename T> void SegmentedSequence<T>::pop_back() {
+  erase(--end());
+}
+
+template <typename T>
+void SegmentedSequence<T>::push_front(const_reference value) {
+  insert(begin(), value);
+}
+
+template <typename T> void SegmentedSequence<T>::pop_front() {
+  erase(begin());
+}
+
+template <typename T>
+typename SegmentedSequence<T>::iterator SegmentedSequence<T>::begin() {
+  return iterator(root_ == nullptr ? nullptr : First(root_), 0);
+}
+
+template <typename T>
+typename SegmentedSequence<T>::const_iterator
+SegmentedSequence<T>::begin() const {
+  return const_iterator(root_ == nullptr ? nullptr : First(root_), 0);
+}
+
+template <typename T>
+typename SegmentedSequence<T>::const_iterator
+SegmentedSequence<T>::cbegin() const {
+  return begin();
+}
+
+template <typename T>
+typename SegmentedSequence<T>::iterator SegmentedSequence<T>::end() {
+  if (root_ == nullptr) {
+    return iterator();
+  }
+  Node *last = Last(root_);
+  return iterator(last, last->chunk.size());
+}
+
+template <typename T>
+typename SegmentedSequence<T>::const_iterator
+SegmentedSequence<T>::end() const {
+  if (root_ == nullptr) {
+    return const_iterator();
+  }
+  const Node *last = Last<const Node *>(root_);
+  return const_iterator(last, last->chunk.size());
+}
+
+template <typename T>
+typename SegmentedSequence<T>::const_iterator
+SegmentedSequence<T>::cend() const {
+  return end();
+}
+
+template <typename T>
+typename SegmentedSequence<T>::reverse_iterator SegmentedSequence<T>::rbegin() {
+  return reverse_iterator(end());
+}
+
+template <typename T>
+typename SegmentedSequence<T>::const_reverse_iterator
+SegmentedSequence<T>::rbegin() const {
+  return const_reverse_iterator(end());
+}
+
+template <typename T>
+typename SegmentedSequence<T>::const_reverse_iterator
+SegmentedSequence<T>::crbegin() const {
+  return rbegin();
+}
+
+template <typename T>
+typename SegmentedSequence<T>::reverse_iterator SegmentedSequence<T>::rend() {
+  return reverse_iterator(begin());
+}
+
+template <typename T>
+typename SegmentedSequence<T>::const_reverse_iterator
+SegmentedSequence<T>::rend() const {
+  return const_reverse_iterator(begin());
+}
+
+template <typename T>
+typename SegmentedSequence<T>::const_reverse_iterator
+SegmentedSequence<T>::crend() const {
+  return rend();
+}
+
+template <typename T>
+typename SegmentedSequence<T>::iterator
+SegmentedSequence<T>::nth(size_type pos) {
+  if (root_ == nullptr) {
+    return iterator();
+  }
+  Node *node = Find(pos);
+  return MakeIterator(node, pos);
+}
+
+template <typename T>
+typename SegmentedSequence<T>::const_iterator
+SegmentedSequence<T>::nth(size_type pos) const {
+  if (root_ == nullptr) {
+    return const_iterator();
+  }
+  Node *node = Find(pos);
+  return MakeIterator(node, pos);
+}
+
+template <typename T>
+typename SegmentedSequence<T>::iterator
+SegmentedSequence<T>::insert(const_iterator pos, const_reference value) {
+  // value may be an element of this sequence, so copy it before splitting.
+  T tmp = value;
+  Node *node = const_cast<Node *>(pos.node_);
+  size_t offset = pos.offset_;
+  if (node == nullptr) {
+    node = InsertAfter(nullptr);
+  } else if (offset == 0 && node->chunk.size() == kChunkSize &&
+             Prev(node) != nullptr &&
+             Prev(node)->chunk.size() != kChunkSize) {
+    // The end of the previous chunk is the same position.
+    node = Prev(node);
+    offset = node->chunk.size();
+  } else if (node->chunk.size() == kChunkSize) {
+    if (offset == kChunkSize || offset == 0) {
+      // Appending or prepending to a full chunk starts a new one, which
+      // keeps chunks full under push_back and push_front.
+      node = InsertAfter(offset == 0 ? Prev(node) : node);
+      offset = 0;
+    } else {
+      Node *next = InsertAfter(node);
+      try {
+        MoveBack(node, kChunkSize / 2, next);
+      } catch (...) {
+        Remove(next);
+        throw;
+      }
+      if (offset > kChunkSize / 2) {
+        node = next;
+        offset -= kChunkSize / 2;
+      }
+    }
+  }
+  // The new chunk stays empty if this throws; erase never leaves one.
+  try {
+    node->chunk.insert(node->chunk.begin() + offset, std::move(tmp));
+  } catch (...) {
+    if (node->chunk.size() == 0) {
+      Remove(node);
+    }
+    throw;
+  }
+  AddCount(node, 1);
+  return iterator(node, offset);
+}
+
+template <typename T>
+typename SegmentedSequence<T>::iterator
+SegmentedSequence<T>::insert(size_type pos, const_reference value) {
+  return insert(nth(pos), value);
+}
+
+template <typename T>
+typename SegmentedSequence<T>::iterator
+SegmentedSequence<T>::erase(const_iterator pos) {
+  Node *node = const_cast<Node *>(pos.node_);
+  size_t offset = pos.offset_;
+  node->chunk.erase(node->chunk.begin() + offset);
+  AddCount(node, -1);
+  if (node->chunk.size() == 0) {
+    Node *next = Next(node);
+    Remove(node);
+    return next != nullptr ? iterator(next, 0) : end();
+  }
+  if (node->chunk.size() < kChunkSize / 4) {
+    // Merging only saves space: if a copy throws, MoveBack leaves both
+    // chunks as they were and the element stays erased.
+    Node *next = Next(node);
+    Node *prev = Prev(node);
+    try {
+      if (next != nullptr &&
+          node->chunk.size() + next->chunk.size() <= kChunkSize / 2) {
+        MoveBack(next, 0, node);
+        Remove(next);
+      } else if (prev != nullptr &&
+                 prev->chunk.size() + node->chunk.size() <= kChunkSize / 2) {
+        size_t prev_size = prev->chunk.size();
+        MoveBack(node, 0, prev);
+        Remove(node);
+        node = prev;
+        offset += prev_size;
+      }
+    } catch (...) {
+    }
+  }
+  return MakeIterator(node, offset);
+}
+
+template <typename T>
+typename SegmentedSequence<T>::iterator
+SegmentedSequence<T>::erase(size_type pos) {
+  return erase(nth(pos));
+}
+
+#endif // DEQUE__SEGMENTED_SEQUENCE_H_
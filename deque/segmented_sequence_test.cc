@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <deque>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include "heap_counter_test_util.h"
+#include "segmented_sequence.h"
+
+namespace {
+
+template <typename T>
+void ExpectEqual(const SegmentedSequence<T> &sequence,
+                 const std::deque<T> &expected) {
+  ASSERT_EQ(sequence.size(), expected.size());
+  auto it = sequence.begin();
+  for (size_t i = 0; i < expected.size(); ++i, ++it) {
+    ASSERT_EQ(*it, expected[i]) << "at " << i;
+  }
+  ASSERT_TRUE(it == sequence.end());
+  auto rit = expected.rbegin();
+  for (auto it = sequence.rbegin(); it != sequence.rend(); ++it) {
+    ASSERT_EQ(*it, *rit++);
+  }
+}
+
+// Inserts and erases mostly in the middle, growing the sequence through
+// many splits and shrinking it again through many merges.
+TEST(SegmentedSequenceTest, MatchesStdDeque) {
+  std::mt19937 random(1);
+  SegmentedSequence<std::string> sequence;
+  std::deque<std::string> expected;
+  for (int round = 0; round < 4; ++round) {
+    size_t target = round % 2 == 0 ? 10'000 : 100;
+    for (int i = 0; expected.size() != target; ++i) {
+      size_t size = expected.size();
+      if (size < target) {
+        size_t pos = random() % (size + 1);
+        std::string value = std::to_string(i);
+        // Inserting an element of the sequence itself has to copy it first.
+        if (size != 0 && i % 7 == 0) {
+          value = expected[pos % size];
+          ASSERT_EQ(*sequence.insert(pos, sequence[pos % size]), value);
+        } else {
+          ASSERT_EQ(*sequence.insert(sequence.nth(pos), value), value);
+        }
+        expected.insert(expected.begin() + pos, value);
+      } else {
+        size_t pos = random() % size;
+        auto it = i % 2 == 0 ? sequence.erase(pos)
+                             : sequence.erase(sequence.nth(pos));
+        auto expected_it = expected.erase(expected.begin() + pos);
+        if (expected_it == expected.end()) {
+          ASSERT_TRUE(it == sequence.end());
+        } else {
+          ASSERT_EQ(*it, *expected_it);
+        }
+      }
+      if (i % 101 == 0) {
+        size_t index = random() % expected.size();
+        ASSERT_EQ(sequence.at(index), expected[index]);
+        ASSERT_EQ(*sequence.nth(index), expected[index]);
+      }
+    }
+    ExpectEqual(sequence, expected);
+  }
+  EXPECT_THROW(sequence.at(expected.size()), std::out_of_range);
+
+  SegmentedSequence<std::string> copy = sequence;
+  sequence.pop_front();
+  sequence.push_back("x");
+  ExpectEqual(copy, expected);
+  copy = sequence;
+  expected.pop_front();
+  expected.push_back("x");
+  ExpectEqual(copy, expected);
+}
+
+// Chunks which erasing leaves less than a quarter full are merged, so memory
+// follows the size of the sequence down.
+TEST(SegmentedSequenceTest, ErasingMergesChunks) {
+  size_t before = HeapInUse();
+  {
+    SegmentedSequence<long> sequence;
+    for (long i = 0; i < 100 * 512; ++i) {
+      sequence.push_back(i);
+    }
+    size_t chunk = (HeapInUse() - before) / 100;
+    // Keeps every eighth element, taking each chunk from 512 down to 64.
+    long index = 0;
+    for (auto it = sequence.begin(); it != sequence.end(); ++index) {
+      it = index % 8 == 0 ? std::next(it) : sequence.erase(it);
+    }
+    ASSERT_EQ(sequence.size(), 100u * 64);
+    for (size_t i = 0; i < sequence.size(); ++i) {
+      ASSERT_EQ(std::as_const(sequence)[i], static_cast<long>(8 * i));
+    }
+    EXPECT_LE(HeapInUse() - before, 50 * chunk);
+
+    // Erasing all but one element leaves a single chunk.
+    while (sequence.size() > 1) {
+      sequence.erase(sequence.size() / 2);
+    }
+    EXPECT_LE(HeapInUse() - before, chunk);
+    EXPECT_EQ(sequence[0], 0);
+  }
+  EXPECT_EQ(HeapInUse(), before);
+}
+
+// Inserting into the middle of full chunks splits each in halves, which
+// then take further inserts without splitting again.
+TEST(SegmentedSequenceTest, InsertingSplitsFullChunks) {
+  size_t before = HeapInUse();
+  SegmentedSequence<long> sequence;
+  std::deque<long> expected;
+  for (long i = 0; i < 10 * 512; ++i) {
+    sequence.push_back(i);
+    expected.push_back(i);
+  }
+  size_t chunk = (HeapInUse() - before) / 10;
+  for (long i = 0; i < 10; ++i) {
+    size_t pos = static_cast<size_t>(i) * 513 + 100;
+    sequence.insert(pos, -i);
+    expected.insert(expected.begin() + static_cast<long>(pos), -i);
+  }
+  EXPECT_LE(HeapInUse() - before, 20 * chunk);
+  // Every half has room for 255 more.
+  for (long i = 0; i < 10; ++i) {
+    for (long j = 0; j < 255; ++j) {
+      size_t pos = static_cast<size_t>(i) * (513 + 255) + 10;
+      sequence.insert(pos, j);
+      expected.insert(expected.begin() + static_cast<long>(pos), j);
+    }
+  }
+  EXPECT_LE(HeapInUse() - before, 20 * chunk);
+  ExpectEqual(std::as_const(sequence), expected);
+}
+
+// Without a noexcept move, elements are copied into the new chunk of a
+// split, and a throwing copy leaves the sequence as it was.
+struct ThrowingCopy {
+  static inline int live = 0;
+  static inline int copies_left = -1;
+
+  explicit ThrowingCopy(int value) : value(value) { ++live; }
+  ThrowingCopy(const ThrowingCopy &other) : value(other.value) {
+    if (copies_left >= 0 && copies_left-- == 0) {
+      throw std::runtime_error("copy");
+    }
+    ++live;
+  }
+  ThrowingCopy &operator=(const ThrowingCopy &other) = default;
+  ~ThrowingCopy() { --live; }
+
+  int value;
+};
+
+TEST(SegmentedSequenceTest, ThrowingSplitLeavesSequenceUnchanged) {
+  {
+    SegmentedSequence<ThrowingCopy> sequence;
+    for (int i = 0; i < 1024; ++i) {
+      sequence.push_back(ThrowingCopy(i));
+    }
+    for (int copies : {1, 2, 100, 256}) {
+      // The first copy is of the inserted value; the split copies next.
+      ThrowingCopy::copies_left = copies;
+      EXPECT_THROW(sequence.insert(300, ThrowingCopy(-1)), std::runtime_error);
+      ThrowingCopy::copies_left = -1;
+      ASSERT_EQ(sequence.size(), 1024u);
+      int i = 0;
+      for (const auto &value : sequence) {
+        ASSERT_EQ(value.value, i++);
+      }
+      EXPECT_EQ(ThrowingCopy::live, 1024);
+    }
+    sequence.insert(300, ThrowingCopy(-1));
+    EXPECT_EQ(sequence[300].value, -1);
+    EXPECT_EQ(sequence[301].value, 300);
+  }
+  EXPECT_EQ(ThrowingCopy::live, 0);
+}
+
+} // namespace
@@ -0,0 +1,368 @@
+#ifndef DEQUE__SLOT_MAP_H_
+#define DEQUE__SLOT_MAP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "deque.h"
+
+// Names a value in a SlotMap: the index of its slot and the generation the
+// slot had when the value was inserted. A default constructed handle names
+// nothing.
+struct SlotHandle {
+  uint32_t index = 0;
+  uint32_t generation = 0;
+
+  bool operator==(const SlotHandle &other) const {
+    return index == other.index && generation == other.generation;
+  }
+  bool operator!=(const SlotHandle &other) const { return !(*this == other); }
+};
+
+static_assert(sizeof(SlotHandle) == 8, "SlotHandle has to fit 64 bits");
+
+// Pool of values addressed by generational handles, with O(1) insert, erase
+// and lookup. The values live in the slots of a Deque, whose chunks never
+// move, so a value keeps its address until erased. Erased slots are reused
+// most recent first, through a free list threaded through the slots.
+//
+// Every slot counts its generation up on insert and again on erase, so it
+// is odd exactly while the slot holds a value, and a handle to an erased
+// value stops working even after its slot was reused. A slot whose
+// generation would wrap around is retired instead of reused.
+//
+// Iteration visits the values in slot order and skips empty slots, so it
+// takes time in the number of slots rather than values.
+template <typename T> class SlotMap {
+private:
+  template <bool is_const> class CommonIterator;
+
+public:
+  using size_type = size_t;
+  using value_type = T;
+  using reference = T &;
+  using const_reference = const T &;
+  using handle_type = SlotHandle;
+  using iterator = CommonIterator<false>;
+  using const_iterator = CommonIterator<true>;
+
+  SlotMap() = default;
+  explicit SlotMap(std::pmr::memory_resource *resource);
+  SlotMap(const SlotMap &other) = delete;
+  ~SlotMap();
+
+  SlotMap &operator=(const SlotMap &other) = delete;
+
+  [[nodiscard]] size_type size() const;
+  [[nodiscard]] bool empty() const;
+  // Number of slots, with or without a value.
+  [[nodiscard]] size_type capacity() const;
+
+  handle_type insert(const_reference value);
+  template <class... Args> handle_type emplace(Args &&...args);
+  // Returns whether handle named a value.
+  bool erase(handle_type handle);
+  void clear();
+
+  // Returns the value named by handle, or nullptr if it was erased.
+  T *get(handle_type handle);
+  const T *get(handle_type handle) const;
+  [[nodiscard]] bool contains(handle_type handle) const;
+
+  iterator begin();
+  const_iterator begin() const;
+  const_iterator cbegin() const;
+  iterator end();
+  const_iterator end() const;
+  const_iterator cend() const;
+
+private:
+  static const uint32_t kNoSlot = UINT32_MAX;
+
+  // Lets tests take a slot to the end of its generations without 2^31
+  // insertions.
+  friend struct SlotMapTestPeer;
+
+  struct Slot {
+    // Odd while the slot holds a value.
+    uint32_t generation = 0;
+    // Next slot of the free list while the slot is empty.
+    uint32_t next_free = kNoSlot;
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+
+  static T *Value(Slot &slot);
+  static const T *Value(const Slot &slot);
+  static bool Occupied(const Slot &slot);
+
+  Deque<Slot> slots_;
+  uint32_t free_head_ = kNoSlot;
+  size_t size_ = 0;
+};
+
+template <typename T>
+template <bool is_const>
+class SlotMap<T>::CommonIterator {
+public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = T;
+  using difference_type = ssize_t;
+  using pointer = typename std::conditional<is_const, const T *, T *>::type;
+  using reference = typename std::conditional<is_const, const T &, T &>::type;
+
+  CommonIterator() = default;
+  CommonIterator(const CommonIterator<false> &other);
+
+  CommonIterator<is_const> &operator++();
+  CommonIterator<is_const> operator++(int);
+
+  bool operator==(const CommonIterator<true> &other) const;
+  bool operator!=(const CommonIterator<true> &other) const;
+
+  reference operator*();
+  pointer operator->();
+
+  // The handle naming the value the iterator points at.
+  [[nodiscard]] SlotHandle handle() const;
+
+  friend class CommonIterator<!is_const>;
+  friend class SlotMap;
+
+private:
+  using base_iterator =
+      typename std::conditional<is_const,
+                                typename Deque<Slot>::const_iterator,
+                                typename Deque<Slot>::iterator>::type;
+
+  CommonIterator(base_iterator it, base_iterator end, uint32_t index);
+
+  void SkipEmpty();
+
+  base_iterator it_;
+  base_iterator end_;
+  uint32_t index_ = 0;
+};
+
+template <typename T>
+template <bool is_const>
+SlotMap<T>::CommonIterator<is_const>::CommonIterator(base_iterator it,
+                                                      base_iterator end,
+                                                      uint32_t index)
+    : it_(it), end_(end), index_(index) {
+  SkipEmpty();
+}
+
+template <typename T>
+template <bool is_const>
+SlotMap<T>::CommonIterator<is_const>::CommonIterator(
+    const CommonIterator<false> &other)
+    : it_(other.it_), end_(other.end_), index_(other.index_) {}
+
+template <typename T>
+template <bool is_const>
+void SlotMap<T>::CommonIterator<is_const>::SkipEmpty() {
+  while (it_ != end_ && !Occupied(*it_)) {
+    ++it_;
+    ++index_;
+  }
+}
+
+template <typename T>
+template <bool is_const>
+typename SlotMap<T>::template CommonIterator<is_const> &
+SlotMap<T>::CommonIterator<is_const>::operator++() {
+  ++it_;
+  ++index_;
+  SkipEmpty();
+  return *this;
+}
+
+template <typename T>
+template <bool is_const>
+typename SlotMap<T>::template CommonIterator<is_const>
+SlotMap<T>::CommonIterator<is_const>::operator++(int) {
+  CommonIterator<is_const> tmp = *this;
+  ++(*this);
+  return tmp;
+}
+
+template <typename T>
+template <bool is_const>
+bool SlotMap<T>::CommonIterator<is_const>::operator==(
+    const CommonIterator<true> &other) const {
+  return it_ == other.it_;
+}
+
+template <typename T>
+template <bool is_const>
+bool SlotMap<T>::CommonIterator<is_const>::operator!=(
+    const CommonIterator<true> &other) const {
+  return it_ != other.it_;
+}
+
+template <typename T>
+template <bool is_const>
+typename SlotMap<T>::template CommonIterator<is_const>::reference
+SlotMap<T>::CommonIterator<is_const>::operator*() {
+  return *Value(*it_);
+}
+
+template <typename T>
+template <bool is_const>
+typename SlotMap<T>::template CommonIterator<is_const>::pointer
+SlotMap<T>::CommonIterator<is_const>::operator->() {
+  return Value(*it_);
+}
+
+template <typename T>
+template <bool is_const>
+SlotHandle SlotMap<T>::CommonIterator<is_const>::handle() const {
+  base_iterator it = it_;
+  return SlotHandle{index_, (*it).generation};
+}
+
+template <typename T>
+SlotMap<T>::SlotMap(std::pmr::memory_resource *resource) : slots_(resource) {}
+
+template <typename T> SlotMap<T>::~SlotMap() { clear(); }
+
+template <typename T> typename SlotMap<T>::size_type SlotMap<T>::size() const {
+  return size_;
+}
+
+template <typename T> bool SlotMap<T>::empty() const { return size_ == 0; }
+
+template <typename T>
+typename SlotMap<T>::size_type SlotMap<T>::capacity() const {
+  return slots_.size();
+}
+
+template <typename T> SlotHandle SlotMap<T>::insert(const_reference value) {
+  return emplace(value);
+}
+
+template <typename T>
+template <class... Args>
+SlotHandle SlotMap<T>::emplace(Args &&...args) {
+  uint32_t index = free_head_;
+  bool appended = index == kNoSlot;
+  if (appended) {
+    // kNoSlot itself is no index, and slot indices have to fit a handle.
+    if (slots_.size() >= kNoSlot) {
+      throw std::length_error("SlotMap is full");
+    }
+    slots_.emplace_back();
+    index = static_cast<uint32_t>(slots_.size() - 1);
+  }
+  Slot &slot = slots_[index];
+  try {
+    new (slot.storage) T(std::forward<Args>(args)...);
+  } catch (...) {
+    if (appended) {
+      slots_.pop_back();
+    }
+    throw;
+  }
+  if (!appended) {
+    free_head_ = slot.next_free;
+  }
+  ++slot.generation;
+  ++size_;
+  return SlotHandle{index, slot.generation};
+}
+
+template <typename T> bool SlotMap<T>::erase(SlotHandle handle) {
+  T *value = get(handle);
+  if (value == nullptr) {
+    return false;
+  }
+  Slot &slot = slots_[handle.index];
+  value->~T();
+  ++slot.generation;
+  --size_;
+  // Past this the generation would repeat and old handles could match.
+  if (slot.generation != 0) {
+    slot.next_free = free_head_;
+    free_head_ = handle.index;
+  }
+  return true;
+}
+
+template <typename T> void SlotMap<T>::clear() {
+  if constexpr (!std::is_trivially_destructible_v<T>) {
+    for (auto &value : *this) {
+      value.~T();
+    }
+  }
+  slots_ = Deque<Slot>(slots_.resource());
+  free_head_ = kNoSlot;
+  size_ = 0;
+}
+
+template <typename T> T *SlotMap<T>::get(SlotHandle handle) {
+  return const_cast<T *>(std::as_const(*this).get(handle));
+}
+
+template <typename T> const T *SlotMap<T>::get(SlotHandle handle) const {
+  if (handle.index >= slots_.size()) {
+    return nullptr;
+  }
+  const Slot &slot = slots_[handle.index];
+  if (slot.generation != handle.generation || !Occupied(slot)) {
+    return nullptr;
+  }
+  return Value(slot);
+}
+
+template <typename T> bool SlotMap<T>::contains(SlotHandle handle) const {
+  return get(handle) != nullptr;
+}
+
+template <typename T> typename SlotMap<T>::iterator SlotMap<T>::begin() {
+  return iterator(slots_.begin(), slots_.end(), 0);
+}
+
+template <typename T>
+typename SlotMap<T>::const_iterator SlotMap<T>::begin() const {
+  return const_iterator(slots_.begin(), slots_.end(), 0);
+}
+
+template <typename T>
+typename SlotMap<T>::const_iterator SlotMap<T>::cbegin() const {
+  return begin();
+}
+
+template <typename T> typename SlotMap<T>::iterator SlotMap<T>::end() {
+  auto end = slots_.end();
+  return iterator(end, end, static_cast<uint32_t>(slots_.size()));
+}
+
+template <typename T>
+typename SlotMap<T>::const_iterator SlotMap<T>::end() const {
+  auto end = slots_.end();
+  return const_iterator(end, end, static_cast<uint32_t>(slots_.size()));
+}
+
+template <typename T>
+typename SlotMap<T>::const_iterator SlotMap<T>::cend() const {
+  return end();
+}
+
+template <typename T> T *SlotMap<T>::Value(Slot &slot) {
+  return std::launder(reinterpret_cast<T *>(slot.storage));
+}
+
+template <typename T> const T *SlotMap<T>::Value(const Slot &slot) {
+  return std::launder(reinterpret_cast<const T *>(slot.storage));
+}
+
+template <typename T> bool SlotMap<T>::Occupied(const Slot &slot) {
+  return slot.generation % 2 == 1;
+}
+
+#endif // DEQUE__SLOT_MAP_H_
@@ -0,0 +1,157 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "slot_map.h"
+
+struct SlotMapTestPeer {
+  template <typename T>
+  static void SetGeneration(SlotMap<T> &map, uint32_t index,
+                            uint32_t generation) {
+    map.slots_[index].generation = generation;
+  }
+};
+
+namespace {
+
+// Orders handles by slot, which is the order of iteration.
+struct HandleLess {
+  bool operator()(const SlotHandle &a, const SlotHandle &b) const {
+    return a.index != b.index ? a.index < b.index
+                              : a.generation < b.generation;
+  }
+};
+
+TEST(SlotMapTest, StaleHandlesStopWorking) {
+  SlotMap<std::string> map;
+  SlotHandle first = map.insert("first");
+  EXPECT_EQ(*map.get(first), "first");
+  EXPECT_TRUE(map.erase(first));
+  EXPECT_FALSE(map.erase(first));
+
+  // The slot is reused with a new generation.
+  SlotHandle second = map.insert("second");
+  EXPECT_EQ(second.index, first.index);
+  EXPECT_NE(second.generation, first.generation);
+  EXPECT_EQ(map.get(first), nullptr);
+  EXPECT_FALSE(map.contains(first));
+  EXPECT_FALSE(map.erase(first));
+  EXPECT_EQ(*map.get(second), "second");
+  EXPECT_EQ(map.size(), 1u);
+
+  EXPECT_FALSE(map.contains(SlotHandle{}));
+  EXPECT_FALSE(map.contains(SlotHandle{7, 1}));
+}
+
+// Handles to erased values are kept and tried again later, when their slots
+// have been reused any number of times.
+TEST(SlotMapTest, MatchesReference) {
+  std::mt19937 random(1);
+  SlotMap<std::string> map;
+  std::map<SlotHandle, std::string, HandleLess> expected;
+  std::vector<SlotHandle> stale;
+  std::map<SlotHandle, const std::string *, HandleLess> addresses;
+  for (int i = 0; i < 50'000; ++i) {
+    if (expected.empty() || random() % 5 < 3) {
+      SlotHandle handle = i % 2 == 0 ? map.insert(std::to_string(i))
+                                     : map.emplace(3, 'a' + i % 26);
+      ASSERT_EQ(expected.count(handle), 0u);
+      expected[handle] = *map.get(handle);
+      addresses[handle] = map.get(handle);
+    } else {
+      auto it = std::next(expected.begin(),
+                          static_cast<long>(random() % expected.size()));
+      ASSERT_TRUE(map.erase(it->first));
+      stale.push_back(it->first);
+      addresses.erase(it->first);
+      expected.erase(it);
+    }
+    if (i % 1000 == 0) {
+      for (SlotHandle handle : stale) {
+        ASSERT_FALSE(map.contains(handle));
+      }
+      // Values keep their addresses while the slots grow.
+      for (auto [handle, address] : addresses) {
+        ASSERT_EQ(map.get(handle), address);
+      }
+    }
+  }
+  ASSERT_EQ(map.size(), expected.size());
+  for (const auto &[handle, value] : expected) {
+    ASSERT_EQ(*map.get(handle), value);
+  }
+  // Iteration visits the values in slot order, with their handles.
+  auto it = map.begin();
+  for (const auto &[handle, value] : expected) {
+    ASSERT_TRUE(it != map.end());
+    ASSERT_EQ(it.handle(), handle);
+    ASSERT_EQ(*it, value);
+    ++it;
+  }
+  EXPECT_TRUE(it == map.end());
+  for (SlotHandle handle : stale) {
+    ASSERT_FALSE(map.erase(handle));
+  }
+}
+
+// A slot whose generation would wrap around to a value old handles carry is
+// not reused.
+TEST(SlotMapTest, SlotsAreRetiredBeforeGenerationsRepeat) {
+  SlotMap<int> map;
+  SlotHandle first = map.insert(1);
+  map.erase(first);
+  SlotMapTestPeer::SetGeneration(map, first.index, UINT32_MAX - 1);
+
+  SlotHandle last = map.insert(2);
+  EXPECT_EQ(last.index, first.index);
+  EXPECT_EQ(last.generation, UINT32_MAX);
+  EXPECT_EQ(*map.get(last), 2);
+  EXPECT_TRUE(map.erase(last));
+
+  // The generation wrapped to 0, which no handle to a value carries.
+  SlotHandle next = map.insert(3);
+  EXPECT_NE(next.index, first.index);
+  EXPECT_EQ(map.capacity(), 2u);
+  EXPECT_FALSE(map.contains(last));
+  EXPECT_FALSE(map.contains(first));
+  EXPECT_FALSE(map.contains(SlotHandle{first.index, 0}));
+  EXPECT_FALSE(map.contains(SlotHandle{first.index, 1}));
+  for (int i = 0; i < 10; ++i) {
+    map.erase(map.insert(i));
+  }
+  EXPECT_EQ(map.capacity(), 3u);
+  ASSERT_TRUE(map.begin() != map.end());
+  EXPECT_EQ(map.begin().handle(), next);
+  EXPECT_EQ(map.size(), 1u);
+}
+
+struct ThrowingConstructor {
+  explicit ThrowingConstructor(bool fail) {
+    if (fail) {
+      throw std::runtime_error("constructor");
+    }
+  }
+};
+
+TEST(SlotMapTest, ThrowingEmplaceLeavesMapUnchanged) {
+  SlotMap<ThrowingConstructor> map;
+  SlotHandle kept = map.emplace(false);
+  EXPECT_THROW(map.emplace(true), std::runtime_error);
+  EXPECT_EQ(map.capacity(), 1u);
+  SlotHandle erased = map.emplace(false);
+  map.erase(erased);
+  EXPECT_THROW(map.emplace(true), std::runtime_error);
+  // The free slot is still free, with the same generation ahead of it.
+  SlotHandle reused = map.emplace(false);
+  EXPECT_EQ(reused.index, erased.index);
+  EXPECT_EQ(reused.generation, erased.generation + 2);
+  EXPECT_EQ(map.size(), 2u);
+  EXPECT_TRUE(map.contains(kept));
+}
+
+} // namespace
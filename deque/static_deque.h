@@ -0,0 +1,606 @@
+#ifndef DEQUE__STATIC_DEQUE_H_
+#define DEQUE__STATIC_DEQUE_H_
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <sys/types.h>
+#include <type_traits>
+#include <utility>
+
+// Deque of at most N elements kept in a ring buffer inside the object, so it
+// never allocates. Every member is constexpr; with a T that is usable in
+// constant expressions the whole container is as well. When N is a power of
+// two positions wrap with a mask instead of a comparison.
+//
+// Pushing to a full StaticDeque throws std::length_error.
+template <typename T, size_t N> class StaticDeque {
+  static_assert(N > 0, "StaticDeque needs room for at least one element");
+
+private:
+  template <bool is_const> class CommonIterator;
+
+  // Storage for one element, which starts its lifetime only on construct_at.
+  union Slot {
+    constexpr Slot() : empty() {}
+    constexpr ~Slot()
+      requires std::is_trivially_destructible_v<T>
+    = default;
+    constexpr ~Slot() {}
+
+    char empty;
+    T value;
+  };
+
+public:
+  using size_type = size_t;
+  using value_type = T;
+  using reference = T &;
+  using const_reference = const T &;
+  using iterator = CommonIterator<false>;
+  using const_iterator = CommonIterator<true>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  constexpr StaticDeque();
+  constexpr ~StaticDeque()
+    requires std::is_trivially_destructible_v<T>
+  = default;
+  constexpr ~StaticDeque();
+  constexpr StaticDeque(const StaticDeque &other);
+  constexpr explicit StaticDeque(size_type count);
+  constexpr StaticDeque(size_type count, const_reference value);
+  constexpr StaticDeque &operator=(const StaticDeque &other);
+
+  [[nodiscard]] constexpr size_type size() const;
+  [[nodiscard]] static constexpr size_type capacity();
+
+  constexpr reference operator[](size_type pos);
+  constexpr const_reference operator[](size_type pos) const;
+  constexpr reference at(size_type pos);
+  constexpr const_reference at(size_type pos) const;
+
+  constexpr void push_back(const_reference value);
+  constexpr void pop_back();
+  constexpr void push_front(const_reference value);
+  constexpr void pop_front();
+
+  constexpr iterator begin();
+  constexpr const_iterator begin() const;
+  constexpr const_iterator cbegin() const;
+  constexpr iterator end();
+  constexpr const_iterator end() const;
+  constexpr const_iterator cend() const;
+
+  constexpr reverse_iterator rbegin();
+  constexpr const_reverse_iterator rbegin() const;
+  constexpr const_reverse_iterator crbegin() const;
+  constexpr reverse_iterator rend();
+  constexpr const_reverse_iterator rend() const;
+  constexpr const_reverse_iterator crend() const;
+
+  constexpr iterator insert(const_iterator pos, const_reference value);
+  template <class... Args> constexpr void emplace_back(Args &&...args);
+  constexpr iterator erase(const_iterator pos);
+
+private:
+  static constexpr bool kPowerOfTwo = (N & (N - 1)) == 0;
+
+  // Maps a position in [0, 2N) to its slot.
+  static constexpr size_t Wrap(size_t pos);
+
+  constexpr T &Get(size_t pos);
+  constexpr const T &Get(size_t pos) const;
+  constexpr void CheckFull() const;
+  constexpr void Clear();
+
+  Slot slots_[N];
+  // Slot of the first element; elements occupy head_ .. head_ + size_ - 1.
+  size_t head_ = 0;
+  size_t size_ = 0;
+};
+
+template <typename T, size_t N>
+template <bool is_const>
+class StaticDeque<T, N>::CommonIterator {
+public:
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = T;
+  using difference_type = ssize_t;
+  using pointer = typename std::conditional<is_const, const T *, T *>::type;
+  using reference = typename std::conditional<is_const, const T &, T &>::type;
+  using slot_pointer =
+      typename std::conditional<is_const, const Slot *, Slot *>::type;
+
+  constexpr CommonIterator() = default;
+  constexpr CommonIterator(slot_pointer slots, size_t pos);
+
+  constexpr CommonIterator<is_const> &operator++();
+  constexpr CommonIterator<is_const> &operator--();
+  constexpr CommonIterator<is_const> operator++(int);
+  constexpr CommonIterator<is_const> operator--(int);
+
+  constexpr CommonIterator<is_const> &operator+=(difference_type shift);
+  constexpr CommonIterator<is_const> &operator-=(difference_type shift);
+  constexpr CommonIterator<is_const> operator+(difference_type shift) const;
+  constexpr CommonIterator<is_const> operator-(difference_type shift) const;
+
+  constexpr bool operator<(const CommonIterator<true> &other) const;
+  constexpr bool operator>(const CommonIterator<true> &other) const;
+  constexpr bool operator<=(const CommonIterator<true> &other) const;
+  constexpr bool operator>=(const CommonIterator<true> &other) const;
+  constexpr bool operator==(const CommonIterator<true> &other) const;
+  constexpr bool operator!=(const CommonIterator<true> &other) const;
+
+  constexpr difference_type
+  operator-(const CommonIterator<is_const> &other) const;
+  constexpr reference operator*() const;
+  constexpr pointer operator->() const;
+
+  constexpr operator CommonIterator<true>() const;
+
+  friend class CommonIterator<!is_const>;
+  friend class StaticDeque;
+
+private:
+  slot_pointer slots_ = nullptr;
+  // Unwrapped position, so that end() stays apart from begin() when full.
+  size_t pos_ = 0;
+};
+
+template <typename T, size_t N>
+template <bool is_const>
+constexpr StaticDeque<T, N>::CommonIterator<is_const>::CommonIterator(
+    slot_pointer slots, size_t pos)
+    : slots_(slots), pos_(pos) {}
+
+template <typename T, size_t N>
+template <bool is_const>
+constexpr typename StaticDeque<T, N>::template CommonIterator<is_const> &
+StaticDeque<T, N>::CommonIterator<is_const>::operator++() {
+  ++pos_;
+  return *this;
+}
+
+template <typename T, size_t N>
+template <bool is_const>
+constexpr typename StaticDeque<T, N>::template CommonIterator<is_const> &
+StaticDeque<T, N>::CommonIterator<is_const>::operator--() {
+  --pos_;
+  return *this;
+}
+
+template <typename T, size_t N>
+template <bool is_const>
+constexpr typename StaticDeque<T, N>::template CommonIterator<is_const>
+StaticDeque<T, N>::CommonIterator<is_const>::operator++(int) {
+  CommonIterator<is_const> tmp = *this;
+  ++(*this);
+  return tmp;
+}
+
+template <typename T, size_t N>
+template <bool is_const>
+constexpr typename StaticDeque<T, N>::template CommonIterator<is_const>
+StaticDeque<T, N>::CommonIterator<is_const>::operator--(int) {
+  CommonIterator<is_const> tmp = *this;
+  --(*this);
+  return tmp;
+}
+
+template <typename T, size_t N>
+template <bool is_const>
+constexpr typename StaticDeque<T, N>::template CommonIterator<is_const> &
+StaticDeque<T, N>::CommonIterator<is_const>::operator+=(
+    difference_type shift) {
+  pos_ += shift;
+  return *this;
+}
+
+template <typename T, size_t N>
+template <bool is_const>
+constexpr typename StaticDeque<T, N>::template CommonIterator<is_const> &
+StaticDeque<T, N>::CommonIterator<is_const>::operator-=(
+    difference_type shift) {
+  pos_ -= shift;
+  return *this;
+}
+
+template <typename T, size_t N>
+template <bool is_const>
+constexpr typename StaticDeque<T, N>::template CommonIterator<is_const>
+StaticDeque<T, N>::CommonIterator<is_const>::operator+(
+    difference_type shift) const {
+  CommonIterator<is_const> tmp = *this;
+  tmp += shift;
+  return tmp;
+}
+
+template <typename T, size_t N>
+template <bool is_const>
+constexpr typename StaticDeque<T, N>::template CommonIterator<is_const>
+StaticDeque<T, N>::CommonIterator<is_const>::operator-(
+    difference_type shift) const {
+  CommonIterator<is_const> tmp = *this;
+  tmp -= shift;
+  return tmp;
+}
+
+template <typename T, size_t N>
+template <bool is_const>
+constexpr bool StaticDeque<T, N>::CommonIterator<is_const>::operator<(
+    const CommonIterator<true> &other) const {
+  return pos_ < other.pos_;
+}
+
+template <typename T, size_t N>
+template <bool is_const>
+constexpr bool StaticDeque<T, N>::CommonIterator<is_const>::operator>(
+    const CommonIterator<true> &other) const {
+  return other < *this;
+}
+
+template <typename T, size_t N>
+template <bool is_const>
+constexpr bool StaticDeque<T, N>::CommonIterator<is_const>::operator<=(
+    const CommonIterator<true> &other) const {
+  return !(*this > other);
+}
+
+template <typename T, size_t N>
+template <bool is_const>
+constexpr bool StaticDeque<T, N>::CommonIterator<is_const>::operator>=(
+    const CommonIterator<true> &other) const {
+  return !(*this < other);
+}
+
+template <typename T, size_t N>
+template <bool is_const>
+constexpr bool StaticDeque<T, N>::CommonIterator<is_const>::operator==(
+    const CommonIterator<true> &other) const {
+  return pos_ == other.pos_;
+}
+
+template <typename T, size_t N>
+template <bool is_const>
+constexpr bool StaticDeque<T, N>::CommonIterator<is_const>::operator!=(
+    const CommonIterator<true> &other) const {
+  return !(*this == other);
+}
+
+template <typename T, size_t N>
+template <bool is_const>
+constexpr typename StaticDeque<T, N>::template CommonIterator<
+    is_const>::difference_type
+StaticDeque<T, N>::CommonIterator<is_const>::operator-(
+    const CommonIterator<is_const> &other) const {
+  return static_cast<difference_type>(pos_ - other.pos_);
+}
+
+template <typename T, size_t N>
+template <bool is_const>
+constexpr typename StaticDeque<T, N>::template CommonIterator<
+    is_const>::reference
+StaticDeque<T, N>::CommonIterator<is_const>::operator*() const {
+  return slots_[Wrap(pos_)].value;
+}
+
+template <typename T, size_t N>
+template <bool is_const>
+constexpr typename StaticDeque<T, N>::template CommonIterator<
+    is_const>::pointer
+StaticDeque<T, N>::CommonIterator<is_const>::operator->() const {
+  return &slots_[Wrap(pos_)].value;
+}
+
+template <typename T, size_t N>
+template <bool is_const>
+constexpr StaticDeque<T, N>::CommonIterator<
+    is_const>::operator CommonIterator<true>() const {
+  return CommonIterator<true>(slots_, pos_);
+}
+
+/////////////////////////////////////////////// DEQUE ////////////////////////
+
+template <typename T, size_t N>
+constexpr size_t StaticDeque<T, N>::Wrap(size_t pos) {
+  if constexpr (kPowerOfTwo) {
+    return pos & (N - 1);
+  } else {
+    return pos < N ? pos : pos - N;
+  }
+}
+
+template <typename T, size_t N>
+constexpr T &StaticDeque<T, N>::Get(size_t pos) {
+  return slots_[Wrap(head_ + pos)].value;
+}
+
+template <typename T, size_t N>
+constexpr const T &StaticDeque<T, N>::Get(size_t pos) const {
+  return slots_[Wrap(head_ + pos)].value;
+}
+
+template <typename T, size_t N>
+constexpr void StaticDeque<T, N>::CheckFull() const {
+  if (size_ == N) {
+    throw std::length_error("StaticDeque is full");
+  }
+}
+
+template <typename T, size_t N> constexpr void StaticDeque<T, N>::Clear() {
+  while (size_ != 0) {
+    pop_back();
+  }
+  head_ = 0;
+}
+
+template <typename T, size_t N> constexpr StaticDeque<T, N>::StaticDeque() {}
+
+template <typename T, size_t N> constexpr StaticDeque<T, N>::~StaticDeque() {
+  Clear();
+}
+
+template <typename T, size_t N>
+constexpr StaticDeque<T, N>::StaticDeque(const StaticDeque &other) {
+  try {
+    for (size_t i = 0; i < other.size_; ++i) {
+      emplace_back(other.Get(i));
+    }
+  } catch (...) {
+    Clear();
+    throw;
+  }
+}
+
+template <typename T, size_t N>
+constexpr StaticDeque<T, N>::StaticDeque(size_type count) {
+  if (count > N) {
+    throw std::length_error("StaticDeque is full");
+  }
+  try {
+    for (size_t i = 0; i < count; ++i) {
+      emplace_back();
+    }
+  } catch (...) {
+    Clear();
+    throw;
+  }
+}
+
+template <typename T, size_t N>
+constexpr StaticDeque<T, N>::StaticDeque(size_type count,
+                                         const_reference value) {
+  if (count > N) {
+    throw std::length_error("StaticDeque is full");
+  }
+  try {
+    for (size_t i = 0; i < count; ++i) {
+      emplace_back(value);
+    }
+  } catch (...) {
+    Clear();
+    throw;
+  }
+}
+
+template <typename T, size_t N>
+constexpr StaticDeque<T, N> &
+StaticDeque<T, N>::operator=(const StaticDeque &other) {
+  if (this == &other) {
+    return *this;
+  }
+  // The storage cannot be swapped cheaply, so a throwing copy leaves this
+  // deque empty instead of unchanged.
+  Clear();
+  try {
+    for (size_t i = 0; i < other.size_; ++i) {
+      emplace_back(other.Get(i));
+    }
+  } catch (...) {
+    Clear();
+    throw;
+  }
+  return *this;
+}
+
+template <typename T, size_t N>
+constexpr typename StaticDeque<T, N>::size_type
+StaticDeque<T, N>::size() const {
+  return size_;
+}
+
+template <typename T, size_t N>
+constexpr typename StaticDeque<T, N>::size_type StaticDeque<T, N>::capacity() {
+  return N;
+}
+
+template <typename T, size_t N>
+constexpr typename StaticDeque<T, N>::reference
+StaticDeque<T, N>::operator[](size_type pos) {
+  return Get(pos);
+}
+
+template <typename T, size_t N>
+constexpr typename StaticDeque<T, N>::const_reference
+StaticDeque<T, N>::operator[](size_type pos) const {
+  return Get(pos);
+}
+
+template <typename T, size_t N>
+constexpr typename StaticDeque<T, N>::reference
+StaticDeque<T, N>::at(size_type pos) {
+  if (size_ <= pos) {
+    throw std::out_of_range("out of range");
+  }
+  return Get(pos);
+}
+
+template <typename T, size_t N>
+constexpr typename StaticDeque<T, N>::const_reference
+StaticDeque<T, N>::at(size_type pos) const {
+  if (size_ <= pos) {
+    throw std::out_of_range("out of range");
+  }
+  return Get(pos);
+}
+
+template <typename T, size_t N>
+template <class... Args>
+constexpr void StaticDeque<T, N>::emplace_back(Args &&...args) {
+  CheckFull();
+  std::construct_at(&slots_[Wrap(head_ + size_)].value,
+                    std::forward<Args>(args)...);
+  ++size_;
+}
+
+template <typename T, size_t N>
+constexpr void StaticDeque<T, N>::push_back(const_reference value) {
+  emplace_back(value);
+}
+
+template <typename T, size_t N> constexpr void StaticDeque<T, N>::pop_back() {
+  --size_;
+  std::destroy_at(&Get(size_));
+}
+
+template <typename T, size_t N>
+constexpr void StaticDeque<T, N>::push_front(const_reference value) {
+  CheckFull();
+  size_t head = Wrap(head_ + N - 1);
+  std::construct_at(&slots_[head].value, value);
+  head_ = head;
+  ++size_;
+}
+
+template <typename T, size_t N> constexpr void StaticDeque<T, N>::pop_front() {
+  std::destroy_at(&Get(0));
+  head_ = Wrap(head_ + 1);
+  --size_;
+}
+
+template <typename T, size_t N>
+constexpr typename StaticDeque<T, N>::iterator StaticDeque<T, N>::begin() {
+  return iterator(slots_, head_);
+}
+
+template <typename T, size_t N>
+constexpr typename StaticDeque<T, N>::const_iterator
+StaticDeque<T, N>::begin() const {
+  return const_iterator(slots_, head_);
+}
+
+template <typename T, size_t N>
+constexpr typename StaticDeque<T, N>::const_iterator
+StaticDeque<T, N>::cbegin() const {
+  return begin();
+}
+
+template <typename T, size_t N>
+constexpr typename StaticDeque<T, N>::iterator StaticDeque<T, N>::end() {
+  return iterator(slots_, head_ + size_);
+}
+
+template <typename T, size_t N>
+constexpr typename StaticDeque<T, N>::const_iterator
+StaticDeque<T, N>::end() const {
+  return const_iterator(slots_, head_ + size_);
+}
+
+template <typename T, size_t N>
+constexpr typename StaticDeque<T, N>::const_iterator
+StaticDeque<T, N>::cend() const {
+  return end();
+}
+
+template <typename T, size_t N>
+constexpr typename StaticDeque<T, N>::reverse_iterator
+StaticDeque<T, N>::rbegin() {
+  return reverse_iterator(end());
+}
+
+template <typename T, size_t N>
+constexpr typename StaticDeque<T, N>::const_reverse_iterator
+StaticDeque<T, N>::rbegin() const {
+  return const_reverse_iterator(end());
+}
+
+template <typename T, size_t N>
+constexpr typename StaticDeque<T, N>::const_reverse_iterator
+StaticDeque<T, N>::crbegin() const {
+  return const_reverse_iterator(end());
+}
+
+template <typename T, size_t N>
+constexpr typename StaticDeque<T, N>::reverse_iterator
+StaticDeque<T, N>::rend() {
+  return reverse_iterator(begin());
+}
+
+template <typename T, size_t N>
+constexpr typename StaticDeque<T, N>::const_reverse_iterator
+StaticDeque<T, N>::rend() const {
+  return const_reverse_iterator(begin());
+}
+
+template <typename T, size_t N>
+constexpr typename StaticDeque<T, N>::const_reverse_iterator
+StaticDeque<T, N>::crend() const {
+  return const_reverse_iterator(begin());
+}
+
+template <typename T, size_t N>
+constexpr typename StaticDeque<T, N>::iterator
+StaticDeque<T, N>::insert(const_iterator pos, const_reference value) {
+  CheckFull();
+  // value may be an element of this deque, so copy it before shifting.
+  T tmp = value;
+  size_t index = pos.pos_ - head_;
+  // Whichever side of pos is shorter moves by one slot.
+  if (index < size_ / 2) {
+    size_t head = Wrap(head_ + N - 1);
+    if (index == 0) {
+      std::construct_at(&slots_[head].value, std::move(tmp));
+    } else {
+      std::construct_at(&slots_[head].value, std::move(Get(0)));
+      for (size_t i = 1; i < index; ++i) {
+        Get(i - 1) = std::move(Get(i));
+      }
+      Get(index - 1) = std::move(tmp);
+    }
+    head_ = head;
+  } else {
+    if (index == size_) {
+      std::construct_at(&Get(size_), std::move(tmp));
+    } else {
+      std::construct_at(&Get(size_), std::move(Get(size_ - 1)));
+      for (size_t i = size_ - 1; i > index; --i) {
+        Get(i) = std::move(Get(i - 1));
+      }
+      Get(index) = std::move(tmp);
+    }
+  }
+  ++size_;
+  return begin() + index;
+}
+
+template <typename T, size_t N>
+constexpr typename StaticDeque<T, N>::iterator
+StaticDeque<T, N>::erase(const_iterator pos) {
+  size_t index = pos.pos_ - head_;
+  if (index < size_ / 2) {
+    for (size_t i = index; i > 0; --i) {
+      Get(i) = std::move(Get(i - 1));
+    }
+    pop_front();
+  } else {
+    for (size_t i = index + 1; i < size_; ++i) {
+      Get(i - 1) = std::move(Get(i));
+    }
+    pop_back();
+  }
+  return begin() + index;
+}
+
+#endif // DEQUE__STATIC_DEQUE_H_
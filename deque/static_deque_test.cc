@@ -0,0 +1,196 @@
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <deque>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#include "static_deque.h"
+
+namespace {
+
+// Runs in a constant expression: pushes at both ends wrap the ring around
+// its end, and insert and erase shift across the wrap.
+constexpr int ConstantSum() {
+  StaticDeque<int, 5> deque;
+  for (int i = 0; i < 4; ++i) {
+    deque.push_back(i);
+    deque.pop_front();
+  }
+  deque.push_front(1);
+  deque.push_back(2);
+  deque.push_front(3);
+  deque.insert(deque.cbegin() + 1, 10);
+  deque.insert(deque.cend() - 1, 20);
+  deque.erase(deque.cbegin());
+  int sum = 0;
+  for (int value : deque) {
+    sum = 10 * sum + value % 10;
+  }
+  return sum * 10 + static_cast<int>(deque.size());
+}
+
+static_assert(ConstantSum() == 1024);
+
+template <typename T, size_t N>
+void ExpectEqual(const StaticDeque<T, N> &deque,
+                 const std::deque<T> &expected) {
+  ASSERT_EQ(deque.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_EQ(deque[i], expected[i]) << "at " << i;
+  }
+  ASSERT_EQ(static_cast<size_t>(std::distance(deque.begin(), deque.end())),
+            expected.size());
+  auto it = expected.rbegin();
+  for (auto rit = deque.rbegin(); rit != deque.rend(); ++rit) {
+    ASSERT_EQ(*rit, *it++);
+  }
+}
+
+template <size_t N> void RunAgainstStdDeque() {
+  std::mt19937 random(N);
+  StaticDeque<std::string, N> deque;
+  std::deque<std::string> expected;
+  for (int i = 0; i < 20'000; ++i) {
+    std::string value = std::to_string(i);
+    size_t size = expected.size();
+    switch (random() % 6) {
+    case 0:
+      if (size == N) {
+        EXPECT_THROW(deque.push_back(value), std::length_error);
+      } else {
+        deque.push_back(value);
+        expected.push_back(value);
+      }
+      break;
+    case 1:
+      if (size == N) {
+        EXPECT_THROW(deque.push_front(value), std::length_error);
+      } else {
+        deque.push_front(value);
+        expected.push_front(value);
+      }
+      break;
+    case 2:
+      if (size != 0) {
+        deque.pop_back();
+        expected.pop_back();
+      }
+      break;
+    case 3:
+      if (size != 0) {
+        deque.pop_front();
+        expected.pop_front();
+      }
+      break;
+    case 4: {
+      size_t pos = random() % (size + 1);
+      if (size == N) {
+        EXPECT_THROW(deque.insert(deque.cbegin() + pos, value),
+                     std::length_error);
+        break;
+      }
+      // Inserting an element of the deque itself has to copy it first.
+      if (size != 0 && random() % 3 == 0) {
+        value = expected[pos % size];
+        ASSERT_EQ(*deque.insert(deque.cbegin() + pos, deque[pos % size]),
+                  value);
+      } else {
+        ASSERT_EQ(*deque.insert(deque.cbegin() + pos, value), value);
+      }
+      expected.insert(expected.begin() + pos, value);
+      break;
+    }
+    default:
+      if (size != 0) {
+        size_t pos = random() % size;
+        auto it = deque.erase(deque.cbegin() + pos);
+        auto expected_it = expected.erase(expected.begin() + pos);
+        ASSERT_EQ(it == deque.end(), expected_it == expected.end());
+        if (expected_it != expected.end()) {
+          ASSERT_EQ(*it, *expected_it);
+        }
+      }
+    }
+    ExpectEqual(deque, expected);
+  }
+}
+
+TEST(StaticDequeTest, MatchesStdDeque) {
+  RunAgainstStdDeque<1>();
+  RunAgainstStdDeque<7>();
+  RunAgainstStdDeque<8>();
+  RunAgainstStdDeque<100>();
+}
+
+// Counts its live instances, and throws from the copy which copies_left
+// runs out on.
+struct Counted {
+  static inline int live = 0;
+  static inline int copies_left = -1;
+
+  explicit Counted(int value) : value(value) { ++live; }
+  Counted(const Counted &other) : value(other.value) {
+    if (copies_left >= 0 && copies_left-- == 0) {
+      throw std::runtime_error("copy");
+    }
+    ++live;
+  }
+  Counted &operator=(const Counted &other) = default;
+  ~Counted() { --live; }
+
+  int value;
+};
+
+TEST(StaticDequeTest, DestroysEveryElementOnce) {
+  {
+    StaticDeque<Counted, 6> deque;
+    for (int i = 0; i < 100; ++i) {
+      deque.push_front(Counted(i));
+      if (deque.size() == 6) {
+        deque.pop_back();
+        deque.erase(deque.cbegin() + 2);
+      }
+    }
+    EXPECT_EQ(Counted::live, static_cast<int>(deque.size()));
+
+    StaticDeque<Counted, 6> copy = deque;
+    EXPECT_EQ(Counted::live, 2 * static_cast<int>(deque.size()));
+    copy = StaticDeque<Counted, 6>(6, Counted(-1));
+    EXPECT_EQ(copy.size(), 6u);
+    EXPECT_EQ(copy[5].value, -1);
+
+    // A throwing copy leaves the target of an assignment empty.
+    Counted::copies_left = 2;
+    EXPECT_THROW(copy = deque, std::runtime_error);
+    Counted::copies_left = -1;
+    EXPECT_EQ(copy.size(), 0u);
+    EXPECT_EQ(Counted::live, static_cast<int>(deque.size()));
+
+    Counted::copies_left = 1;
+    EXPECT_THROW((StaticDeque<Counted, 6>{deque}), std::runtime_error);
+    Counted::copies_left = -1;
+    EXPECT_EQ(Counted::live, static_cast<int>(deque.size()));
+  }
+  EXPECT_EQ(Counted::live, 0);
+}
+
+TEST(StaticDequeTest, ChecksBounds) {
+  StaticDeque<int, 3> deque(3, 7);
+  EXPECT_EQ(deque.capacity(), 3u);
+  EXPECT_THROW(deque.push_back(1), std::length_error);
+  EXPECT_THROW(deque.emplace_back(1), std::length_error);
+  EXPECT_THROW((StaticDeque<int, 3>(4)), std::length_error);
+  EXPECT_EQ(deque.at(2), 7);
+  EXPECT_THROW(deque.at(3), std::out_of_range);
+  const auto &const_deque = deque;
+  EXPECT_THROW(const_deque.at(3), std::out_of_range);
+  deque.pop_front();
+  deque.push_back(8);
+  EXPECT_EQ(deque.at(2), 8);
+  EXPECT_EQ(deque.end() - deque.begin(), 3);
+}
+
+} // namespace
@@ -0,0 +1,216 @@
+#ifndef DEQUE__WINDOW_AGGREGATOR_H_
+#define DEQUE__WINDOW_AGGREGATOR_H_
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <utility>
+
+#include "deque.h"
+
+// Combines two values into the smaller or the larger one. Windows over these
+// operations keep a monotonic deque instead of partial aggregates, which
+// needs no combining at all on pop_front.
+template <typename T> struct WindowMin {
+  const T &operator()(const T &lhs, const T &rhs) const {
+    return rhs < lhs ? rhs : lhs;
+  }
+};
+
+template <typename T> struct WindowMax {
+  const T &operator()(const T &lhs, const T &rhs) const {
+    return lhs < rhs ? rhs : lhs;
+  }
+};
+
+// FIFO window of values which keeps op folded over all of them, in order,
+// for any associative op. push_back, pop_front and query() take amortized
+// O(1) applications of op.
+//
+// The values live in one Deque split into two stacks. The back part holds
+// the values as pushed, along with their running aggregate. The front part
+// holds, in place of each value, the aggregate of it and all later values in
+// the front part. When pop_front finds the front part empty, the back part is
+// turned into the front part in one pass from back to front, so every value
+// is combined once there and once on the way in.
+//
+// The values themselves are not kept, only what query() needs. query() and
+// pop_front() must not be called on an empty window. If op throws, the
+// window is left valid but its aggregate is unspecified.
+template <typename T, typename Op = std::plus<T>> class WindowAggregator {
+public:
+  using size_type = size_t;
+  using value_type = T;
+
+  explicit WindowAggregator(Op op = Op());
+
+  [[nodiscard]] size_type size() const;
+  [[nodiscard]] bool empty() const;
+
+  void push_back(const value_type &value);
+  void pop_front();
+  void clear();
+
+  // The aggregate of all values in the window, oldest first.
+  [[nodiscard]] value_type query() const;
+
+private:
+  void Flip();
+
+  Op op_;
+  Deque<T> items_;
+  // Number of items in the front part, which comes first in items_.
+  size_t front_size_ = 0;
+  std::optional<T> back_aggregate_;
+};
+
+// Monotonic deque behind the min and max windows. It keeps only the values
+// which no later value beats, each with its position in the stream, so the
+// front is always the answer. Values equal to a later one are dropped as
+// well; the later one stays in the window at least as long. If better
+// throws, the window is left valid but its answer is unspecified.
+template <typename T, typename Better> class MonotonicWindow {
+public:
+  using size_type = size_t;
+  using value_type = T;
+
+  MonotonicWindow() = default;
+  explicit MonotonicWindow(const Better &better);
+
+  [[nodiscard]] size_type size() const;
+  [[nodiscard]] bool empty() const;
+
+  void push_back(const value_type &value);
+  void pop_front();
+  void clear();
+
+  [[nodiscard]] const value_type &query() const;
+
+private:
+  Better better_;
+  Deque<std::pair<T, size_t>> candidates_;
+  // Positions in the stream of the oldest value in the window and of the
+  // next value to come.
+  size_t first_ = 0;
+  size_t next_ = 0;
+};
+
+template <typename T>
+class WindowAggregator<T, WindowMin<T>>
+    : public MonotonicWindow<T, std::less<T>> {
+public:
+  explicit WindowAggregator(WindowMin<T> = WindowMin<T>()) {}
+};
+
+template <typename T>
+class WindowAggregator<T, WindowMax<T>>
+    : public MonotonicWindow<T, std::greater<T>> {
+public:
+  explicit WindowAggregator(WindowMax<T> = WindowMax<T>()) {}
+};
+
+template <typename T, typename Op>
+WindowAggregator<T, Op>::WindowAggregator(Op op) : op_(std::move(op)) {}
+
+template <typename T, typename Op>
+size_t WindowAggregator<T, Op>::size() const {
+  return items_.size();
+}
+
+template <typename T, typename Op>
+bool WindowAggregator<T, Op>::empty() const {
+  return items_.size() == 0;
+}
+
+template <typename T, typename Op>
+void WindowAggregator<T, Op>::push_back(const T &value) {
+  if (back_aggregate_) {
+    T aggregate = op_(*back_aggregate_, value);
+    items_.push_back(value);
+    *back_aggregate_ = std::move(aggregate);
+  } else {
+    items_.push_back(value);
+    back_aggregate_.emplace(value);
+  }
+}
+
+template <typename T, typename Op> void WindowAggregator<T, Op>::pop_front() {
+  if (front_size_ == 0) {
+    Flip();
+  }
+  items_.pop_front();
+  --front_size_;
+}
+
+template <typename T, typename Op> void WindowAggregator<T, Op>::clear() {
+  items_ = Deque<T>(items_.resource());
+  front_size_ = 0;
+  back_aggregate_.reset();
+}
+
+template <typename T, typename Op> T WindowAggregator<T, Op>::query() const {
+  if (front_size_ == 0) {
+    return *back_aggregate_;
+  }
+  if (!back_aggregate_) {
+    return items_[0];
+  }
+  return op_(items_[0], *back_aggregate_);
+}
+
+// Turns the back part into the front part.
+template <typename T, typename Op> void WindowAggregator<T, Op>::Flip() {
+  size_t size = items_.size();
+  // The whole window becomes the front part before combining, so that a
+  // throwing op leaves consistent, if wrong, parts behind.
+  front_size_ = size;
+  back_aggregate_.reset();
+  for (size_t i = size - 1; i-- > 0;) {
+    items_[i] = op_(items_[i], items_[i + 1]);
+  }
+}
+
+template <typename T, typename Better>
+MonotonicWindow<T, Better>::MonotonicWindow(const Better &better)
+    : better_(better) {}
+
+template <typename T, typename Better>
+size_t MonotonicWindow<T, Better>::size() const {
+  return next_ - first_;
+}
+
+template <typename T, typename Better>
+bool MonotonicWindow<T, Better>::empty() const {
+  return next_ == first_;
+}
+
+template <typename T, typename Better>
+void MonotonicWindow<T, Better>::push_back(const T &value) {
+  while (candidates_.size() != 0 &&
+         !better_(candidates_[candidates_.size() - 1].first, value)) {
+    candidates_.pop_back();
+  }
+  candidates_.emplace_back(value, next_);
+  ++next_;
+}
+
+template <typename T, typename Better>
+void MonotonicWindow<T, Better>::pop_front() {
+  if (candidates_[0].second == first_) {
+    candidates_.pop_front();
+  }
+  ++first_;
+}
+
+template <typename T, typename Better>
+void MonotonicWindow<T, Better>::clear() {
+  candidates_ = Deque<std::pair<T, size_t>>(candidates_.resource());
+  first_ = next_ = 0;
+}
+
+template <typename T, typename Better>
+const T &MonotonicWindow<T, Better>::query() const {
+  return candidates_[0].first;
+}
+
+#endif // DEQUE__WINDOW_AGGREGATOR_H_
@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <deque>
+#include <numeric>
+#include <random>
+
+#include "heap_counter_test_util.h"
+#include "window_aggregator.h"
+
+namespace {
+
+constexpr size_t kWindow = 64;
+
+// Slides a window of kWindow values over a long stream and returns the
+// bytes the heap grew by after the first 100000 of them. The map of the
+// deque may still settle a size up by then, but not keep growing.
+template <typename Window> size_t SteadyStateGrowth(Window &window) {
+  for (size_t i = 0; i < kWindow; ++i) {
+    window.push_back(static_cast<long>(i));
+  }
+  size_t settled = 0;
+  for (size_t i = kWindow; i < 2'000'000; ++i) {
+    window.push_back(static_cast<long>(i % 1000));
+    window.pop_front();
+    if (i == 100'000) {
+      settled = HeapInUse();
+    }
+  }
+  return HeapInUse() - std::min(settled, HeapInUse());
+}
+
+TEST(WindowAggregatorTest, SumMatchesRecomputation) {
+  std::mt19937 random(1);
+  WindowAggregator<long> window;
+  std::deque<long> values;
+  for (int i = 0; i < 100'000; ++i) {
+    if (values.empty() || random() % 3 != 0) {
+      long value = static_cast<long>(random() % 1000);
+      window.push_back(value);
+      values.push_back(value);
+    } else {
+      window.pop_front();
+      values.pop_front();
+    }
+    ASSERT_EQ(window.size(), values.size());
+    if (!values.empty()) {
+      ASSERT_EQ(window.query(),
+                std::accumulate(values.begin(), values.end(), 0l));
+    }
+  }
+}
+
+TEST(WindowAggregatorTest, MinAndMaxMatchRecomputation) {
+  std::mt19937 random(2);
+  WindowAggregator<int, WindowMin<int>> min;
+  WindowAggregator<int, WindowMax<int>> max;
+  std::deque<int> values;
+  for (int i = 0; i < 100'000; ++i) {
+    if (values.empty() || random() % 3 != 0) {
+      int value = static_cast<int>(random() % 100);
+      min.push_back(value);
+      max.push_back(value);
+      values.push_back(value);
+    } else {
+      min.pop_front();
+      max.pop_front();
+      values.pop_front();
+    }
+    if (!values.empty()) {
+      ASSERT_EQ(min.query(), *std::min_element(values.begin(), values.end()));
+      ASSERT_EQ(max.query(), *std::max_element(values.begin(), values.end()));
+    }
+  }
+}
+
+TEST(WindowAggregatorTest, SteadyStateSumKeepsMemoryBounded) {
+  WindowAggregator<long> window;
+  EXPECT_LT(SteadyStateGrowth(window), 4096u);
+  EXPECT_EQ(window.size(), kWindow);
+}
+
+TEST(WindowAggregatorTest, SteadyStateMaxKeepsMemoryBounded) {
+  WindowAggregator<long, WindowMax<long>> window;
+  EXPECT_LT(SteadyStateGrowth(window), 4096u);
+  EXPECT_EQ(window.size(), kWindow);
+}
+
+} // namespace
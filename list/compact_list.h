@@ -0,0 +1,499 @@
+#ifndef LIST__COMPACT_LIST_H_
+#define LIST__COMPACT_LIST_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <sys/types.h>
+
+// Doubly linked list whose nodes live in one growable array and refer to
+// each other by 32-bit index. Slot 0 is the sentinel, erased slots are
+// chained into a free list and reused by later inserts. Growing the array
+// keeps every slot at its index, so iterators (which hold the index)
+// survive reallocation; only the erased element's iterators are
+// invalidated. For List<int> a node takes 12 bytes instead of 32.
+template<typename T, typename Allocator = std::allocator<T>>
+class CompactList {
+ private:
+  template <bool is_const>
+  class CommonIterator;
+
+ public:
+  using iterator = CommonIterator<false>;
+  using const_iterator = CommonIterator<true>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  using allocator_type = Allocator;
+
+  CompactList();
+  CompactList(size_t n);
+  CompactList(size_t n, const T& value);
+  CompactList(Allocator allocator);
+  CompactList(size_t n, Allocator allocator);
+  CompactList(size_t n, const T& value, Allocator allocator);
+  CompactList(const CompactList& other);
+  ~CompactList();
+
+  CompactList& operator=(const CompactList& other);
+
+  void push_back(const T& value);
+  void push_front(const T& value);
+  void pop_back();
+  void pop_front();
+
+  iterator begin();
+  const_iterator begin() const;
+  const_iterator cbegin() const;
+  iterator end();
+  const_iterator end() const;
+  const_iterator cend() const;
+
+  reverse_iterator rbegin();
+  const_reverse_iterator rbegin() const;
+  const_reverse_iterator crbegin() const;
+  reverse_iterator rend();
+  const_reverse_iterator rend() const;
+  const_reverse_iterator crend() const;
+
+  iterator insert(const_iterator pos, const T& value);
+  iterator insert(const_iterator pos);
+  iterator erase(const_iterator pos);
+
+  void reserve(size_t n);
+  size_t capacity() const;
+  size_t size() const;
+  allocator_type get_allocator() const;
+
+ private:
+  using index_type = uint32_t;
+
+  static const index_type kSentinel = 0;
+  static const index_type kNil = std::numeric_limits<index_type>::max();
+
+  struct Slot {
+    index_type prev;
+    index_type next;
+    alignas(T) unsigned char storage[sizeof(T)];
+
+    T* value() {
+      return std::launder(reinterpret_cast<T*>(storage));
+    }
+  };
+
+  using slot_allocator_type = typename std::allocator_traits<Allocator>::template rebind_alloc<Slot>;
+
+  template<typename... Args>
+  iterator Emplace(const_iterator pos, Args&&... args);
+  void Grow(size_t capacity);
+  void Swap(CompactList& other);
+
+  Slot* slots_ = nullptr;
+  size_t capacity_ = 0;
+  // Slots below used_ have been handed out at least once; the ones erased
+  // since are chained through next starting at free_.
+  index_type used_ = 1;
+  index_type free_ = kNil;
+  size_t size_ = 0;
+  slot_allocator_type allocator_;
+};
+
+template<typename T, typename Allocator>
+template <bool is_const>
+class CompactList<T, Allocator>::CommonIterator {
+ public:
+  using iterator_category = std::bidirectional_iterator_tag;
+  using value_type = T;
+  using difference_type = ssize_t;
+  using pointer = typename std::conditional<is_const, const T*, T*>::type;
+  using reference = typename std::conditional<is_const, const T&, T&>::type;
+
+  CommonIterator() = default;
+  CommonIterator(Slot* const* slots, index_type idx);
+
+  CommonIterator<is_const>& operator++();
+  CommonIterator<is_const>& operator--();
+  CommonIterator<is_const> operator++(int);
+  CommonIterator<is_const> operator--(int);
+
+  bool operator==(const CommonIterator<true>& other) const;
+  bool operator!=(const CommonIterator<true>& other) const;
+
+  reference operator*() const;
+  pointer operator->() const;
+
+  index_type GetIdx() const {
+    return idx_;
+  }
+
+  operator CommonIterator<true>() const;
+
+  friend class CommonIterator<!is_const>;
+
+ private:
+  // Points at the owning list's slots_, so that the iterator follows the
+  // array when it is reallocated.
+  Slot* const* slots_ = nullptr;
+  index_type idx_ = kSentinel;
+};
+
+template<typename T, typename Allocator>
+template<bool is_const>
+CompactList<T, Allocator>::CommonIterator<is_const>::CommonIterator(Slot* const* slots, index_type idx)
+    : slots_(slots), idx_(idx) {
+}
+
+template<typename T, typename Allocator>
+template<bool is_const>
+typename CompactList<T, Allocator>::template CommonIterator<is_const>&
+CompactList<T, Allocator>::CommonIterator<is_const>::operator++() {
+  idx_ = (*slots_)[idx_].next;
+  return *this;
+}
+
+template<typename T, typename Allocator>
+template<bool is_const>
+typename CompactList<T, Allocator>::template CommonIterator<is_const>&
+CompactList<T, Allocator>::CommonIterator<is_const>::operator--() {
+  idx_ = (*slots_)[idx_].prev;
+  return *this;
+}
+
+template<typename T, typename Allocator>
+template<bool is_const>
+typename CompactList<T, Allocator>::template CommonIterator<is_const>
+CompactList<T, Allocator>::CommonIterator<is_const>::operator++(int) {
+  auto tmp = *this;
+  ++(*this);
+  return tmp;
+}
+
+template<typename T, typename Allocator>
+template<bool is_const>
+typename CompactList<T, Allocator>::template CommonIterator<is_const>
+CompactList<T, Allocator>::CommonIterator<is_const>::operator--(int) {
+  auto tmp = *this;
+  --(*this);
+  return tmp;
+}
+
+template<typename T, typename Allocator>
+template<bool is_const>
+bool CompactList<T, Allocator>::CommonIterator<is_const>::operator==(const CommonIterator<true>& other) const {
+  return idx_ == other.idx_ && slots_ == other.slots_;
+}
+
+template<typename T, typename Allocator>
+template<bool is_const>
+bool CompactList<T, Allocator>::CommonIterator<is_const>::operator!=(const CommonIterator<true>& other) const {
+  return !(*this == other);
+}
+
+template<typename T, typename Allocator>
+template<bool is_const>
+typename CompactList<T, Allocator>::template CommonIterator<is_const>::reference
+CompactList<T, Allocator>::CommonIterator<is_const>::operator*() const {
+  return *(*slots_)[idx_].value();
+}
+
+template<typename T, typename Allocator>
+template<bool is_const>
+typename CompactList<T, Allocator>::template CommonIterator<is_const>::pointer
+CompactList<T, Allocator>::CommonIterator<is_const>::operator->() const {
+  return (*slots_)[idx_].value();
+}
+
+template<typename T, typename Allocator>
+template<bool is_const>
+CompactList<T, Allocator>::CommonIterator<is_const>::operator CommonIterator<true>() const {
+  return const_iterator(slots_, idx_);
+}
+
+template<typename T, typename Allocator>
+CompactList<T, Allocator>::CompactList(Allocator allocator) : allocator_(allocator) {
+  Grow(1);
+  slots_[kSentinel].prev = slots_[kSentinel].next = kSentinel;
+}
+
+template<typename T, typename Allocator>
+CompactList<T, Allocator>::CompactList(size_t n, Allocator allocator) : CompactList(allocator) {
+  reserve(n);
+  while (n--) {
+    insert(end());
+  }
+}
+
+template<typename T, typename Allocator>
+CompactList<T, Allocator>::CompactList(size_t n, const T& value, Allocator allocator) : CompactList(allocator) {
+  reserve(n);
+  while (n--) {
+    push_back(value);
+  }
+}
+
+template<typename T, typename Allocator>
+CompactList<T, Allocator>::CompactList() : CompactList(Allocator()) {}
+
+template<typename T, typename Allocator>
+CompactList<T, Allocator>::CompactList(size_t n) : CompactList(n, Allocator()) {}
+
+template<typename T, typename Allocator>
+CompactList<T, Allocator>::CompactList(size_t n, const T& value) : CompactList(n, value, Allocator()) {}
+
+template<typename T, typename Allocator>
+CompactList<T, Allocator>::CompactList(const CompactList& other)
+    : CompactList(std::allocator_traits<slot_allocator_type>::select_on_container_copy_construction(other.allocator_)) {
+  reserve(other.size_);
+  for (const auto& elem : other) {
+    push_back(elem);
+  }
+}
+
+template<typename T, typename Allocator>
+CompactList<T, Allocator>::~CompactList() {
+  if constexpr (!std::is_trivially_destructible_v<T>) {
+    for (auto idx = slots_[kSentinel].next; idx != kSentinel; idx = slots_[idx].next) {
+      slots_[idx].value()->~T();
+    }
+  }
+  allocator_.deallocate(slots_, capacity_);
+}
+
+template<typename T, typename Allocator>
+CompactList<T, Allocator>& CompactList<T, Allocator>::operator=(const CompactList& other) {
+  if (this == &other) {
+    return *this;
+  }
+  Allocator allocator = allocator_;
+  if (std::allocator_traits<allocator_type>::propagate_on_container_copy_assignment::value) {
+    allocator = other.get_allocator();
+  }
+  CompactList tmp(allocator);
+  tmp.reserve(other.size_);
+  for (const auto& elem : other) {
+    tmp.push_back(elem);
+  }
+  Swap(tmp);
+  return *this;
+}
+
+template<typename T, typename Allocator>
+void CompactList<T, Allocator>::Swap(CompactList& other) {
+  std::swap(slots_, other.slots_);
+  std::swap(capacity_, other.capacity_);
+  std::swap(used_, other.used_);
+  std::swap(free_, other.free_);
+  std::swap(size_, other.size_);
+  std::swap(allocator_, other.allocator_);
+}
+
+template<typename T, typename Allocator>
+void CompactList<T, Allocator>::Grow(size_t capacity) {
+  if (capacity > kNil) {
+    throw std::length_error("CompactList is limited to 2^32 - 1 slots");
+  }
+  Slot* slots = allocator_.allocate(capacity);
+  if constexpr (std::is_trivially_copyable_v<T>) {
+    if (used_ != 0 && slots_ != nullptr) {
+      std::memcpy(static_cast<void*>(slots), slots_, sizeof(Slot) * used_);
+    }
+  } else if (slots_ != nullptr) {
+    for (index_type i = 0; i < used_; ++i) {
+      slots[i].prev = slots_[i].prev;
+      slots[i].next = slots_[i].next;
+    }
+    index_type moved = slots_[kSentinel].next;
+    try {
+      for (; moved != kSentinel; moved = slots_[moved].next) {
+        new (slots[moved].storage) T(std::move_if_noexcept(*slots_[moved].value()));
+      }
+    } catch (...) {
+      for (auto idx = slots_[kSentinel].next; idx != moved; idx = slots_[idx].next) {
+        slots[idx].value()->~T();
+      }
+      allocator_.deallocate(slots, capacity);
+      throw;
+    }
+    for (auto idx = slots_[kSentinel].next; idx != kSentinel; idx = slots_[idx].next) {
+      slots_[idx].value()->~T();
+    }
+  }
+  if (slots_ != nullptr) {
+    allocator_.deallocate(slots_, capacity_);
+  }
+  slots_ = slots;
+  capacity_ = capacity;
+}
+
+template<typename T, typename Allocator>
+void CompactList<T, Allocator>::reserve(size_t n) {
+  // One slot more for the sentinel.
+  if (n + 1 > capacity_) {
+    Grow(n + 1);
+  }
+}
+
+template<typename T, typename Allocator>
+void CompactList<T, Allocator>::push_back(const T& value) {
+  insert(end(), value);
+}
+
+template<typename T, typename Allocator>
+void CompactList<T, Allocator>::push_front(const T& value) {
+  insert(begin(), value);
+}
+
+template<typename T, typename Allocator>
+void CompactList<T, Allocator>::pop_back() {
+  erase(std::prev(end()));
+}
+
+template<typename T, typename Allocator>
+void CompactList<T, Allocator>::pop_front() {
+  erase(begin());
+}
+
+template<typename T, typename Allocator>
+typename CompactList<T, Allocator>::iterator CompactList<T, Allocator>::begin() {
+  return iterator(&slots_, slots_[kSentinel].next);
+}
+
+template<typename T, typename Allocator>
+typename CompactList<T, Allocator>::const_iterator CompactList<T, Allocator>::begin() const {
+  return const_iterator(&slots_, slots_[kSentinel].next);
+}
+
+template<typename T, typename Allocator>
+typename CompactList<T, Allocator>::const_iterator CompactList<T, Allocator>::cbegin() const {
+  return begin();
+}
+
+template<typename T, typename Allocator>
+typename CompactList<T, Allocator>::iterator CompactList<T, Allocator>::end() {
+  return iterator(&slots_, kSentinel);
+}
+
+template<typename T, typename Allocator>
+typename CompactList<T, Allocator>::const_iterator CompactList<T, Allocator>::end() const {
+  return const_iterator(&slots_, kSentinel);
+}
+
+template<typename T, typename Allocator>
+typename CompactList<T, Allocator>::const_iterator CompactList<T, Allocator>::cend() const {
+  return end();
+}
+
+template<typename T, typename Allocator>
+typename CompactList<T, Allocator>::reverse_iterator CompactList<T, Allocator>::rbegin() {
+  return reverse_iterator(end());
+}
+
+template<typename T, typename Allocator>
+typename CompactList<T, Allocator>::const_reverse_iterator CompactList<T, Allocator>::rbegin() const {
+  return const_reverse_iterator(end());
+}
+
+template<typename T, typename Allocator>
+typename CompactList<T, Allocator>::const_reverse_iterator CompactList<T, Allocator>::crbegin() const {
+  return const_reverse_iterator(end());
+}
+
+template<typename T, typename Allocator>
+typename CompactList<T, Allocator>::reverse_iterator CompactList<T, Allocator>::rend() {
+  return reverse_iterator(begin());
+}
+
+template<typename T, typename Allocator>
+typename CompactList<T, Allocator>::const_reverse_iterator CompactList<T, Allocator>::rend() const {
+  return const_reverse_iterator(begin());
+}
+
+template<typename T, typename Allocator>
+typename CompactList<T, Allocator>::const_reverse_iterator CompactList<T, Allocator>::crend() const {
+  return const_reverse_iterator(begin());
+}
+
+template<typename T, typename Allocator>
+template<typename... Args>
+typename CompactList<T, Allocator>::iterator CompactList<T, Allocator>::Emplace(const_iterator pos, Args&&... args) {
+  index_type idx = free_;
+  if (idx == kNil) {
+    idx = used_;
+  }
+  if (idx == capacity_) {
+    // args may refer to an element of this list, build the value before
+    // the array moves.
+    T value(std::forward<Args>(args)...);
+    // Doubling stops at kNil slots, the most 32-bit indices can tell apart
+    // from kNil.
+    if (capacity_ == kNil) {
+      throw std::length_error("CompactList is limited to 2^32 - 1 slots");
+    }
+    Grow(std::min<size_t>(2 * capacity_, kNil));
+    new (slots_[idx].storage) T(std::move(value));
+  } else {
+    new (slots_[idx].storage) T(std::forward<Args>(args)...);
+  }
+  if (idx == free_) {
+    free_ = slots_[idx].next;
+  } else {
+    ++used_;
+  }
+  index_type next = pos.GetIdx();
+  index_type prev = slots_[next].prev;
+  slots_[idx].prev = prev;
+  slots_[idx].next = next;
+  slots_[prev].next = idx;
+  slots_[next].prev = idx;
+  ++size_;
+  return iterator(&slots_, idx);
+}
+
+template<typename T, typename Allocator>
+typename CompactList<T, Allocator>::iterator CompactList<T, Allocator>::insert(const_iterator pos, const T& value) {
+  return Emplace(pos, value);
+}
+
+template<typename T, typename Allocator>
+typename CompactList<T, Allocator>::iterator CompactList<T, Allocator>::insert(const_iterator pos) {
+  return Emplace(pos);
+}
+
+template<typename T, typename Allocator>
+typename CompactList<T, Allocator>::iterator CompactList<T, Allocator>::erase(const_iterator pos) {
+  index_type idx = pos.GetIdx();
+  index_type next = slots_[idx].next;
+  index_type prev = slots_[idx].prev;
+  slots_[prev].next = next;
+  slots_[next].prev = prev;
+  slots_[idx].value()->~T();
+  slots_[idx].next = free_;
+  free_ = idx;
+  --size_;
+  return iterator(&slots_, next);
+}
+
+template<typename T, typename Allocator>
+size_t CompactList<T, Allocator>::capacity() const {
+  return capacity_ - 1;
+}
+
+template<typename T, typename Allocator>
+size_t CompactList<T, Allocator>::size() const {
+  return size_;
+}
+
+template<typename T, typename Allocator>
+typename CompactList<T, Allocator>::allocator_type CompactList<T, Allocator>::get_allocator() const {
+  return allocator_;
+}
+
+#endif//LIST__COMPACT_LIST_H_
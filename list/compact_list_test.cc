@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <list>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "compact_list.h"
+
+namespace {
+
+template<typename T>
+void ExpectEqual(const CompactList<T>& list, const std::list<T>& expected) {
+  ASSERT_EQ(list.size(), expected.size());
+  auto it = expected.begin();
+  for (const auto& value : list) {
+    ASSERT_EQ(value, *it++);
+  }
+}
+
+TEST(CompactListTest, MatchesStdList) {
+  std::mt19937 random(1);
+  CompactList<std::string> list;
+  std::list<std::string> expected;
+  auto it = list.begin();
+  auto expected_it = expected.begin();
+  for (int i = 0; i < 50'000; ++i) {
+    size_t choice = random() % 8;
+    if (choice < 3 || expected.empty()) {
+      it = list.insert(it, std::to_string(i));
+      expected_it = expected.insert(expected_it, std::to_string(i));
+    } else if (choice < 5 && expected_it != expected.end()) {
+      it = list.erase(it);
+      expected_it = expected.erase(expected_it);
+    } else if (choice == 5) {
+      it = list.begin();
+      expected_it = expected.begin();
+    } else if (choice == 6 && expected_it != expected.end()) {
+      ++it;
+      ++expected_it;
+    } else if (expected_it != expected.begin()) {
+      --it;
+      --expected_it;
+    }
+  }
+  ExpectEqual(list, expected);
+
+  CompactList<std::string> copy = list;
+  ExpectEqual(copy, expected);
+  copy.pop_front();
+  list = copy;
+  expected.pop_front();
+  ExpectEqual(list, expected);
+}
+
+TEST(CompactListTest, IteratorsSurviveGrowth) {
+  CompactList<std::string> list;
+  std::vector<CompactList<std::string>::iterator> iterators;
+  for (int i = 0; i < 10'000; ++i) {
+    list.push_back(std::to_string(i));
+    iterators.push_back(std::prev(list.end()));
+  }
+  for (int i = 0; i < 10'000; ++i) {
+    ASSERT_EQ(*iterators[i], std::to_string(i));
+  }
+  // An element of the list itself, inserted as the array grows.
+  CompactList<std::string> self;
+  self.push_back("first");
+  for (int i = 0; i < 1000; ++i) {
+    self.push_back(*self.begin());
+  }
+  for (const auto& value : self) {
+    ASSERT_EQ(value, "first");
+  }
+}
+
+TEST(CompactListTest, ErasedSlotsAreReused) {
+  CompactList<int> list;
+  for (int i = 0; i < 1000; ++i) {
+    list.push_back(i);
+  }
+  size_t capacity = list.capacity();
+  for (int i = 1000; i < 100'000; ++i) {
+    list.pop_front();
+    list.push_back(i);
+  }
+  EXPECT_EQ(list.capacity(), capacity);
+  EXPECT_EQ(*list.begin(), 99'000);
+}
+
+TEST(CompactListTest, GrowsByDoubling) {
+  CompactList<int> list;
+  size_t grown = 0;
+  size_t capacity = list.capacity();
+  for (int i = 0; i < 1'000'000; ++i) {
+    list.push_back(i);
+    if (list.capacity() != capacity) {
+      // The sentinel takes a slot besides the elements.
+      EXPECT_EQ(list.capacity() + 1, 2 * (capacity + 1));
+      capacity = list.capacity();
+      ++grown;
+    }
+  }
+  EXPECT_EQ(grown, 20u);
+}
+
+}  // namespace
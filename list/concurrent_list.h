@@ -0,0 +1,325 @@
+#ifndef LIST__CONCURRENT_LIST_H_
+#define LIST__CONCURRENT_LIST_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// Doubly linked list for concurrent use. Writers lock only the nodes around
+// the link they change (and retry if a neighbour moved meanwhile), so
+// inserts and erases in different places do not wait for each other.
+// Readers take no locks at all: for_each walks the next pointers and skips
+// nodes already marked as erased. Erased nodes are freed only after every
+// operation that could still see them has finished, tracked with two
+// epochs of reader counters.
+//
+// The node locks, the reader counters and the retire lists make every
+// operation cost about twice what a std::list behind one mutex does, and
+// pushes still meet at the sentinels. What this buys is scans which never
+// hold writers up; concurrent_list_benchmark.cc compares the two.
+//
+// push_back and push_front return a handle which erase takes. Every
+// element has to be erased at most once, through its handle. The allocator
+// is called from many threads and has to be thread-safe.
+template<typename T, typename Allocator = std::allocator<T>>
+class ConcurrentList {
+ private:
+  struct BaseNode;
+  struct Node;
+
+ public:
+  using allocator_type = Allocator;
+
+  class handle {
+   public:
+    handle() = default;
+
+   private:
+    friend class ConcurrentList;
+    explicit handle(Node* node) : node_(node) {}
+    Node* node_ = nullptr;
+  };
+
+  ConcurrentList();
+  explicit ConcurrentList(Allocator allocator);
+  ConcurrentList(const ConcurrentList& other) = delete;
+  ~ConcurrentList();
+
+  ConcurrentList& operator=(const ConcurrentList& other) = delete;
+
+  handle push_back(const T& value);
+  handle push_front(const T& value);
+  void erase(handle pos);
+
+  template<typename F>
+  void for_each(F f) const;
+
+  size_t size() const;
+  allocator_type get_allocator() const;
+
+ private:
+  static const size_t kReaderShards = 16;
+  static const size_t kReclaimBatch = 64;
+
+  // Per node lock, held only for a handful of pointer stores.
+  class SpinLock {
+   public:
+    void lock() {
+      while (flag_.test_and_set(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+    }
+    bool try_lock() {
+      return !flag_.test_and_set(std::memory_order_acquire);
+    }
+    void unlock() {
+      flag_.clear(std::memory_order_release);
+    }
+
+   private:
+    std::atomic_flag flag_ = ATOMIC_FLAG_INIT;
+  };
+
+  struct alignas(64) ReaderCounter {
+    std::atomic<size_t> count{0};
+  };
+
+  class ReadGuard {
+   public:
+    explicit ReadGuard(const ConcurrentList& list);
+    ReadGuard(const ReadGuard& other) = delete;
+    ~ReadGuard();
+
+   private:
+    std::atomic<size_t>* counter_;
+  };
+
+  using inner_allocator_type = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+
+  static size_t ReaderShard();
+
+  handle Insert(BaseNode* pred, BaseNode* succ, Node* node);
+  Node* CreateNode(const T& value);
+  void DestroyNode(BaseNode* node);
+  void Retire(BaseNode* node);
+
+  BaseNode head_;
+  BaseNode tail_;
+  std::atomic<size_t> size_{0};
+
+  mutable ReaderCounter readers_[2][kReaderShards];
+  std::atomic<uint64_t> epoch_{0};
+  // Nodes erased during an even and an odd epoch. retire_mutex_ guards both
+  // lists and the epoch switch.
+  BaseNode* retired_[2] = {nullptr, nullptr};
+  size_t retired_count_ = 0;
+  std::mutex retire_mutex_;
+
+  inner_allocator_type allocator_;
+};
+
+template<typename T, typename Allocator>
+struct ConcurrentList<T, Allocator>::BaseNode {
+  std::atomic<BaseNode*> prev{nullptr};
+  std::atomic<BaseNode*> next{nullptr};
+  std::atomic<bool> marked{false};
+  SpinLock mutex;
+  BaseNode* retired_next = nullptr;
+};
+
+template<typename T, typename Allocator>
+struct ConcurrentList<T, Allocator>::Node : BaseNode {
+  Node(const T& value) : value(value) {}
+  T value;
+};
+
+template<typename T, typename Allocator>
+ConcurrentList<T, Allocator>::ReadGuard::ReadGuard(const ConcurrentList& list) {
+  size_t shard = ReaderShard();
+  while (true) {
+    uint64_t epoch = list.epoch_.load();
+    counter_ = &list.readers_[epoch & 1][shard].count;
+    counter_->fetch_add(1);
+    if (list.epoch_.load() == epoch) {
+      break;
+    }
+    counter_->fetch_sub(1);
+  }
+}
+
+template<typename T, typename Allocator>
+ConcurrentList<T, Allocator>::ReadGuard::~ReadGuard() {
+  counter_->fetch_sub(1);
+}
+
+template<typename T, typename Allocator>
+size_t ConcurrentList<T, Allocator>::ReaderShard() {
+  static std::atomic<size_t> next_shard{0};
+  thread_local size_t shard = next_shard.fetch_add(1) % kReaderShards;
+  return shard;
+}
+
+template<typename T, typename Allocator>
+ConcurrentList<T, Allocator>::ConcurrentList(Allocator allocator) : allocator_(allocator) {
+  head_.next.store(&tail_, std::memory_order_release);
+  tail_.prev.store(&head_, std::memory_order_release);
+}
+
+template<typename T, typename Allocator>
+ConcurrentList<T, Allocator>::ConcurrentList() : ConcurrentList(Allocator()) {}
+
+template<typename T, typename Allocator>
+ConcurrentList<T, Allocator>::~ConcurrentList() {
+  for (auto node = head_.next.load(std::memory_order_acquire); node != &tail_;) {
+    auto next = node->next.load(std::memory_order_acquire);
+    DestroyNode(node);
+    node = next;
+  }
+  for (auto& retired : retired_) {
+    while (retired != nullptr) {
+      auto next = retired->retired_next;
+      DestroyNode(retired);
+      retired = next;
+    }
+  }
+}
+
+template<typename T, typename Allocator>
+typename ConcurrentList<T, Allocator>::Node* ConcurrentList<T, Allocator>::CreateNode(const T& value) {
+  auto ptr = allocator_.allocate(1);
+  try {
+    std::allocator_traits<inner_allocator_type>::construct(allocator_, ptr, value);
+  } catch (...) {
+    allocator_.deallocate(ptr, 1);
+    throw;
+  }
+  return ptr;
+}
+
+template<typename T, typename Allocator>
+void ConcurrentList<T, Allocator>::DestroyNode(BaseNode* node) {
+  auto ptr = static_cast<Node*>(node);
+  std::allocator_traits<inner_allocator_type>::destroy(allocator_, ptr);
+  allocator_.deallocate(ptr, 1);
+}
+
+template<typename T, typename Allocator>
+typename ConcurrentList<T, Allocator>::handle ConcurrentList<T, Allocator>::push_back(const T& value) {
+  return Insert(nullptr, &tail_, CreateNode(value));
+}
+
+template<typename T, typename Allocator>
+typename ConcurrentList<T, Allocator>::handle ConcurrentList<T, Allocator>::push_front(const T& value) {
+  return Insert(&head_, nullptr, CreateNode(value));
+}
+
+template<typename T, typename Allocator>
+typename ConcurrentList<T, Allocator>::handle ConcurrentList<T, Allocator>::Insert(BaseNode* pred, BaseNode* succ,
+                                                                                  Node* node) {
+  ReadGuard guard(*this);
+  // One of pred and succ is a sentinel, the other one is read again on
+  // every attempt.
+  bool at_back = pred == nullptr;
+  while (true) {
+    if (at_back) {
+      pred = succ->prev.load(std::memory_order_acquire);
+    } else {
+      succ = pred->next.load(std::memory_order_acquire);
+    }
+    std::scoped_lock lock(pred->mutex, succ->mutex);
+    if (pred->marked.load(std::memory_order_acquire) || succ->marked.load(std::memory_order_acquire) ||
+        pred->next.load(std::memory_order_acquire) != succ || succ->prev.load(std::memory_order_acquire) != pred) {
+      continue;
+    }
+    node->prev.store(pred, std::memory_order_release);
+    node->next.store(succ, std::memory_order_release);
+    pred->next.store(node, std::memory_order_release);
+    succ->prev.store(node, std::memory_order_release);
+    break;
+  }
+  size_.fetch_add(1);
+  return handle(node);
+}
+
+template<typename T, typename Allocator>
+void ConcurrentList<T, Allocator>::erase(handle pos) {
+  BaseNode* node = pos.node_;
+  {
+    ReadGuard guard(*this);
+    while (true) {
+      auto pred = node->prev.load(std::memory_order_acquire);
+      auto succ = node->next.load(std::memory_order_acquire);
+      std::scoped_lock lock(pred->mutex, node->mutex, succ->mutex);
+      if (pred->marked.load(std::memory_order_acquire) || succ->marked.load(std::memory_order_acquire) ||
+          pred->next.load(std::memory_order_acquire) != node || node->next.load(std::memory_order_acquire) != succ) {
+        continue;
+      }
+      node->marked.store(true, std::memory_order_release);
+      pred->next.store(succ, std::memory_order_release);
+      succ->prev.store(pred, std::memory_order_release);
+      break;
+    }
+  }
+  size_.fetch_sub(1);
+  Retire(node);
+}
+
+template<typename T, typename Allocator>
+void ConcurrentList<T, Allocator>::Retire(BaseNode* node) {
+  BaseNode* reclaimed = nullptr;
+  {
+    std::lock_guard lock(retire_mutex_);
+    uint64_t epoch = epoch_.load();
+    node->retired_next = retired_[epoch & 1];
+    retired_[epoch & 1] = node;
+    if (++retired_count_ % kReclaimBatch != 0) {
+      return;
+    }
+
+    // Nodes retired in the previous epoch can only be seen by operations
+    // which entered that epoch. Once none of them is left the nodes are
+    // unreachable and the epoch slot can be reused.
+    auto& previous = readers_[(epoch + 1) & 1];
+    for (auto& counter : previous) {
+      if (counter.count.load() != 0) {
+        return;
+      }
+    }
+    reclaimed = retired_[(epoch + 1) & 1];
+    retired_[(epoch + 1) & 1] = nullptr;
+    epoch_.store(epoch + 1);
+  }
+  while (reclaimed != nullptr) {
+    auto next = reclaimed->retired_next;
+    DestroyNode(reclaimed);
+    reclaimed = next;
+  }
+}
+
+template<typename T, typename Allocator>
+template<typename F>
+void ConcurrentList<T, Allocator>::for_each(F f) const {
+  ReadGuard guard(*this);
+  for (auto node = head_.next.load(std::memory_order_acquire); node != &tail_;
+       node = node->next.load(std::memory_order_acquire)) {
+    if (!node->marked.load(std::memory_order_acquire)) {
+      f(static_cast<const Node*>(node)->value);
+    }
+  }
+}
+
+template<typename T, typename Allocator>
+size_t ConcurrentList<T, Allocator>::size() const {
+  return size_.load();
+}
+
+template<typename T, typename Allocator>
+typename ConcurrentList<T, Allocator>::allocator_type ConcurrentList<T, Allocator>::get_allocator() const {
+  return allocator_;
+}
+
+#endif//LIST__CONCURRENT_LIST_H_
@@ -0,0 +1,120 @@
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <vector>
+
+#include "concurrent_list.h"
+
+namespace {
+
+// std::list behind a single mutex, with the interface of ConcurrentList.
+// The baseline ConcurrentList has to beat once writers contend.
+template<typename T>
+class LockedList {
+ public:
+  using handle = typename std::list<T>::iterator;
+
+  handle push_back(const T& value) {
+    std::lock_guard lock(mutex_);
+    list_.push_back(value);
+    return std::prev(list_.end());
+  }
+
+  void erase(handle pos) {
+    std::lock_guard lock(mutex_);
+    list_.erase(pos);
+  }
+
+  template<typename F>
+  void for_each(F f) const {
+    std::lock_guard lock(mutex_);
+    for (const auto& value : list_) {
+      f(value);
+    }
+  }
+
+ private:
+  std::list<T> list_;
+  mutable std::mutex mutex_;
+};
+
+// Elements every thread keeps in the list, erasing the oldest of them for
+// every push.
+constexpr size_t kWindow = 64;
+
+template<typename List>
+List* shared_list = nullptr;
+
+template<typename List>
+void SetUpList(const benchmark::State& state) {
+  shared_list<List> = new List;
+  for (long i = 0; i < state.range(0); ++i) {
+    shared_list<List>->push_back(i);
+  }
+}
+
+template<typename List>
+void TearDownList(const benchmark::State&) {
+  delete shared_list<List>;
+  shared_list<List> = nullptr;
+}
+
+// Every thread pushes to the back and erases its own oldest element, and
+// scans the whole list, of about state.range(0) elements, once every
+// scan_every writes if that is not zero.
+template<typename List>
+void Churn(benchmark::State& state, size_t scan_every) {
+  List& list = *shared_list<List>;
+  std::vector<typename List::handle> window;
+  window.reserve(kWindow);
+  size_t next = 0;
+  long sum = 0;
+  for (auto _ : state) {
+    if (window.size() < kWindow) {
+      window.push_back(list.push_back(static_cast<long>(next)));
+    } else {
+      list.erase(window[next % kWindow]);
+      window[next % kWindow] = list.push_back(static_cast<long>(next));
+    }
+    if (scan_every != 0 && next % scan_every == 0) {
+      list.for_each([&sum](long value) { sum += value; });
+    }
+    ++next;
+  }
+  for (auto& pos : window) {
+    list.erase(pos);
+  }
+  benchmark::DoNotOptimize(sum);
+  state.SetItemsProcessed(state.iterations());
+}
+
+template<typename List>
+void BM_PushErase(benchmark::State& state) {
+  Churn<List>(state, 0);
+}
+
+template<typename List>
+void BM_PushEraseWithScans(benchmark::State& state) {
+  Churn<List>(state, 1024);
+}
+
+#define CONCURRENT_LIST_BENCHMARK(bm, list)                                       \
+  BENCHMARK_TEMPLATE(bm, list)                                                    \
+      ->Setup(SetUpList<list>)                                                    \
+      ->Teardown(TearDownList<list>)                                              \
+      ->ThreadRange(1, 8)                                                         \
+      ->Arg(1000)                                                                 \
+      ->Arg(100'000)                                                              \
+      ->UseRealTime()
+
+CONCURRENT_LIST_BENCHMARK(BM_PushErase, ConcurrentList<long>);
+CONCURRENT_LIST_BENCHMARK(BM_PushErase, LockedList<long>);
+CONCURRENT_LIST_BENCHMARK(BM_PushEraseWithScans, ConcurrentList<long>);
+CONCURRENT_LIST_BENCHMARK(BM_PushEraseWithScans, LockedList<long>);
+
+}  // namespace
+
+BENCHMARK_MAIN();
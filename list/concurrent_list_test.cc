@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "concurrent_list.h"
+
+namespace {
+
+std::atomic<long> live_nodes{0};
+
+// Counts the nodes allocated and not freed yet, from any thread.
+template<typename T>
+struct CountingAllocator : std::allocator<T> {
+  template<typename U>
+  struct rebind {
+    using other = CountingAllocator<U>;
+  };
+
+  CountingAllocator() = default;
+  template<typename U>
+  CountingAllocator(const CountingAllocator<U>&) {}
+
+  T* allocate(size_t n) {
+    live_nodes += static_cast<long>(n);
+    return std::allocator<T>::allocate(n);
+  }
+  void deallocate(T* ptr, size_t n) {
+    live_nodes -= static_cast<long>(n);
+    std::allocator<T>::deallocate(ptr, n);
+  }
+};
+
+using CountedList = ConcurrentList<long, CountingAllocator<long>>;
+
+// Batches of nodes retired in the current and the previous epoch.
+constexpr long kRetiredAtMost = 2 * 64;
+
+std::vector<long> Contents(const CountedList& list) {
+  std::vector<long> values;
+  list.for_each([&values](long value) { values.push_back(value); });
+  return values;
+}
+
+class ConcurrentListTest : public ::testing::Test {
+ protected:
+  void TearDown() override {
+    EXPECT_EQ(live_nodes, 0);
+  }
+};
+
+TEST_F(ConcurrentListTest, KeepsOrderOfPushes) {
+  CountedList list;
+  auto one = list.push_back(1);
+  list.push_back(2);
+  list.push_front(0);
+  auto three = list.push_back(3);
+  EXPECT_EQ(Contents(list), (std::vector<long>{0, 1, 2, 3}));
+  list.erase(one);
+  list.erase(three);
+  EXPECT_EQ(Contents(list), (std::vector<long>{0, 2}));
+  EXPECT_EQ(list.size(), 2u);
+}
+
+TEST_F(ConcurrentListTest, ErasedNodesAreReclaimed) {
+  CountedList list;
+  std::vector<CountedList::handle> window;
+  for (long i = 0; i < 10; ++i) {
+    window.push_back(list.push_back(i));
+  }
+  for (long i = 10; i < 100'000; ++i) {
+    list.erase(window[i % 10]);
+    window[i % 10] = list.push_back(i);
+    ASSERT_LE(live_nodes, 10 + kRetiredAtMost);
+  }
+  EXPECT_EQ(list.size(), 10u);
+}
+
+// Writers erase nothing but their own elements, all of which are even, so
+// a reader seeing an odd value read a node after it was freed and reused.
+TEST_F(ConcurrentListTest, ReadersRaceWriters) {
+  const int kWriters = 4;
+  const long kRounds = 20'000;
+  CountedList list;
+  std::atomic<bool> done{false};
+  std::atomic<long> odd_values{0};
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 2; ++r) {
+    readers.emplace_back([&] {
+      while (!done) {
+        list.for_each([&](long value) {
+          if (value % 2 != 0) {
+            ++odd_values;
+          }
+        });
+      }
+    });
+  }
+  std::vector<std::thread> writers;
+  for (int w = 0; w < kWriters; ++w) {
+    writers.emplace_back([&list, w] {
+      std::vector<CountedList::handle> window;
+      for (long i = 0; i < kRounds; ++i) {
+        long value = 2 * (i * kWriters + w);
+        if (window.size() < 16) {
+          window.push_back(i % 2 == 0 ? list.push_back(value) : list.push_front(value));
+        } else {
+          list.erase(window[i % 16]);
+          window[i % 16] = i % 2 == 0 ? list.push_back(value) : list.push_front(value);
+        }
+      }
+      for (size_t i = 0; i < window.size(); i += 2) {
+        list.erase(window[i]);
+      }
+    });
+  }
+  for (auto& writer : writers) {
+    writer.join();
+  }
+  done = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(odd_values, 0);
+  EXPECT_EQ(list.size(), kWriters * 8u);
+  EXPECT_EQ(Contents(list).size(), kWriters * 8u);
+
+  // With the readers gone, the next batches free whatever they held up.
+  std::vector<CountedList::handle> window;
+  for (long i = 0; i < 4 * 64; ++i) {
+    window.push_back(list.push_back(0));
+  }
+  for (auto& pos : window) {
+    list.erase(pos);
+  }
+  EXPECT_LE(live_nodes, kWriters * 8 + kRetiredAtMost);
+}
+
+}  // namespace
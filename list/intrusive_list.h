@@ -0,0 +1,422 @@
+#ifndef LIST__INTRUSIVE_LIST_H_
+#define LIST__INTRUSIVE_LIST_H_
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <sys/types.h>
+
+// prev/next pair embedded into objects threaded onto an IntrusiveList. A
+// hook unlinks itself when its owner is destroyed, copies of a hook start
+// out unlinked.
+class IntrusiveListHook {
+ public:
+  IntrusiveListHook() = default;
+  IntrusiveListHook(const IntrusiveListHook& other);
+  IntrusiveListHook& operator=(const IntrusiveListHook& other);
+  ~IntrusiveListHook();
+
+  bool is_linked() const;
+  void unlink();
+
+ private:
+  template<typename T, IntrusiveListHook T::*Hook>
+  friend class IntrusiveList;
+
+  IntrusiveListHook* prev = nullptr;
+  IntrusiveListHook* next = nullptr;
+};
+
+inline IntrusiveListHook::IntrusiveListHook([[maybe_unused]]const IntrusiveListHook& other) {}
+
+inline IntrusiveListHook& IntrusiveListHook::operator=([[maybe_unused]]const IntrusiveListHook& other) {
+  return *this;
+}
+
+inline IntrusiveListHook::~IntrusiveListHook() {
+  unlink();
+}
+
+inline bool IntrusiveListHook::is_linked() const {
+  return next != nullptr;
+}
+
+inline void IntrusiveListHook::unlink() {
+  if (next == nullptr) {
+    return;
+  }
+  prev->next = next;
+  next->prev = prev;
+  prev = next = nullptr;
+}
+
+// List of objects which carry their own IntrusiveListHook member. The list
+// never allocates and never copies elements: it links the objects it is
+// given, so they must stay alive (or unlink themselves) while linked. An
+// object may be on one list per hook member, and inserting it while its
+// hook is linked is an error. Elements can leave the list
+// behind its back, so size() walks the list.
+template<typename T, IntrusiveListHook T::*Hook>
+class IntrusiveList {
+ private:
+  template <bool is_const>
+  class CommonIterator;
+
+ public:
+  using iterator = CommonIterator<false>;
+  using const_iterator = CommonIterator<true>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  IntrusiveList();
+  IntrusiveList(const IntrusiveList& other) = delete;
+  IntrusiveList(IntrusiveList&& other);
+  ~IntrusiveList();
+
+  IntrusiveList& operator=(const IntrusiveList& other) = delete;
+
+  void push_back(T& value);
+  void push_front(T& value);
+  void pop_back();
+  void pop_front();
+
+  T& front();
+  const T& front() const;
+  T& back();
+  const T& back() const;
+
+  iterator begin();
+  const_iterator begin() const;
+  const_iterator cbegin() const;
+  iterator end();
+  const_iterator end() const;
+  const_iterator cend() const;
+
+  reverse_iterator rbegin();
+  const_reverse_iterator rbegin() const;
+  const_reverse_iterator crbegin() const;
+  reverse_iterator rend();
+  const_reverse_iterator rend() const;
+  const_reverse_iterator crend() const;
+
+  iterator insert(const_iterator pos, T& value);
+  iterator erase(const_iterator pos);
+  void clear();
+
+  static iterator iterator_to(T& value);
+  static const_iterator iterator_to(const T& value);
+
+  bool empty() const;
+  size_t size() const;
+
+ private:
+  static T* FromHook(IntrusiveListHook* hook);
+  static IntrusiveListHook* ToHook(const T& value);
+
+  // Offset of the hook inside T, recorded from the objects insert links:
+  // T need not be standard layout, so offsetof cannot give it, and every
+  // hook FromHook sees was linked by insert. Stored only while it still
+  // differs, so that inserts on several threads just read it.
+  static inline std::atomic<ptrdiff_t> hook_offset_{0};
+
+  IntrusiveListHook sentinel_;
+};
+
+template<typename T, IntrusiveListHook T::*Hook>
+template <bool is_const>
+class IntrusiveList<T, Hook>::CommonIterator {
+ public:
+  using iterator_category = std::bidirectional_iterator_tag;
+  using value_type = T;
+  using difference_type = ssize_t;
+  using pointer = typename std::conditional<is_const, const T*, T*>::type;
+  using reference = typename std::conditional<is_const, const T&, T&>::type;
+
+  CommonIterator() = default;
+  explicit CommonIterator(IntrusiveListHook* node);
+
+  CommonIterator<is_const>& operator++();
+  CommonIterator<is_const>& operator--();
+  CommonIterator<is_const> operator++(int);
+  CommonIterator<is_const> operator--(int);
+
+  bool operator==(const CommonIterator<true>& other) const;
+  bool operator!=(const CommonIterator<true>& other) const;
+
+  reference operator*() const;
+  pointer operator->() const;
+
+  IntrusiveListHook* GetNode() const {
+    return node_;
+  }
+
+  operator CommonIterator<true>() const;
+
+  friend class CommonIterator<!is_const>;
+
+ private:
+  IntrusiveListHook* node_ = nullptr;
+};
+
+template<typename T, IntrusiveListHook T::*Hook>
+template<bool is_const>
+IntrusiveList<T, Hook>::CommonIterator<is_const>::CommonIterator(IntrusiveListHook* node) : node_(node) {
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+template<bool is_const>
+typename IntrusiveList<T, Hook>::template CommonIterator<is_const>&
+IntrusiveList<T, Hook>::CommonIterator<is_const>::operator++() {
+  node_ = node_->next;
+  return *this;
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+template<bool is_const>
+typename IntrusiveList<T, Hook>::template CommonIterator<is_const>&
+IntrusiveList<T, Hook>::CommonIterator<is_const>::operator--() {
+  node_ = node_->prev;
+  return *this;
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+template<bool is_const>
+typename IntrusiveList<T, Hook>::template CommonIterator<is_const>
+IntrusiveList<T, Hook>::CommonIterator<is_const>::operator++(int) {
+  auto tmp = *this;
+  ++(*this);
+  return tmp;
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+template<bool is_const>
+typename IntrusiveList<T, Hook>::template CommonIterator<is_const>
+IntrusiveList<T, Hook>::CommonIterator<is_const>::operator--(int) {
+  auto tmp = *this;
+  --(*this);
+  return tmp;
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+template<bool is_const>
+bool IntrusiveList<T, Hook>::CommonIterator<is_const>::operator==(const CommonIterator<true>& other) const {
+  return node_ == other.node_;
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+template<bool is_const>
+bool IntrusiveList<T, Hook>::CommonIterator<is_const>::operator!=(const CommonIterator<true>& other) const {
+  return node_ != other.node_;
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+template<bool is_const>
+typename IntrusiveList<T, Hook>::template CommonIterator<is_const>::reference
+IntrusiveList<T, Hook>::CommonIterator<is_const>::operator*() const {
+  return *FromHook(node_);
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+template<bool is_const>
+typename IntrusiveList<T, Hook>::template CommonIterator<is_const>::pointer
+IntrusiveList<T, Hook>::CommonIterator<is_const>::operator->() const {
+  return FromHook(node_);
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+template<bool is_const>
+IntrusiveList<T, Hook>::CommonIterator<is_const>::operator CommonIterator<true>() const {
+  return const_iterator(node_);
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+T* IntrusiveList<T, Hook>::FromHook(IntrusiveListHook* hook) {
+  return reinterpret_cast<T*>(reinterpret_cast<char*>(hook) - hook_offset_.load(std::memory_order_relaxed));
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+IntrusiveListHook* IntrusiveList<T, Hook>::ToHook(const T& value) {
+  return const_cast<IntrusiveListHook*>(&(value.*Hook));
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+IntrusiveList<T, Hook>::IntrusiveList() {
+  sentinel_.prev = sentinel_.next = &sentinel_;
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+IntrusiveList<T, Hook>::IntrusiveList(IntrusiveList&& other) : IntrusiveList() {
+  if (other.empty()) {
+    return;
+  }
+  sentinel_.next = other.sentinel_.next;
+  sentinel_.prev = other.sentinel_.prev;
+  sentinel_.next->prev = &sentinel_;
+  sentinel_.prev->next = &sentinel_;
+  other.sentinel_.prev = other.sentinel_.next = &other.sentinel_;
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+IntrusiveList<T, Hook>::~IntrusiveList() {
+  clear();
+  sentinel_.prev = sentinel_.next = nullptr;
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+void IntrusiveList<T, Hook>::push_back(T& value) {
+  insert(end(), value);
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+void IntrusiveList<T, Hook>::push_front(T& value) {
+  insert(begin(), value);
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+void IntrusiveList<T, Hook>::pop_back() {
+  sentinel_.prev->unlink();
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+void IntrusiveList<T, Hook>::pop_front() {
+  sentinel_.next->unlink();
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+T& IntrusiveList<T, Hook>::front() {
+  return *FromHook(sentinel_.next);
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+const T& IntrusiveList<T, Hook>::front() const {
+  return *FromHook(sentinel_.next);
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+T& IntrusiveList<T, Hook>::back() {
+  return *FromHook(sentinel_.prev);
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+const T& IntrusiveList<T, Hook>::back() const {
+  return *FromHook(sentinel_.prev);
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+typename IntrusiveList<T, Hook>::iterator IntrusiveList<T, Hook>::begin() {
+  return iterator(sentinel_.next);
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+typename IntrusiveList<T, Hook>::const_iterator IntrusiveList<T, Hook>::begin() const {
+  return const_iterator(sentinel_.next);
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+typename IntrusiveList<T, Hook>::const_iterator IntrusiveList<T, Hook>::cbegin() const {
+  return begin();
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+typename IntrusiveList<T, Hook>::iterator IntrusiveList<T, Hook>::end() {
+  return iterator(&sentinel_);
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+typename IntrusiveList<T, Hook>::const_iterator IntrusiveList<T, Hook>::end() const {
+  return const_iterator(const_cast<IntrusiveListHook*>(&sentinel_));
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+typename IntrusiveList<T, Hook>::const_iterator IntrusiveList<T, Hook>::cend() const {
+  return end();
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+typename IntrusiveList<T, Hook>::reverse_iterator IntrusiveList<T, Hook>::rbegin() {
+  return reverse_iterator(end());
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+typename IntrusiveList<T, Hook>::const_reverse_iterator IntrusiveList<T, Hook>::rbegin() const {
+  return const_reverse_iterator(end());
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+typename IntrusiveList<T, Hook>::const_reverse_iterator IntrusiveList<T, Hook>::crbegin() const {
+  return const_reverse_iterator(end());
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+typename IntrusiveList<T, Hook>::reverse_iterator IntrusiveList<T, Hook>::rend() {
+  return reverse_iterator(begin());
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+typename IntrusiveList<T, Hook>::const_reverse_iterator IntrusiveList<T, Hook>::rend() const {
+  return const_reverse_iterator(begin());
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+typename IntrusiveList<T, Hook>::const_reverse_iterator IntrusiveList<T, Hook>::crend() const {
+  return const_reverse_iterator(begin());
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+typename IntrusiveList<T, Hook>::iterator IntrusiveList<T, Hook>::insert(const_iterator pos, T& value) {
+  auto hook = ToHook(value);
+  // Linking it again would cut it out of the list it is on.
+  assert(!hook->is_linked());
+  ptrdiff_t offset = reinterpret_cast<char*>(hook) - reinterpret_cast<char*>(&value);
+  if (hook_offset_.load(std::memory_order_relaxed) != offset) {
+    hook_offset_.store(offset, std::memory_order_relaxed);
+  }
+  auto next = pos.GetNode();
+  hook->prev = next->prev;
+  hook->next = next;
+  next->prev->next = hook;
+  next->prev = hook;
+  return iterator(hook);
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+typename IntrusiveList<T, Hook>::iterator IntrusiveList<T, Hook>::erase(const_iterator pos) {
+  auto next = pos.GetNode()->next;
+  pos.GetNode()->unlink();
+  return iterator(next);
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+void IntrusiveList<T, Hook>::clear() {
+  while (sentinel_.next != &sentinel_) {
+    sentinel_.next->unlink();
+  }
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+typename IntrusiveList<T, Hook>::iterator IntrusiveList<T, Hook>::iterator_to(T& value) {
+  return iterator(ToHook(value));
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+typename IntrusiveList<T, Hook>::const_iterator IntrusiveList<T, Hook>::iterator_to(const T& value) {
+  return const_iterator(ToHook(value));
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+bool IntrusiveList<T, Hook>::empty() const {
+  return sentinel_.next == &sentinel_;
+}
+
+template<typename T, IntrusiveListHook T::*Hook>
+size_t IntrusiveList<T, Hook>::size() const {
+  size_t size = 0;
+  for (auto node = sentinel_.next; node != &sentinel_; node = node->next) {
+    ++size;
+  }
+  return size;
+}
+
+#endif//LIST__INTRUSIVE_LIST_H_
@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+
+#include <list>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "intrusive_list.h"
+
+namespace {
+
+// Polymorphic, with the hooks behind other members, so that the hook
+// offsets are neither zero nor the same for both lists.
+struct Item {
+  explicit Item(int id) : id(id) {}
+  virtual ~Item() = default;
+
+  std::string name = "item";
+  int id;
+  IntrusiveListHook by_age;
+  IntrusiveListHook by_use;
+};
+
+using AgeList = IntrusiveList<Item, &Item::by_age>;
+using UseList = IntrusiveList<Item, &Item::by_use>;
+
+template<typename List>
+std::vector<int> Ids(const List& list) {
+  std::vector<int> ids;
+  for (const Item& item : list) {
+    ids.push_back(item.id);
+  }
+  return ids;
+}
+
+TEST(IntrusiveListTest, MatchesStdList) {
+  std::mt19937 random(1);
+  std::vector<std::unique_ptr<Item>> items;
+  AgeList list;
+  std::list<int> expected;
+  for (int i = 0; i < 10'000; ++i) {
+    if (expected.empty() || random() % 3 != 0) {
+      items.push_back(std::make_unique<Item>(i));
+      if (random() % 2 == 0) {
+        list.push_back(*items.back());
+        expected.push_back(i);
+      } else {
+        list.push_front(*items.back());
+        expected.push_front(i);
+      }
+    } else if (random() % 2 == 0) {
+      EXPECT_EQ(list.front().id, expected.front());
+      list.pop_front();
+      expected.pop_front();
+    } else {
+      EXPECT_EQ(list.back().id, expected.back());
+      list.pop_back();
+      expected.pop_back();
+    }
+  }
+  EXPECT_EQ(Ids(list), std::vector<int>(expected.begin(), expected.end()));
+  EXPECT_EQ(list.size(), expected.size());
+}
+
+TEST(IntrusiveListTest, ObjectsSitOnOneListPerHook) {
+  std::vector<std::unique_ptr<Item>> items;
+  AgeList by_age;
+  UseList by_use;
+  for (int i = 0; i < 5; ++i) {
+    items.push_back(std::make_unique<Item>(i));
+    by_age.push_back(*items.back());
+    by_use.push_front(*items.back());
+  }
+  // Touching an item moves it to the front of the use list only.
+  by_use.erase(UseList::iterator_to(*items[1]));
+  by_use.push_front(*items[1]);
+  EXPECT_EQ(Ids(by_age), (std::vector<int>{0, 1, 2, 3, 4}));
+  EXPECT_EQ(Ids(by_use), (std::vector<int>{1, 4, 3, 2, 0}));
+  EXPECT_EQ(AgeList::iterator_to(*items[3])->id, 3);
+  EXPECT_EQ(&*UseList::iterator_to(*items[2]), items[2].get());
+}
+
+TEST(IntrusiveListTest, DestroyedObjectsUnlinkThemselves) {
+  std::vector<std::unique_ptr<Item>> items;
+  AgeList list;
+  for (int i = 0; i < 5; ++i) {
+    items.push_back(std::make_unique<Item>(i));
+    list.push_back(*items.back());
+  }
+  items[0].reset();
+  items[2].reset();
+  items[4].reset();
+  EXPECT_EQ(Ids(list), (std::vector<int>{1, 3}));
+
+  // Copies start out unlinked.
+  Item copy = *items[1];
+  EXPECT_TRUE(items[1]->by_age.is_linked());
+  EXPECT_FALSE(copy.by_age.is_linked());
+
+  AgeList moved(std::move(list));
+  EXPECT_TRUE(list.empty());
+  EXPECT_EQ(Ids(moved), (std::vector<int>{1, 3}));
+  moved.clear();
+  EXPECT_FALSE(items[1]->by_age.is_linked());
+}
+
+#if !defined(NDEBUG) && GTEST_HAS_DEATH_TEST
+TEST(IntrusiveListDeathTest, InsertingLinkedObjectAsserts) {
+  Item item(0);
+  AgeList first;
+  AgeList second;
+  first.push_back(item);
+  EXPECT_DEATH(second.push_back(item), "is_linked");
+}
+#endif
+
+}  // namespace
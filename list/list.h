@@ -2,6 +2,9 @@
 // Created by vsvood on 05.04.2022.
 //
 
+#ifndef LIST__LIST_H_
+#define LIST__LIST_H_
+
 #include <chrono>
 #include <stdexcept>
 #include <string>
@@ -14,6 +17,9 @@
 #include <algorithm>
 #include <sstream>
 #include <cassert>
+#include <functional>
+#include <type_traits>
+#include <utility>
 #include <sys/resource.h>
 
 #include <cstddef>
@@ -124,9 +130,6 @@ bool StackAllocator<T, N>::operator!=(const StackAllocator<U, M> &other) const {
 
 
 
-#ifndef LIST__LIST_H_
-#define LIST__LIST_H_
-
 template<typename T, typename Allocator = std::allocator<T>>
 class List {
  private:
@@ -141,17 +144,28 @@ class List {
 
   using allocator_type = Allocator;
 
+  // The bulk constructors, copies, assign and the inserts of more than one
+  // element allocate their nodes as one slab, laid out in list order. Erased
+  // slab nodes are kept for later inserts, and a slab goes back to the
+  // allocator only with the list or in compact(), so erasing most of the
+  // elements of such a list does not give memory back.
   List();
   List(size_t n);
   List(size_t n, const T& value);
   List(Allocator allocator);
   List(size_t n, Allocator allocator);
   List(size_t n, const T& value, Allocator allocator);
+  template<typename InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category>
+  List(InputIt first, InputIt last, Allocator allocator = Allocator());
   List(const List& other);
   ~List();
 
   List& operator=(const List& other);
 
+  void assign(size_t n, const T& value);
+  template<typename InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category>
+  void assign(InputIt first, InputIt last);
+
   void push_back(const T& value);
   void push_front(const T& value);
   void pop_back();
@@ -172,9 +186,41 @@ class List {
   const_reverse_iterator crend() const;
 
   iterator insert(const_iterator pos, const T& value);
+  // Constructs the element in its node from args.
+  template<typename... Args>
+  iterator emplace(const_iterator pos, Args&&... args);
   typename List<T, Allocator>::iterator insert(List::const_iterator pos);
+  iterator insert(const_iterator pos, size_t n, const T& value);
+  template<typename InputIt, typename = typename std::iterator_traits<InputIt>::iterator_category>
+  iterator insert(const_iterator pos, InputIt first, InputIt last);
   iterator erase(const_iterator pos);
-
+  // Relinks the node at it from other in front of pos. other may be this
+  // list; otherwise the allocators have to compare equal. A node of one of
+  // other's slabs cannot change lists, so its element is moved into a new
+  // node instead, or copied if the move may throw. That may allocate and
+  // throw, which leaves both lists unchanged, and it invalidates it and
+  // references to the element.
+  void splice(const_iterator pos, List& other, const_iterator it);
+  // Merges the sorted list other into this sorted one; of equal elements,
+  // those of this list come first. Nodes move as in splice, so elements in
+  // other's slabs get new nodes. If that throws, other keeps the elements
+  // not merged yet.
+  template<typename Compare = std::less<>>
+  void merge(List& other, Compare comp = Compare());
+  // Stable merge sort which relinks the nodes, so iterators stay valid. If
+  // comp throws, the list keeps all of its elements in unspecified order.
+  template<typename Compare = std::less<>>
+  void sort(Compare comp = Compare());
+
+  // Moves all elements into one freshly allocated block of nodes, laid out
+  // in traversal order. Invalidates all iterators.
+  void compact();
+  // Calls f on every element while prefetching the node `distance` steps
+  // ahead.
+  template<typename F>
+  void for_each_prefetched(F f, size_t distance = 4);
+  template<typename F>
+  void for_each_prefetched(F f, size_t distance = 4) const;
 
   size_t size() const;
   allocator_type get_allocator() const;
@@ -182,14 +228,51 @@ class List {
  private:
   struct BaseNode;
   struct Node;
+  struct Slab;
+  // Run of linked nodes out of any list; tail->next is null.
+  struct Chain {
+    BaseNode* head = nullptr;
+    BaseNode* tail = nullptr;
+  };
+
+  // ParallelSort of parallel.h sorts chains of the list on several threads.
+  friend class ListParallel;
+
+  template<typename... Args>
+  Node* CreateNode(Args&&... args);
+  void ReleaseNode(BaseNode* node);
+  iterator Link(const_iterator pos, BaseNode* first, BaseNode* last);
+  template<typename Construct>
+  iterator InsertSlab(const_iterator pos, size_t n, Construct construct);
+  template<typename InputIt>
+  iterator InsertRange(const_iterator pos, InputIt first, InputIt last);
+  void Swap(List& other);
+  void DestroyNodes(BaseNode* first, BaseNode* last, Slab* slabs, BaseNode* free_nodes, size_t loose_nodes);
+  template<typename NodeType, typename F>
+  static void ForEachPrefetched(BaseNode* first, BaseNode* last, F& f, size_t distance);
+  Chain DetachNodes();
+  void AttachNodes(Chain chain);
+  static void AppendChain(Chain& to, Chain& from);
+  template<typename Compare>
+  static void MergeChains(Chain& to, Chain& from, Compare& comp);
+  template<typename Compare>
+  static void SortChain(Chain& chain, Compare& comp);
 
   size_t size_ = 0;
   iterator begin_;
   iterator end_;
   using base_allocator_type = typename std::allocator_traits<Allocator>::template rebind_alloc<BaseNode>;
   using inner_allocator_type = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+  using slab_allocator_type = typename std::allocator_traits<Allocator>::template rebind_alloc<Slab>;
   inner_allocator_type allocator_;
   base_allocator_type base_allocator_;
+  // Bulk operations allocate their nodes as one array. Such nodes are never
+  // deallocated one by one: erase parks them in free_nodes_ for reuse and
+  // the arrays are returned to the allocator with the list.
+  Slab* slabs_ = nullptr;
+  BaseNode* free_nodes_ = nullptr;
+  // Number of linked nodes allocated one by one rather than in a slab.
+  size_t loose_nodes_ = 0;
 };
 
 template<typename T, typename Allocator>
@@ -198,6 +281,7 @@ struct List<T, Allocator>::BaseNode {
   virtual ~BaseNode() = default;
   BaseNode* prev;
   BaseNode* next;
+  bool from_slab = false;
 };
 
 template<typename T, typename Allocator>
@@ -205,9 +289,19 @@ struct List<T, Allocator>::Node : BaseNode {
   Node() = default;
   virtual ~Node() = default;
   Node(const T& value) : value(value) {}
+  Node(T&& value) : value(std::move(value)) {}
+  template<typename... Args>
+  Node(std::in_place_t, Args&&... args) : value(std::forward<Args>(args)...) {}
   T value;
 };
 
+template<typename T, typename Allocator>
+struct List<T, Allocator>::Slab {
+  Slab* next;
+  Node* nodes;
+  size_t count;
+};
+
 template<typename T, typename Allocator>
 template <bool is_const>
 class List<T, Allocator>::CommonIterator {
@@ -316,13 +410,13 @@ bool List<T, Allocator>::CommonIterator<is_const>::operator!=(const CommonIterat
 template<typename T, typename Allocator>
 template<bool is_const>
 typename List<T, Allocator>::template CommonIterator<is_const>::reference List<T, Allocator>::CommonIterator<is_const>::operator*() {
-  return dynamic_cast<Node*>(node_)->value;
+  return static_cast<Node*>(node_)->value;
 }
 
 template<typename T, typename Allocator>
 template<bool is_const>
 typename List<T, Allocator>::template CommonIterator<is_const>::pointer List<T, Allocator>::CommonIterator<is_const>::operator->() {
-  return &(dynamic_cast<Node*>(node_)->value);
+  return &(static_cast<Node*>(node_)->value);
 }
 
 template<typename T, typename Allocator>
@@ -336,15 +430,20 @@ List<T, Allocator>::List(Allocator allocator) : allocator_(allocator), base_allo
 
 template<typename T, typename Allocator>
 List<T, Allocator>::List(size_t n, Allocator allocator) : List(allocator) {
-    while(n--)
-      insert(end_);
+  InsertSlab(end_, n, [this](Node* ptr, size_t) {
+    std::allocator_traits<inner_allocator_type>::construct(allocator_, ptr);
+  });
 }
 
 template<typename T, typename Allocator>
 List<T, Allocator>::List(size_t n, const T &value, Allocator allocator) : List(allocator) {
-  while (n--) {
-      push_back(value);
-  }
+  insert(end_, n, value);
+}
+
+template<typename T, typename Allocator>
+template<typename InputIt, typename>
+List<T, Allocator>::List(InputIt first, InputIt last, Allocator allocator) : List(allocator) {
+  InsertRange(end_, first, last);
 }
 
 template<typename T, typename Allocator>
@@ -358,56 +457,92 @@ List<T, Allocator>::List(size_t n, const T &value) : List(n, value, inner_alloca
 
 template<typename T, typename Allocator>
 List<T, Allocator>::List(const List &other) : List(std::allocator_traits<inner_allocator_type>::select_on_container_copy_construction(other.allocator_)) {
-  for (const auto &elem : other) {
-    push_back(elem);
-  }
+  auto elem = other.begin();
+  InsertSlab(end_, other.size_, [this, &elem](Node* ptr, size_t) {
+    std::allocator_traits<inner_allocator_type>::construct(allocator_, ptr, *elem);
+    ++elem;
+  });
 }
 
 template<typename T, typename Allocator>
 List<T, Allocator>::~List() {
-  while (size_) {
-    pop_back();
-  }
-  std::allocator_traits<base_allocator_type>::destroy(base_allocator_, begin_.GetNode());
-  base_allocator_.deallocate(begin_.GetNode(), 1);
+  DestroyNodes(begin_.GetNode(), end_.GetNode(), slabs_, free_nodes_, loose_nodes_);
+  std::allocator_traits<base_allocator_type>::destroy(base_allocator_, end_.GetNode());
+  base_allocator_.deallocate(end_.GetNode(), 1);
 }
 
 template<typename T, typename Allocator>
-List<T, Allocator> &List<T, Allocator>::operator=(const List &other) {
-  auto size_tmp = size_;
-  auto begin_tmp = begin_;
-  auto end_tmp = end_;
-  auto allocator_tmp = allocator_;
-  auto base_alloctor_tmp = base_allocator_;
-  if (std::allocator_traits<allocator_type>::propagate_on_container_copy_assignment::value)
-    allocator_ = other.get_allocator();
-  try {
-    size_ = 0;
-    auto ptr = base_allocator_.allocate(1);
-    std::allocator_traits<base_allocator_type>::construct(base_allocator_, ptr);
-    ptr->prev = ptr->next = ptr;
-    begin_ = iterator(ptr);
-    end_ = begin_;
-    for (const auto& elem : other) {
-      push_back(elem);
+void List<T, Allocator>::DestroyNodes(BaseNode* first, BaseNode* last, Slab* slabs, BaseNode* free_nodes,
+                                      size_t loose_nodes) {
+  // Slab nodes holding a trivially destructible T need nothing beyond
+  // freeing their slab, so the chain is walked only if it has other work.
+  if (!std::is_trivially_destructible_v<T> || loose_nodes != 0) {
+    auto node = first;
+    while (node != last) {
+      auto next = node->next;
+      auto ptr = static_cast<Node*>(node);
+      bool from_slab = node->from_slab;
+      if constexpr (!std::is_trivially_destructible_v<T>) {
+        std::allocator_traits<inner_allocator_type>::destroy(allocator_, ptr);
+      }
+      if (!from_slab) {
+        allocator_.deallocate(ptr, 1);
+      }
+      node = next;
     }
-  } catch (...) {
-    this->~List();
-    size_ = size_tmp;
-    begin_ = begin_tmp;
-    end_ = end_tmp;
-    allocator_ = allocator_tmp;
-    base_allocator_ = base_alloctor_tmp;
-    throw;
   }
-  while (begin_tmp != end_tmp) {
-    std::allocator_traits<inner_allocator_type>::destroy(allocator_tmp, begin_tmp.GetNode());
-    base_alloctor_tmp.deallocate(begin_tmp.GetNode(), 1);
-    ++begin_tmp;
+  while (free_nodes != nullptr) {
+    auto next = free_nodes->next;
+    std::allocator_traits<base_allocator_type>::destroy(base_allocator_, free_nodes);
+    free_nodes = next;
   }
+  slab_allocator_type slab_allocator(allocator_);
+  while (slabs != nullptr) {
+    auto next = slabs->next;
+    allocator_.deallocate(slabs->nodes, slabs->count);
+    slab_allocator.deallocate(slabs, 1);
+    slabs = next;
+  }
+}
+
+template<typename T, typename Allocator>
+List<T, Allocator> &List<T, Allocator>::operator=(const List &other) {
+  if (this == &other) {
+    return *this;
+  }
+  Allocator allocator = allocator_;
+  if (std::allocator_traits<allocator_type>::propagate_on_container_copy_assignment::value)
+    allocator = other.get_allocator();
+  List tmp(other.begin(), other.end(), allocator);
+  Swap(tmp);
   return *this;
 }
 
+template<typename T, typename Allocator>
+void List<T, Allocator>::assign(size_t n, const T& value) {
+  List tmp(n, value, allocator_);
+  Swap(tmp);
+}
+
+template<typename T, typename Allocator>
+template<typename InputIt, typename>
+void List<T, Allocator>::assign(InputIt first, InputIt last) {
+  List tmp(first, last, allocator_);
+  Swap(tmp);
+}
+
+template<typename T, typename Allocator>
+void List<T, Allocator>::Swap(List& other) {
+  std::swap(size_, other.size_);
+  std::swap(begin_, other.begin_);
+  std::swap(end_, other.end_);
+  std::swap(allocator_, other.allocator_);
+  std::swap(base_allocator_, other.base_allocator_);
+  std::swap(slabs_, other.slabs_);
+  std::swap(free_nodes_, other.free_nodes_);
+  std::swap(loose_nodes_, other.loose_nodes_);
+}
+
 template<typename T, typename Allocator>
 void List<T, Allocator>::push_back(const T& value) {
   insert(end_, value);
@@ -488,33 +623,162 @@ typename List<T, Allocator>::const_reverse_iterator List<T, Allocator>::crend()
 }
 
 template<typename T, typename Allocator>
-typename List<T, Allocator>::iterator List<T, Allocator>::insert(List::const_iterator pos, const T &value) {
-  auto ptr = allocator_.allocate(1);
-  std::allocator_traits<inner_allocator_type>::construct(allocator_, ptr, value);
-  ++size_;
-  ptr->next = pos.GetNode();
-  ptr->prev = std::prev(pos).GetNode();
-  std::prev(pos).SetNext(ptr);
-  pos.SetPrev(ptr);
+template<typename... Args>
+typename List<T, Allocator>::Node* List<T, Allocator>::CreateNode(Args&&... args) {
+  if (free_nodes_ == nullptr) {
+    auto ptr = allocator_.allocate(1);
+    try {
+      std::allocator_traits<inner_allocator_type>::construct(allocator_, ptr, std::forward<Args>(args)...);
+    } catch (...) {
+      allocator_.deallocate(ptr, 1);
+      throw;
+    }
+    ++loose_nodes_;
+    return ptr;
+  }
+  auto slot = free_nodes_;
+  auto next = slot->next;
+  std::allocator_traits<base_allocator_type>::destroy(base_allocator_, slot);
+  auto ptr = static_cast<Node*>(static_cast<void*>(slot));
+  try {
+    std::allocator_traits<inner_allocator_type>::construct(allocator_, ptr, std::forward<Args>(args)...);
+  } catch (...) {
+    std::allocator_traits<base_allocator_type>::construct(base_allocator_, slot);
+    slot->from_slab = true;
+    slot->next = next;
+    throw;
+  }
+  free_nodes_ = next;
+  ptr->from_slab = true;
+  return ptr;
+}
+
+template<typename T, typename Allocator>
+void List<T, Allocator>::ReleaseNode(BaseNode* node) {
+  auto ptr = static_cast<Node*>(node);
+  bool from_slab = node->from_slab;
+  std::allocator_traits<inner_allocator_type>::destroy(allocator_, ptr);
+  if (!from_slab) {
+    allocator_.deallocate(ptr, 1);
+    --loose_nodes_;
+    return;
+  }
+  std::allocator_traits<base_allocator_type>::construct(base_allocator_, node);
+  node->from_slab = true;
+  node->next = free_nodes_;
+  free_nodes_ = node;
+}
+
+template<typename T, typename Allocator>
+typename List<T, Allocator>::iterator List<T, Allocator>::Link(const_iterator pos, BaseNode* first, BaseNode* last) {
+  auto prev = std::prev(pos);
+  first->prev = prev.GetNode();
+  last->next = pos.GetNode();
+  prev.SetNext(first);
+  pos.SetPrev(last);
   if (pos == begin_) {
-    begin_ = iterator(ptr);
+    begin_ = iterator(first);
+  }
+  return iterator(first);
+}
+
+template<typename T, typename Allocator>
+template<typename Construct>
+typename List<T, Allocator>::iterator List<T, Allocator>::InsertSlab(const_iterator pos, size_t n, Construct construct) {
+  if (n == 0) {
+    return iterator(pos.GetNode());
+  }
+  slab_allocator_type slab_allocator(allocator_);
+  auto slab = slab_allocator.allocate(1);
+  Node* nodes;
+  try {
+    nodes = allocator_.allocate(n);
+  } catch (...) {
+    slab_allocator.deallocate(slab, 1);
+    throw;
   }
-  return iterator(ptr);
+  size_t i = 0;
+  try {
+    for (; i < n; ++i) {
+      construct(nodes + i, i);
+      nodes[i].from_slab = true;
+      if (i > 0) {
+        nodes[i - 1].next = nodes + i;
+        nodes[i].prev = nodes + i - 1;
+      }
+    }
+  } catch (...) {
+    while (i--) {
+      std::allocator_traits<inner_allocator_type>::destroy(allocator_, nodes + i);
+    }
+    allocator_.deallocate(nodes, n);
+    slab_allocator.deallocate(slab, 1);
+    throw;
+  }
+  slab->nodes = nodes;
+  slab->count = n;
+  slab->next = slabs_;
+  slabs_ = slab;
+  size_ += n;
+  return Link(pos, nodes, nodes + n - 1);
+}
+
+template<typename T, typename Allocator>
+template<typename InputIt>
+typename List<T, Allocator>::iterator List<T, Allocator>::InsertRange(const_iterator pos, InputIt first, InputIt last) {
+  using category = typename std::iterator_traits<InputIt>::iterator_category;
+  if constexpr (std::is_base_of_v<std::forward_iterator_tag, category>) {
+    return InsertSlab(pos, std::distance(first, last), [this, &first](Node* ptr, size_t) {
+      std::allocator_traits<inner_allocator_type>::construct(allocator_, ptr, *first);
+      ++first;
+    });
+  } else {
+    iterator ret(pos.GetNode());
+    bool is_first = true;
+    for (; first != last; ++first) {
+      auto it = insert(pos, *first);
+      if (is_first) {
+        ret = it;
+        is_first = false;
+      }
+    }
+    return ret;
+  }
+}
+
+template<typename T, typename Allocator>
+typename List<T, Allocator>::iterator List<T, Allocator>::insert(List::const_iterator pos, const T &value) {
+  auto ptr = CreateNode(value);
+  ++size_;
+  return Link(pos, ptr, ptr);
+}
+
+template<typename T, typename Allocator>
+template<typename... Args>
+typename List<T, Allocator>::iterator List<T, Allocator>::emplace(const_iterator pos, Args&&... args) {
+  auto ptr = CreateNode(std::in_place, std::forward<Args>(args)...);
+  ++size_;
+  return Link(pos, ptr, ptr);
 }
 
 template<typename T, typename Allocator>
 typename List<T, Allocator>::iterator List<T, Allocator>::insert(List::const_iterator pos) {
-  auto ptr = allocator_.allocate(1);
-  std::allocator_traits<inner_allocator_type>::construct(allocator_, ptr);
+  auto ptr = CreateNode();
   ++size_;
-  ptr->next = pos.GetNode();
-  ptr->prev = std::prev(pos).GetNode();
-  std::prev(pos).SetNext(ptr);
-  pos.SetPrev(ptr);
-  if (pos == begin_) {
-    begin_ = iterator(ptr);
-  }
-  return iterator(ptr);
+  return Link(pos, ptr, ptr);
+}
+
+template<typename T, typename Allocator>
+typename List<T, Allocator>::iterator List<T, Allocator>::insert(const_iterator pos, size_t n, const T& value) {
+  return InsertSlab(pos, n, [this, &value](Node* ptr, size_t) {
+    std::allocator_traits<inner_allocator_type>::construct(allocator_, ptr, value);
+  });
+}
+
+template<typename T, typename Allocator>
+template<typename InputIt, typename>
+typename List<T, Allocator>::iterator List<T, Allocator>::insert(const_iterator pos, InputIt first, InputIt last) {
+  return InsertRange(pos, first, last);
 }
 
 template<typename T, typename Allocator>
@@ -524,14 +788,280 @@ typename List<T, Allocator>::iterator List<T, Allocator>::erase(List::const_iter
   auto prev = std::prev(pos);
   next.SetPrev(prev.GetNode());
   prev.SetNext(next.GetNode());
-  std::allocator_traits<inner_allocator_type>::destroy(allocator_, pos.GetNode());
-  allocator_.deallocate(dynamic_cast<Node*>(pos.GetNode()), 1);
   if (pos == begin_) {
     begin_ = iterator(next.GetNode());
   }
+  ReleaseNode(pos.GetNode());
   return iterator(next.GetNode());
 }
 
+template<typename T, typename Allocator>
+void List<T, Allocator>::splice(const_iterator pos, List& other, const_iterator it) {
+  auto node = it.GetNode();
+  if (pos.GetNode() == node || pos.GetNode() == node->next) {
+    return;
+  }
+  if (&other != this && node->from_slab) {
+    // The node belongs to one of other's slabs and cannot change owner.
+    auto ptr = CreateNode(std::move_if_noexcept(static_cast<Node*>(node)->value));
+    ++size_;
+    Link(pos, ptr, ptr);
+    other.erase(it);
+    return;
+  }
+  node->prev->next = node->next;
+  node->next->prev = node->prev;
+  if (it == other.begin_) {
+    other.begin_ = iterator(node->next);
+  }
+  if (&other != this) {
+    --other.loose_nodes_;
+    ++loose_nodes_;
+  }
+  --other.size_;
+  ++size_;
+  Link(pos, node, node);
+}
+
+template<typename T, typename Allocator>
+template<typename Compare>
+void List<T, Allocator>::merge(List& other, Compare comp) {
+  if (&other == this) {
+    return;
+  }
+  auto pos = begin_;
+  while (other.size_ != 0) {
+    auto it = other.begin_;
+    while (pos != end_ && !comp(*it, *pos)) {
+      ++pos;
+    }
+    splice(pos, other, it);
+  }
+}
+
+template<typename T, typename Allocator>
+template<typename Compare>
+void List<T, Allocator>::sort(Compare comp) {
+  if (size_ < 2) {
+    return;
+  }
+  auto chain = DetachNodes();
+  try {
+    SortChain(chain, comp);
+  } catch (...) {
+    AttachNodes(chain);
+    throw;
+  }
+  AttachNodes(chain);
+}
+
+// Unlinks all nodes from the sentinel. size_ stays as it is, for
+// AttachNodes to put the same nodes back.
+template<typename T, typename Allocator>
+typename List<T, Allocator>::Chain List<T, Allocator>::DetachNodes() {
+  auto sentinel = end_.GetNode();
+  Chain chain;
+  if (size_ != 0) {
+    chain.head = sentinel->next;
+    chain.tail = sentinel->prev;
+    chain.tail->next = nullptr;
+  }
+  sentinel->prev = sentinel->next = sentinel;
+  begin_ = end_;
+  return chain;
+}
+
+template<typename T, typename Allocator>
+void List<T, Allocator>::AttachNodes(Chain chain) {
+  if (chain.head == nullptr) {
+    return;
+  }
+  auto sentinel = end_.GetNode();
+  sentinel->next = chain.head;
+  chain.head->prev = sentinel;
+  sentinel->prev = chain.tail;
+  chain.tail->next = sentinel;
+  begin_ = iterator(chain.head);
+}
+
+template<typename T, typename Allocator>
+void List<T, Allocator>::AppendChain(Chain& to, Chain& from) {
+  if (from.head == nullptr) {
+    return;
+  }
+  if (to.head == nullptr) {
+    to.head = from.head;
+  } else {
+    to.tail->next = from.head;
+    from.head->prev = to.tail;
+  }
+  to.tail = from.tail;
+  from = Chain();
+}
+
+// Stable merge of the sorted chains to and from into to, which takes the
+// earlier place on ties. If comp throws, to keeps all the nodes, merged
+// only in part.
+template<typename T, typename Allocator>
+template<typename Compare>
+void List<T, Allocator>::MergeChains(Chain& to, Chain& from, Compare& comp) {
+  auto left = to.head;
+  auto right = from.head;
+  Chain merged;
+  try {
+    while (left != nullptr && right != nullptr) {
+      BaseNode* node;
+      if (comp(static_cast<Node*>(right)->value, static_cast<Node*>(left)->value)) {
+        node = right;
+        right = right->next;
+      } else {
+        node = left;
+        left = left->next;
+      }
+      if (merged.head == nullptr) {
+        merged.head = node;
+      } else {
+        merged.tail->next = node;
+        node->prev = merged.tail;
+      }
+      merged.tail = node;
+    }
+  } catch (...) {
+    Chain rest_left{left, to.tail};
+    Chain rest_right{right, from.tail};
+    if (merged.tail != nullptr) {
+      merged.tail->next = nullptr;
+    }
+    AppendChain(merged, rest_left);
+    AppendChain(merged, rest_right);
+    to = merged;
+    from = Chain();
+    throw;
+  }
+  Chain rest{left != nullptr ? left : right, left != nullptr ? to.tail : from.tail};
+  if (merged.tail != nullptr) {
+    merged.tail->next = nullptr;
+  }
+  AppendChain(merged, rest);
+  to = merged;
+  from = Chain();
+}
+
+// Bottom-up merge sort: bins[i] holds a sorted run of 2^i nodes, each
+// older than those in lower bins, and every node carries into the bins
+// like a binary counter. No pass has to walk a chain to split it.
+template<typename T, typename Allocator>
+template<typename Compare>
+void List<T, Allocator>::SortChain(Chain& chain, Compare& comp) {
+  Chain bins[64];
+  size_t used = 0;
+  Chain carry;
+  Chain sorted;
+  try {
+    while (chain.head != nullptr) {
+      auto node = chain.head;
+      chain.head = node->next;
+      if (chain.head == nullptr) {
+        chain.tail = nullptr;
+      }
+      node->next = nullptr;
+      carry = Chain{node, node};
+      size_t i = 0;
+      for (; bins[i].head != nullptr; ++i) {
+        MergeChains(bins[i], carry, comp);
+        std::swap(carry, bins[i]);
+      }
+      std::swap(carry, bins[i]);
+      used = std::max(used, i + 1);
+    }
+    for (size_t i = 0; i < used; ++i) {
+      MergeChains(bins[i], sorted, comp);
+      std::swap(sorted, bins[i]);
+    }
+  } catch (...) {
+    // Hand back every node: the unsorted rest, the bins and the runs in
+    // flight.
+    Chain all;
+    AppendChain(all, sorted);
+    AppendChain(all, carry);
+    for (auto& bin : bins) {
+      AppendChain(all, bin);
+    }
+    AppendChain(all, chain);
+    chain = all;
+    throw;
+  }
+  chain = sorted;
+}
+
+template<typename T, typename Allocator>
+void List<T, Allocator>::compact() {
+  auto sentinel = end_.GetNode();
+  auto first = begin_.GetNode();
+  auto last = sentinel->prev;
+  auto slabs = slabs_;
+  auto free_nodes = free_nodes_;
+  auto loose_nodes = loose_nodes_;
+  auto size = size_;
+
+  sentinel->prev = sentinel->next = sentinel;
+  begin_ = end_;
+  size_ = 0;
+  slabs_ = nullptr;
+  free_nodes_ = nullptr;
+  loose_nodes_ = 0;
+  auto elem = first;
+  try {
+    InsertSlab(end_, size, [this, &elem](Node* ptr, size_t) {
+      std::allocator_traits<inner_allocator_type>::construct(allocator_, ptr,
+                                                             std::move_if_noexcept(static_cast<Node*>(elem)->value));
+      elem = elem->next;
+    });
+  } catch (...) {
+    if (size != 0) {
+      sentinel->next = first;
+      sentinel->prev = last;
+      begin_ = iterator(first);
+    }
+    size_ = size;
+    slabs_ = slabs;
+    free_nodes_ = free_nodes;
+    loose_nodes_ = loose_nodes;
+    throw;
+  }
+  DestroyNodes(first, sentinel, slabs, free_nodes, loose_nodes);
+}
+
+template<typename T, typename Allocator>
+template<typename NodeType, typename F>
+void List<T, Allocator>::ForEachPrefetched(BaseNode* first, BaseNode* last, F& f, size_t distance) {
+  auto ahead = first;
+  for (size_t i = 0; i < distance && ahead != last; ++i) {
+    ahead = ahead->next;
+  }
+  for (auto node = first; node != last; node = node->next) {
+    if (ahead != last) {
+#if defined(__GNUC__)
+      __builtin_prefetch(ahead->next);
+#endif
+      ahead = ahead->next;
+    }
+    f(static_cast<NodeType*>(node)->value);
+  }
+}
+
+template<typename T, typename Allocator>
+template<typename F>
+void List<T, Allocator>::for_each_prefetched(F f, size_t distance) {
+  ForEachPrefetched<Node>(begin_.GetNode(), end_.GetNode(), f, distance);
+}
+
+template<typename T, typename Allocator>
+template<typename F>
+void List<T, Allocator>::for_each_prefetched(F f, size_t distance) const {
+  ForEachPrefetched<const Node>(begin_.GetNode(), end_.GetNode(), f, distance);
+}
+
 template<typename T, typename Allocator>
 size_t List<T, Allocator>::size() const {
   return size_;
@@ -0,0 +1,508 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "list.h"
+
+namespace {
+
+template<typename T, typename Allocator>
+void ExpectEqual(const List<T, Allocator>& list, const std::list<T>& expected) {
+  ASSERT_EQ(list.size(), expected.size());
+  auto it = expected.begin();
+  for (const auto& value : list) {
+    ASSERT_EQ(value, *it++);
+  }
+}
+
+// Expects the elements from first to last at a constant stride, as the
+// nodes of one slab in list order are.
+template<typename Iterator>
+void ExpectOneSlab(Iterator first, Iterator last) {
+  std::vector<std::uintptr_t> addresses;
+  for (; first != last; ++first) {
+    addresses.push_back(reinterpret_cast<std::uintptr_t>(&*first));
+  }
+  ASSERT_GT(addresses.size(), 2u);
+  std::uintptr_t stride = addresses[1] - addresses[0];
+  EXPECT_GT(addresses[1], addresses[0]);
+  for (size_t i = 1; i < addresses.size(); ++i) {
+    ASSERT_EQ(addresses[i] - addresses[i - 1], stride) << "node " << i;
+  }
+}
+
+// Builds a list whose nodes are spread over loose nodes, slabs and reused
+// free slab nodes, in an order that has nothing to do with the list order.
+void Scramble(List<std::string>& list, std::list<std::string>& expected) {
+  std::mt19937 random(1);
+  for (int i = 0; i < 10'000; ++i) {
+    size_t choice = random() % 6;
+    std::string value = std::to_string(i);
+    if (choice == 0) {
+      list.push_front(value);
+      expected.push_front(value);
+    } else if (choice == 1) {
+      list.insert(list.end(), 5, value);
+      expected.insert(expected.end(), 5, value);
+    } else if (choice == 2 && !expected.empty()) {
+      list.pop_front();
+      expected.pop_front();
+    } else {
+      auto pos = std::next(list.begin(), static_cast<long>(expected.size() / 2));
+      list.insert(pos, value);
+      expected.insert(std::next(expected.begin(), static_cast<long>(expected.size() / 2)), value);
+    }
+  }
+}
+
+TEST(ListTest, CompactLaysNodesOutInListOrder) {
+  List<std::string> list;
+  std::list<std::string> expected;
+  Scramble(list, expected);
+  list.compact();
+  ExpectEqual(list, expected);
+  ExpectOneSlab(list.begin(), list.end());
+
+  // The compacted list is an ordinary list again.
+  for (int i = 0; i < 1000; ++i) {
+    list.pop_front();
+    expected.pop_front();
+    list.push_back(std::to_string(i));
+    expected.push_back(std::to_string(i));
+  }
+  ExpectEqual(list, expected);
+  list.compact();
+  ExpectEqual(list, expected);
+
+  List<std::string> empty;
+  empty.compact();
+  EXPECT_EQ(empty.size(), 0u);
+  EXPECT_EQ(empty.begin(), empty.end());
+}
+
+TEST(ListTest, BulkOperationsFillOneSlabInListOrder) {
+  std::vector<std::string> values;
+  for (int i = 0; i < 100; ++i) {
+    values.push_back(std::to_string(i));
+  }
+  std::list<std::string> expected_values(values.begin(), values.end());
+  List<std::string> ranged(values.begin(), values.end());
+  ExpectEqual(ranged, expected_values);
+  ExpectOneSlab(ranged.begin(), ranged.end());
+
+  List<std::string> filled(50, "x");
+  ExpectEqual(filled, std::list<std::string>(50, "x"));
+  ExpectOneSlab(filled.begin(), filled.end());
+  List<int> defaulted(50);
+  ExpectEqual(defaulted, std::list<int>(50));
+  ExpectOneSlab(defaulted.begin(), defaulted.end());
+
+  // Copies of a scrambled list take its traversal order.
+  List<std::string> scrambled;
+  std::list<std::string> expected;
+  Scramble(scrambled, expected);
+  List<std::string> copy = scrambled;
+  ExpectEqual(copy, expected);
+  ExpectOneSlab(copy.begin(), copy.end());
+  filled = scrambled;
+  ExpectEqual(filled, expected);
+  ExpectOneSlab(filled.begin(), filled.end());
+
+  filled.assign(30, "y");
+  ExpectEqual(filled, std::list<std::string>(30, "y"));
+  ExpectOneSlab(filled.begin(), filled.end());
+  filled.assign(values.begin(), values.end());
+  ExpectEqual(filled, expected_values);
+  ExpectOneSlab(filled.begin(), filled.end());
+
+  auto pos = std::next(scrambled.begin(), 1000);
+  auto inserted = scrambled.insert(pos, values.begin(), values.end());
+  expected.insert(std::next(expected.begin(), 1000), values.begin(), values.end());
+  ExpectEqual(scrambled, expected);
+  EXPECT_EQ(std::next(inserted, 100), pos);
+  ExpectOneSlab(inserted, pos);
+  inserted = scrambled.insert(pos, 20, "z");
+  expected.insert(std::next(expected.begin(), 1100), 20, "z");
+  ExpectEqual(scrambled, expected);
+  ExpectOneSlab(inserted, pos);
+  EXPECT_EQ(scrambled.insert(pos, values.begin(), values.begin()), pos);
+
+  // Single pass iterators insert node by node.
+  std::istringstream stream("1 2 3 4");
+  List<int> read{std::istream_iterator<int>(stream), std::istream_iterator<int>()};
+  ExpectEqual(read, std::list<int>{1, 2, 3, 4});
+}
+
+struct ThrowingCopy {
+  static inline int live = 0;
+  static inline int copies_left = -1;
+
+  explicit ThrowingCopy(int value) : value(value) {
+    ++live;
+  }
+  ThrowingCopy(const ThrowingCopy& other) : value(other.value) {
+    if (copies_left >= 0 && copies_left-- == 0) {
+      throw std::runtime_error("copy");
+    }
+    ++live;
+  }
+  ~ThrowingCopy() {
+    --live;
+  }
+
+  int value;
+};
+
+// A copy throwing partway through filling a slab leaves the list as it was
+// and destroys the elements already copied.
+TEST(ListTest, ThrowingCopyInSlabLeavesListUnchanged) {
+  {
+    List<ThrowingCopy> source;
+    for (int i = 0; i < 100; ++i) {
+      source.push_back(ThrowingCopy(i));
+    }
+    List<ThrowingCopy> list(3, ThrowingCopy(-1));
+    auto first = list.begin();
+    for (int copies : {0, 1, 50, 99}) {
+      ThrowingCopy::copies_left = copies;
+      EXPECT_THROW(List<ThrowingCopy>(source.begin(), source.end()), std::runtime_error);
+      ThrowingCopy::copies_left = copies;
+      EXPECT_THROW({ List<ThrowingCopy> copy(source); }, std::runtime_error);
+      ThrowingCopy::copies_left = copies;
+      EXPECT_THROW(list = source, std::runtime_error);
+      ThrowingCopy::copies_left = copies;
+      EXPECT_THROW(list.assign(100, ThrowingCopy(-2)), std::runtime_error);
+      ThrowingCopy::copies_left = copies;
+      EXPECT_THROW(list.insert(std::next(list.begin()), source.begin(), source.end()), std::runtime_error);
+      ThrowingCopy::copies_left = copies;
+      EXPECT_THROW(list.insert(list.end(), 100, ThrowingCopy(-2)), std::runtime_error);
+      ThrowingCopy::copies_left = -1;
+      ASSERT_EQ(list.size(), 3u);
+      EXPECT_EQ(list.begin(), first);
+      for (const auto& value : list) {
+        ASSERT_EQ(value.value, -1);
+      }
+      EXPECT_EQ(ThrowingCopy::live, 103);
+    }
+  }
+  EXPECT_EQ(ThrowingCopy::live, 0);
+}
+
+// Without a noexcept move compact() copies, and a throwing copy leaves the
+// list with its old nodes.
+TEST(ListTest, CompactWithThrowingCopiesLeavesListUnchanged) {
+  {
+    List<ThrowingCopy> list;
+    for (int i = 0; i < 100; ++i) {
+      list.push_back(ThrowingCopy(i));
+    }
+    auto first = list.begin();
+    for (int copies : {0, 1, 50, 99}) {
+      ThrowingCopy::copies_left = copies;
+      EXPECT_THROW(list.compact(), std::runtime_error);
+      ThrowingCopy::copies_left = -1;
+      ASSERT_EQ(list.size(), 100u);
+      EXPECT_EQ(list.begin(), first);
+      int i = 0;
+      for (const auto& value : list) {
+        ASSERT_EQ(value.value, i++);
+      }
+      EXPECT_EQ(ThrowingCopy::live, 100);
+    }
+    list.compact();
+    EXPECT_EQ(ThrowingCopy::live, 100);
+    EXPECT_EQ(list.begin()->value, 0);
+  }
+  EXPECT_EQ(ThrowingCopy::live, 0);
+}
+
+// Loose nodes change lists as they are; a node in a slab of the other list
+// stays there and its element is copied into a new node.
+TEST(ListTest, SpliceRelinksLooseNodesAndCopiesSlabNodes) {
+  {
+    List<ThrowingCopy> list;
+    List<ThrowingCopy> loose;
+    loose.push_back(ThrowingCopy(1));
+    loose.push_back(ThrowingCopy(2));
+    List<ThrowingCopy> slab(3, ThrowingCopy(3));
+    EXPECT_EQ(ThrowingCopy::live, 5);
+
+    auto it = loose.begin();
+    const ThrowingCopy* address = &*it;
+    ThrowingCopy::copies_left = 0;
+    list.splice(list.end(), loose, it);
+    ThrowingCopy::copies_left = -1;
+    EXPECT_EQ(&*list.begin(), address);
+    EXPECT_EQ(it, list.begin());
+    EXPECT_EQ(list.size(), 1u);
+    EXPECT_EQ(loose.size(), 1u);
+    EXPECT_EQ(loose.begin()->value, 2);
+
+    // A throwing copy leaves both lists as they were.
+    address = &*slab.begin();
+    ThrowingCopy::copies_left = 0;
+    EXPECT_THROW(list.splice(list.begin(), slab, slab.begin()), std::runtime_error);
+    ThrowingCopy::copies_left = -1;
+    EXPECT_EQ(list.size(), 1u);
+    EXPECT_EQ(slab.size(), 3u);
+    EXPECT_EQ(&*slab.begin(), address);
+    EXPECT_EQ(ThrowingCopy::live, 5);
+
+    list.splice(list.begin(), slab, slab.begin());
+    EXPECT_NE(&*list.begin(), address);
+    EXPECT_EQ(list.begin()->value, 3);
+    EXPECT_EQ(std::next(list.begin())->value, 1);
+    EXPECT_EQ(list.size(), 2u);
+    EXPECT_EQ(slab.size(), 2u);
+    EXPECT_EQ(ThrowingCopy::live, 5);
+
+    // Within one list slab nodes are relinked too.
+    address = &*slab.begin();
+    slab.splice(slab.end(), slab, slab.begin());
+    EXPECT_EQ(&*std::prev(slab.end()), address);
+    EXPECT_EQ(slab.size(), 2u);
+  }
+  EXPECT_EQ(ThrowingCopy::live, 0);
+}
+
+TEST(ListTest, ForEachPrefetchedVisitsElementsInOrder) {
+  List<std::string> list;
+  std::list<std::string> expected;
+  Scramble(list, expected);
+  for (size_t distance : {size_t{0}, size_t{1}, size_t{4}, expected.size() - 1, expected.size() + 10}) {
+    std::vector<std::string> visited;
+    const List<std::string>& const_list = list;
+    const_list.for_each_prefetched([&visited](const std::string& value) { visited.push_back(value); }, distance);
+    EXPECT_EQ(visited, std::vector<std::string>(expected.begin(), expected.end())) << "distance " << distance;
+  }
+
+  list.for_each_prefetched([](std::string& value) { value += "!"; });
+  for (auto& value : expected) {
+    value += "!";
+  }
+  ExpectEqual(list, expected);
+
+  List<std::string> empty;
+  empty.for_each_prefetched([](std::string&) { FAIL(); });
+}
+
+// Keys repeat, so only a stable sort keeps the indices of equal keys
+// ascending.
+TEST(ListTest, SortIsStableAndKeepsNodes) {
+  std::mt19937 random(2);
+  List<std::pair<int, int>> list;
+  std::vector<std::pair<int, int>> expected;
+  for (int i = 0; i < 5000; ++i) {
+    std::pair<int, int> value(static_cast<int>(random() % 20), i);
+    // Slabs and loose nodes alike.
+    if (i % 100 == 0) {
+      list.insert(list.end(), 50, value);
+      expected.insert(expected.end(), 50, value);
+    } else {
+      list.push_back(value);
+      expected.push_back(value);
+    }
+  }
+  std::vector<const std::pair<int, int>*> addresses;
+  for (const auto& value : list) {
+    addresses.push_back(&value);
+  }
+  auto by_key = [](const std::pair<int, int>& a, const std::pair<int, int>& b) {
+    return a.first < b.first;
+  };
+  list.sort(by_key);
+  std::stable_sort(expected.begin(), expected.end(), by_key);
+  ASSERT_EQ(list.size(), expected.size());
+  EXPECT_TRUE(std::equal(list.begin(), list.end(), expected.begin()));
+  EXPECT_TRUE(std::equal(list.rbegin(), list.rend(), expected.rbegin()));
+  // Nodes were relinked, not copied.
+  std::vector<const std::pair<int, int>*> sorted_addresses;
+  for (const auto& value : list) {
+    sorted_addresses.push_back(&value);
+  }
+  std::sort(addresses.begin(), addresses.end());
+  std::sort(sorted_addresses.begin(), sorted_addresses.end());
+  EXPECT_EQ(addresses, sorted_addresses);
+
+  List<std::string> strings;
+  std::list<std::string> expected_strings;
+  Scramble(strings, expected_strings);
+  strings.sort();
+  expected_strings.sort();
+  ExpectEqual(strings, expected_strings);
+}
+
+// A comparator throwing at any point of the sort leaves every element in
+// the list, linked both ways.
+TEST(ListTest, SortWithThrowingComparatorKeepsElements) {
+  std::mt19937 random(3);
+  std::vector<int> values;
+  for (int i = 0; i < 1000; ++i) {
+    values.push_back(static_cast<int>(random() % 1000));
+  }
+  for (int calls : {0, 1, 2, 100, 999, 5000}) {
+    List<int> list(values.begin(), values.end());
+    int calls_left = calls;
+    auto comp = [&calls_left](int a, int b) {
+      if (calls_left-- == 0) {
+        throw std::runtime_error("compare");
+      }
+      return a < b;
+    };
+    EXPECT_THROW(list.sort(comp), std::runtime_error);
+    ASSERT_EQ(list.size(), values.size());
+    std::vector<int> forward(list.begin(), list.end());
+    std::vector<int> backward(list.rbegin(), list.rend());
+    ASSERT_EQ(forward.size(), values.size());
+    EXPECT_TRUE(std::equal(forward.begin(), forward.end(), backward.rbegin()));
+    std::sort(forward.begin(), forward.end());
+    std::vector<int> expected = values;
+    std::sort(expected.begin(), expected.end());
+    EXPECT_EQ(forward, expected) << "calls " << calls;
+    list.sort();
+    EXPECT_TRUE(std::equal(list.begin(), list.end(), expected.begin()));
+  }
+}
+
+// Elements of this list come before equal ones of the other. Loose nodes
+// of the other list are relinked; those in its slabs are copied.
+TEST(ListTest, MergeIsStableAcrossLists) {
+  using Tagged = std::pair<int, char>;
+  auto by_key = [](const Tagged& a, const Tagged& b) {
+    return a.first < b.first;
+  };
+  List<Tagged> list;
+  List<Tagged> loose;
+  std::vector<Tagged> slab_values;
+  for (int i = 0; i < 300; ++i) {
+    list.push_back({i / 2, 'a'});
+    loose.push_back({i / 3, 'b'});
+    slab_values.push_back({i / 4, 'c'});
+  }
+  List<Tagged> slab(slab_values.begin(), slab_values.end());
+  std::vector<Tagged> expected(list.begin(), list.end());
+  std::vector<Tagged> merged;
+  std::merge(expected.begin(), expected.end(), loose.begin(), loose.end(), std::back_inserter(merged), by_key);
+  expected.clear();
+  std::merge(merged.begin(), merged.end(), slab_values.begin(), slab_values.end(), std::back_inserter(expected),
+             by_key);
+
+  const Tagged* loose_address = &*loose.begin();
+  const Tagged* slab_address = &*slab.begin();
+  list.merge(loose, by_key);
+  list.merge(slab, by_key);
+  EXPECT_EQ(loose.size(), 0u);
+  EXPECT_EQ(slab.size(), 0u);
+  ASSERT_EQ(list.size(), 900u);
+  EXPECT_TRUE(std::equal(list.begin(), list.end(), expected.begin()));
+  EXPECT_TRUE(std::equal(list.rbegin(), list.rend(), expected.rbegin()));
+  bool loose_kept = false;
+  bool slab_kept = false;
+  for (const auto& value : list) {
+    loose_kept = loose_kept || &value == loose_address;
+    slab_kept = slab_kept || &value == slab_address;
+  }
+  EXPECT_TRUE(loose_kept);
+  EXPECT_FALSE(slab_kept);
+  list.merge(list, by_key);
+  EXPECT_EQ(list.size(), 900u);
+}
+
+// A copy throwing while merging slab nodes leaves the elements not merged
+// yet in the other list.
+TEST(ListTest, MergeWithThrowingCopyKeepsElements) {
+  {
+    auto less = [](const ThrowingCopy& a, const ThrowingCopy& b) {
+      return a.value < b.value;
+    };
+    List<ThrowingCopy> list;
+    std::vector<ThrowingCopy> values;
+    for (int i = 0; i < 100; ++i) {
+      list.push_back(ThrowingCopy(2 * i));
+      values.push_back(ThrowingCopy(2 * i + 1));
+    }
+    List<ThrowingCopy> other(values.begin(), values.end());
+    values.clear();
+    ThrowingCopy::copies_left = 40;
+    EXPECT_THROW(list.merge(other, less), std::runtime_error);
+    ThrowingCopy::copies_left = -1;
+    EXPECT_EQ(list.size(), 140u);
+    EXPECT_EQ(other.size(), 60u);
+    EXPECT_EQ(ThrowingCopy::live, 200);
+    EXPECT_EQ(other.begin()->value, 81);
+    EXPECT_TRUE(std::is_sorted(list.begin(), list.end(), less));
+    list.merge(other, less);
+    EXPECT_EQ(list.size(), 200u);
+    int i = 0;
+    for (const auto& value : list) {
+      ASSERT_EQ(value.value, i++);
+    }
+  }
+  EXPECT_EQ(ThrowingCopy::live, 0);
+}
+
+size_t bytes_in_use = 0;
+
+template<typename T>
+struct CountingAllocator {
+  using value_type = T;
+
+  CountingAllocator() = default;
+  template<typename U>
+  CountingAllocator(const CountingAllocator<U>&) {}
+
+  T* allocate(size_t n) {
+    bytes_in_use += n * sizeof(T);
+    return std::allocator<T>().allocate(n);
+  }
+  void deallocate(T* ptr, size_t n) {
+    bytes_in_use -= n * sizeof(T);
+    std::allocator<T>().deallocate(ptr, n);
+  }
+
+  template<typename U>
+  bool operator==(const CountingAllocator<U>&) const {
+    return true;
+  }
+  template<typename U>
+  bool operator!=(const CountingAllocator<U>&) const {
+    return false;
+  }
+};
+
+// Assignment used to leak the old sentinel and to free element nodes
+// through the allocator of the sentinel; every allocation has to be
+// returned with the type and count it was made with.
+TEST(ListTest, AssignmentReturnsEveryAllocation) {
+  {
+    using CountingList = List<std::string, CountingAllocator<std::string>>;
+    CountingList list(10, "x");
+    CountingList other;
+    other.push_back("a");
+    other.push_back("b");
+    list = other;
+    list = list;
+    ExpectEqual(list, std::list<std::string>{"a", "b"});
+    list.assign(5, "y");
+    list.erase(list.begin());
+    list.push_back("z");
+    other = list;
+    CountingList copy(other);
+    copy = CountingList();
+    other.assign(list.begin(), list.end());
+    ExpectEqual(other, std::list<std::string>{"y", "y", "y", "y", "z"});
+  }
+  EXPECT_EQ(bytes_in_use, 0u);
+}
+
+}  // namespace
@@ -0,0 +1,192 @@
+#ifndef LIST__LRU_CACHE_H_
+#define LIST__LRU_CACHE_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "list.h"
+
+// Fixed capacity cache which evicts the least recently used entry. Entries
+// live in a List ordered from the most to the least recently used one; an
+// open addressing table maps keys to list iterators. The table is allocated
+// once in the constructor, and once the cache is full put reuses the node of
+// the evicted entry, so a full cache does not allocate at all. Both get and
+// put take O(1) on average.
+template<typename K, typename V, typename Allocator = std::allocator<std::pair<K, V>>,
+    typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+class LruCache {
+ public:
+  using allocator_type = Allocator;
+
+  explicit LruCache(size_t capacity, Allocator allocator = Allocator());
+  LruCache(const LruCache& other) = delete;
+  ~LruCache();
+
+  LruCache& operator=(const LruCache& other) = delete;
+
+  // Returns the cached value and marks it as the most recently used one, or
+  // nullptr if key is not cached. The pointer stays valid until the entry is
+  // evicted or erased.
+  V* get(const K& key);
+  void put(const K& key, const V& value);
+  bool erase(const K& key);
+  bool contains(const K& key) const;
+
+  size_t size() const;
+  size_t capacity() const;
+
+ private:
+  using entry_type = std::pair<K, V>;
+  using list_type = List<entry_type, typename std::allocator_traits<Allocator>::template rebind_alloc<entry_type>>;
+  using list_iterator = typename list_type::iterator;
+
+  // A slot is empty when it points at order_.end(). The hash is kept next to
+  // the iterator so that probing compares keys only on a hash match.
+  struct Bucket {
+    list_iterator entry;
+    size_t hash;
+  };
+
+  using bucket_allocator_type = typename std::allocator_traits<Allocator>::template rebind_alloc<Bucket>;
+
+  size_t Find(const K& key, size_t hash) const;
+  void InsertBucket(list_iterator entry, size_t hash);
+  void EraseBucket(size_t index);
+
+  list_type order_;
+  size_t capacity_;
+  Bucket* buckets_;
+  size_t mask_;
+  Hash hasher_;
+  KeyEqual key_equal_;
+  bucket_allocator_type bucket_allocator_;
+};
+
+template<typename K, typename V, typename Allocator, typename Hash, typename KeyEqual>
+LruCache<K, V, Allocator, Hash, KeyEqual>::LruCache(size_t capacity, Allocator allocator)
+    : order_(allocator), capacity_(capacity), bucket_allocator_(allocator) {
+  // At most half of the slots are in use, which keeps probe chains short.
+  size_t bucket_count = 2;
+  while (bucket_count < 2 * capacity) {
+    bucket_count *= 2;
+  }
+  mask_ = bucket_count - 1;
+  buckets_ = bucket_allocator_.allocate(bucket_count);
+  for (size_t i = 0; i < bucket_count; ++i) {
+    std::allocator_traits<bucket_allocator_type>::construct(bucket_allocator_, buckets_ + i,
+                                                            Bucket{order_.end(), 0});
+  }
+}
+
+template<typename K, typename V, typename Allocator, typename Hash, typename KeyEqual>
+LruCache<K, V, Allocator, Hash, KeyEqual>::~LruCache() {
+  for (size_t i = 0; i <= mask_; ++i) {
+    std::allocator_traits<bucket_allocator_type>::destroy(bucket_allocator_, buckets_ + i);
+  }
+  bucket_allocator_.deallocate(buckets_, mask_ + 1);
+}
+
+template<typename K, typename V, typename Allocator, typename Hash, typename KeyEqual>
+size_t LruCache<K, V, Allocator, Hash, KeyEqual>::Find(const K& key, size_t hash) const {
+  for (size_t i = hash & mask_;; i = (i + 1) & mask_) {
+    auto entry = buckets_[i].entry;
+    if (entry == order_.end() || (buckets_[i].hash == hash && key_equal_(entry->first, key))) {
+      return i;
+    }
+  }
+}
+
+template<typename K, typename V, typename Allocator, typename Hash, typename KeyEqual>
+void LruCache<K, V, Allocator, Hash, KeyEqual>::InsertBucket(list_iterator entry, size_t hash) {
+  size_t i = hash & mask_;
+  while (buckets_[i].entry != order_.end()) {
+    i = (i + 1) & mask_;
+  }
+  buckets_[i] = Bucket{entry, hash};
+}
+
+template<typename K, typename V, typename Allocator, typename Hash, typename KeyEqual>
+void LruCache<K, V, Allocator, Hash, KeyEqual>::EraseBucket(size_t index) {
+  // Backward shift deletion: later entries of the probe chain move into the
+  // hole unless that would put them before their home slot.
+  for (size_t i = (index + 1) & mask_; buckets_[i].entry != order_.end(); i = (i + 1) & mask_) {
+    size_t home = buckets_[i].hash & mask_;
+    bool stays = index <= i ? index < home && home <= i : index < home || home <= i;
+    if (!stays) {
+      buckets_[index] = buckets_[i];
+      index = i;
+    }
+  }
+  buckets_[index].entry = order_.end();
+}
+
+template<typename K, typename V, typename Allocator, typename Hash, typename KeyEqual>
+V* LruCache<K, V, Allocator, Hash, KeyEqual>::get(const K& key) {
+  auto entry = buckets_[Find(key, hasher_(key))].entry;
+  if (entry == order_.end()) {
+    return nullptr;
+  }
+  order_.splice(order_.begin(), order_, entry);
+  return &entry->second;
+}
+
+template<typename K, typename V, typename Allocator, typename Hash, typename KeyEqual>
+void LruCache<K, V, Allocator, Hash, KeyEqual>::put(const K& key, const V& value) {
+  if (capacity_ == 0) {
+    return;
+  }
+  size_t hash = hasher_(key);
+  auto entry = buckets_[Find(key, hash)].entry;
+  if (entry != order_.end()) {
+    entry->second = value;
+    order_.splice(order_.begin(), order_, entry);
+    return;
+  }
+  if (order_.size() < capacity_) {
+    order_.push_front(entry_type(key, value));
+    InsertBucket(order_.begin(), hash);
+    return;
+  }
+  auto victim = std::prev(order_.end());
+  EraseBucket(Find(victim->first, hasher_(victim->first)));
+  try {
+    victim->first = key;
+    victim->second = value;
+  } catch (...) {
+    order_.erase(victim);
+    throw;
+  }
+  order_.splice(order_.begin(), order_, victim);
+  InsertBucket(victim, hash);
+}
+
+template<typename K, typename V, typename Allocator, typename Hash, typename KeyEqual>
+bool LruCache<K, V, Allocator, Hash, KeyEqual>::erase(const K& key) {
+  size_t index = Find(key, hasher_(key));
+  auto entry = buckets_[index].entry;
+  if (entry == order_.end()) {
+    return false;
+  }
+  EraseBucket(index);
+  order_.erase(entry);
+  return true;
+}
+
+template<typename K, typename V, typename Allocator, typename Hash, typename KeyEqual>
+bool LruCache<K, V, Allocator, Hash, KeyEqual>::contains(const K& key) const {
+  return buckets_[Find(key, hasher_(key))].entry != order_.end();
+}
+
+template<typename K, typename V, typename Allocator, typename Hash, typename KeyEqual>
+size_t LruCache<K, V, Allocator, Hash, KeyEqual>::size() const {
+  return order_.size();
+}
+
+template<typename K, typename V, typename Allocator, typename Hash, typename KeyEqual>
+size_t LruCache<K, V, Allocator, Hash, KeyEqual>::capacity() const {
+  return capacity_;
+}
+
+#endif//LIST__LRU_CACHE_H_
@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+
+#include "lru_cache.h"
+
+namespace {
+
+// Few distinct hashes, with keys near the top of the table, so that probe
+// chains are long, run into each other and wrap around the end.
+struct ClusteringHash {
+  size_t operator()(int key) const {
+    return static_cast<size_t>(key % 5) + 13;
+  }
+};
+
+// Most to least recently used keys and their values.
+class ReferenceCache {
+ public:
+  explicit ReferenceCache(size_t capacity) : capacity_(capacity) {}
+
+  const std::string* get(int key) {
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+      return nullptr;
+    }
+    order_.splice(order_.begin(), order_, it->second);
+    return &it->second->second;
+  }
+
+  void put(int key, const std::string& value) {
+    if (get(key) != nullptr) {
+      order_.front().second = value;
+      return;
+    }
+    if (order_.size() == capacity_) {
+      index_.erase(order_.back().first);
+      order_.pop_back();
+    }
+    order_.emplace_front(key, value);
+    index_[key] = order_.begin();
+  }
+
+  bool erase(int key) {
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+      return false;
+    }
+    order_.erase(it->second);
+    index_.erase(it);
+    return true;
+  }
+
+  bool contains(int key) const {
+    return index_.count(key) != 0;
+  }
+
+  size_t size() const {
+    return order_.size();
+  }
+
+ private:
+  size_t capacity_;
+  std::list<std::pair<int, std::string>> order_;
+  std::map<int, std::list<std::pair<int, std::string>>::iterator> index_;
+};
+
+// Erases and evictions leave holes in the middle of probe chains; after every
+// step each key still cached has to stay reachable and every other key has to
+// miss.
+TEST(LruCacheTest, MatchesReferenceWithCollidingKeys) {
+  for (size_t capacity : {1, 2, 3, 8, 13}) {
+    std::mt19937 random(static_cast<unsigned>(capacity));
+    LruCache<int, std::string, std::allocator<std::pair<int, std::string>>, ClusteringHash> cache(capacity);
+    ReferenceCache expected(capacity);
+    for (int i = 0; i < 20'000; ++i) {
+      int key = static_cast<int>(random() % 40);
+      switch (random() % 4) {
+        case 0:
+        case 1:
+          cache.put(key, std::to_string(i));
+          expected.put(key, std::to_string(i));
+          break;
+        case 2: {
+          const std::string* value = expected.get(key);
+          std::string* cached = cache.get(key);
+          ASSERT_EQ(cached == nullptr, value == nullptr) << "key " << key;
+          if (value != nullptr) {
+            ASSERT_EQ(*cached, *value);
+          }
+          break;
+        }
+        default:
+          ASSERT_EQ(cache.erase(key), expected.erase(key)) << "key " << key;
+      }
+      ASSERT_EQ(cache.size(), expected.size());
+      for (int other = 0; other < 40; ++other) {
+        ASSERT_EQ(cache.contains(other), expected.contains(other)) << "key " << other << " in step " << i;
+      }
+    }
+  }
+}
+
+TEST(LruCacheTest, EvictsLeastRecentlyUsed) {
+  LruCache<int, int> cache(3);
+  cache.put(1, 10);
+  cache.put(2, 20);
+  cache.put(3, 30);
+  ASSERT_NE(cache.get(1), nullptr);
+  cache.put(4, 40);
+  EXPECT_FALSE(cache.contains(2));
+  EXPECT_EQ(*cache.get(1), 10);
+  EXPECT_EQ(*cache.get(3), 30);
+  EXPECT_EQ(*cache.get(4), 40);
+  cache.put(3, 31);
+  cache.put(5, 50);
+  EXPECT_FALSE(cache.contains(1));
+  EXPECT_EQ(*cache.get(3), 31);
+  EXPECT_EQ(cache.size(), 3u);
+
+  LruCache<int, int> empty(0);
+  empty.put(1, 10);
+  EXPECT_FALSE(empty.contains(1));
+  EXPECT_EQ(empty.size(), 0u);
+}
+
+size_t allocations = 0;
+
+template<typename T>
+struct CountingAllocator {
+  using value_type = T;
+
+  CountingAllocator() = default;
+  template<typename U>
+  CountingAllocator(const CountingAllocator<U>&) {}
+
+  T* allocate(size_t n) {
+    ++allocations;
+    return std::allocator<T>().allocate(n);
+  }
+  void deallocate(T* ptr, size_t n) {
+    std::allocator<T>().deallocate(ptr, n);
+  }
+
+  template<typename U>
+  bool operator==(const CountingAllocator<U>&) const {
+    return true;
+  }
+  template<typename U>
+  bool operator!=(const CountingAllocator<U>&) const {
+    return false;
+  }
+};
+
+TEST(LruCacheTest, FullCacheDoesNotAllocate) {
+  LruCache<int, long, CountingAllocator<std::pair<int, long>>> cache(100);
+  for (int i = 0; i < 100; ++i) {
+    cache.put(i, i);
+  }
+  size_t before = allocations;
+  for (int i = 100; i < 10'000; ++i) {
+    cache.put(i, i);
+    cache.get(i - 50);
+  }
+  EXPECT_EQ(allocations, before);
+  EXPECT_EQ(cache.size(), 100u);
+}
+
+}  // namespace
@@ -0,0 +1,310 @@
+#ifndef LIST__PARALLEL_H_
+#define LIST__PARALLEL_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "list.h"
+
+// Bulk operations on a List spread over several threads. A List can only be
+// walked node by node, so each operation first finds the boundaries of
+// equally long segments in one pass, then hands the segments to worker
+// threads shared by all calls (the calling thread takes the first one).
+// Lists too short to repay a thread are processed on fewer threads, down to
+// just the caller.
+//
+// f, transform, reduce and comp are called concurrently and must be safe
+// for that. The first exception thrown on any thread is rethrown once all
+// threads have finished.
+class ListParallel {
+ public:
+  static size_t DefaultThreads();
+
+  // Building blocks of the functions declared below.
+
+  static size_t Segments(size_t size, size_t threads);
+  // Iterators to the starts of count segments of [first, last), which holds
+  // size elements, followed by last; the first size % count segments are
+  // one element longer. The last segment is not walked.
+  template<typename Iterator>
+  static std::vector<Iterator> SplitPoints(Iterator first, Iterator last, size_t size, size_t count);
+  // Runs task(i) for every i below count, task(0) on the calling thread and
+  // the others on workers.
+  template<typename Task>
+  static void Run(size_t count, const Task& task);
+  template<typename T, typename Allocator, typename Compare>
+  static void Sort(List<T, Allocator>& list, Compare& comp, size_t threads);
+
+ private:
+  class Workers;
+
+  // Fewer nodes than this per thread are not worth starting it for.
+  static const size_t kMinSegment = size_t(1) << 14;
+};
+
+// Threads shared by every call, started as calls first need them and kept
+// until exit. Callers queue the tasks of a call, then work through the
+// queue themselves until their own tasks are done, so a task starting a
+// call of its own never waits on workers which all wait likewise.
+class ListParallel::Workers {
+ public:
+  static Workers& Get();
+
+  ~Workers();
+
+  // Queues job, counted in pending until it finished, and starts workers
+  // until there are threads of them.
+  void Submit(std::function<void()> job, size_t& pending, size_t threads);
+  // Returns once pending is down to zero.
+  void Wait(size_t& pending);
+
+ private:
+  struct Job {
+    std::function<void()> run;
+    size_t* pending;
+  };
+
+  Workers() = default;
+
+  void RunFront(std::unique_lock<std::mutex>& lock);
+  void Work();
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable finished_;
+  std::deque<Job> jobs_;
+  std::vector<std::thread> threads_;
+  bool stop_ = false;
+};
+
+// Calls f on every element of list.
+template<typename ListType, typename F>
+void ParallelForEach(ListType& list, F f, size_t threads = ListParallel::DefaultThreads());
+
+// Returns init combined by reduce with transform of every element. reduce
+// has to be associative and commutative, since segments are reduced apart.
+template<typename ListType, typename U, typename Reduce, typename Transform>
+U ParallelTransformReduce(const ListType& list, U init, Reduce reduce, Transform transform,
+                          size_t threads = ListParallel::DefaultThreads());
+
+// Stable sort of list: the segments are detached and sorted apart, then
+// merged pairwise, all by relinking nodes. Iterators stay valid. If comp
+// throws, the list keeps all of its elements in unspecified order.
+template<typename T, typename Allocator, typename Compare = std::less<>>
+void ParallelSort(List<T, Allocator>& list, Compare comp = Compare(),
+                  size_t threads = ListParallel::DefaultThreads());
+
+inline size_t ListParallel::DefaultThreads() {
+  return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+inline size_t ListParallel::Segments(size_t size, size_t threads) {
+  return std::max<size_t>(std::min(threads, size / kMinSegment), 1);
+}
+
+inline ListParallel::Workers& ListParallel::Workers::Get() {
+  static Workers workers;
+  return workers;
+}
+
+inline ListParallel::Workers::~Workers() {
+  {
+    std::lock_guard lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+inline void ListParallel::Workers::Submit(std::function<void()> job, size_t& pending, size_t threads) {
+  std::lock_guard lock(mutex_);
+  jobs_.push_back({std::move(job), &pending});
+  ++pending;
+  while (threads_.size() < threads) {
+    try {
+      threads_.emplace_back([this] { Work(); });
+    } catch (...) {
+      // Out of threads, or memory for them: the job is queued already, and
+      // the callers work through the queue themselves.
+      break;
+    }
+  }
+  wake_.notify_one();
+}
+
+inline void ListParallel::Workers::Wait(size_t& pending) {
+  std::unique_lock lock(mutex_);
+  while (pending != 0) {
+    if (!jobs_.empty()) {
+      RunFront(lock);
+    } else {
+      finished_.wait(lock);
+    }
+  }
+}
+
+// Runs the first queued job with the lock released. Jobs do not throw.
+inline void ListParallel::Workers::RunFront(std::unique_lock<std::mutex>& lock) {
+  Job job = std::move(jobs_.front());
+  jobs_.pop_front();
+  lock.unlock();
+  job.run();
+  lock.lock();
+  if (--*job.pending == 0) {
+    finished_.notify_all();
+  }
+}
+
+inline void ListParallel::Workers::Work() {
+  std::unique_lock lock(mutex_);
+  while (true) {
+    wake_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+    if (jobs_.empty()) {
+      return;
+    }
+    RunFront(lock);
+  }
+}
+
+template<typename Iterator>
+std::vector<Iterator> ListParallel::SplitPoints(Iterator first, Iterator last, size_t size, size_t count) {
+  std::vector<Iterator> points;
+  points.reserve(count + 1);
+  points.push_back(first);
+  for (size_t i = 0; i + 1 < count; ++i) {
+    size_t length = size / count + (i < size % count ? 1 : 0);
+    for (size_t j = 0; j < length; ++j) {
+      ++first;
+    }
+    points.push_back(first);
+  }
+  points.push_back(last);
+  return points;
+}
+
+template<typename Task>
+void ListParallel::Run(size_t count, const Task& task) {
+  std::vector<std::exception_ptr> errors(count);
+  auto run = [&task, &errors](size_t i) {
+    try {
+      task(i);
+    } catch (...) {
+      errors[i] = std::current_exception();
+    }
+  };
+  Workers& workers = Workers::Get();
+  size_t pending = 0;
+  for (size_t i = 1; i < count; ++i) {
+    try {
+      workers.Submit([&run, i] { run(i); }, pending, count - 1);
+    } catch (...) {
+      // Out of memory for the job: the caller does the work itself.
+      run(i);
+    }
+  }
+  run(0);
+  workers.Wait(pending);
+  for (auto& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+template<typename T, typename Allocator, typename Compare>
+void ListParallel::Sort(List<T, Allocator>& list, Compare& comp, size_t threads) {
+  using Chain = typename List<T, Allocator>::Chain;
+  size_t count = Segments(list.size_, threads);
+  if (count == 1) {
+    list.sort(comp);
+    return;
+  }
+  auto chain = list.DetachNodes();
+  std::vector<Chain> parts(count);
+  for (size_t i = 0; i + 1 < count; ++i) {
+    size_t length = list.size_ / count + (i < list.size_ % count ? 1 : 0);
+    parts[i].head = parts[i].tail = chain.head;
+    for (size_t j = 1; j < length; ++j) {
+      parts[i].tail = parts[i].tail->next;
+    }
+    chain.head = parts[i].tail->next;
+    parts[i].tail->next = nullptr;
+  }
+  parts[count - 1] = chain;
+  try {
+    Run(count, [&parts, &comp](size_t i) {
+      Compare local = comp;
+      List<T, Allocator>::SortChain(parts[i], local);
+    });
+    // Neighbouring runs merge in rounds, the earlier run winning ties.
+    for (size_t width = 1; width < count; width *= 2) {
+      Run((count - width + 2 * width - 1) / (2 * width), [&parts, &comp, width](size_t i) {
+        Compare local = comp;
+        List<T, Allocator>::MergeChains(parts[2 * width * i], parts[2 * width * i + width], local);
+      });
+    }
+  } catch (...) {
+    for (size_t i = 1; i < count; ++i) {
+      List<T, Allocator>::AppendChain(parts[0], parts[i]);
+    }
+    list.AttachNodes(parts[0]);
+    throw;
+  }
+  list.AttachNodes(parts[0]);
+}
+
+template<typename ListType, typename F>
+void ParallelForEach(ListType& list, F f, size_t threads) {
+  size_t count = ListParallel::Segments(list.size(), threads);
+  auto points = ListParallel::SplitPoints(list.begin(), list.end(), list.size(), count);
+  ListParallel::Run(count, [&points, &f](size_t i) {
+    for (auto it = points[i]; it != points[i + 1]; ++it) {
+      f(*it);
+    }
+  });
+}
+
+template<typename ListType, typename U, typename Reduce, typename Transform>
+U ParallelTransformReduce(const ListType& list, U init, Reduce reduce, Transform transform, size_t threads) {
+  size_t count = ListParallel::Segments(list.size(), threads);
+  auto points = ListParallel::SplitPoints(list.begin(), list.end(), list.size(), count);
+  // Every segment starts from its first element, so reduce needs no
+  // identity; an empty list has one empty segment.
+  std::vector<std::optional<U>> partial(count);
+  ListParallel::Run(count, [&](size_t i) {
+    auto it = points[i];
+    if (it == points[i + 1]) {
+      return;
+    }
+    U value = transform(*it);
+    for (++it; it != points[i + 1]; ++it) {
+      value = reduce(std::move(value), transform(*it));
+    }
+    partial[i].emplace(std::move(value));
+  });
+  for (auto& value : partial) {
+    if (value) {
+      init = reduce(std::move(init), std::move(*value));
+    }
+  }
+  return init;
+}
+
+template<typename T, typename Allocator, typename Compare>
+void ParallelSort(List<T, Allocator>& list, Compare comp, size_t threads) {
+  ListParallel::Sort(list, comp, threads);
+}
+
+#endif//LIST__PARALLEL_H_
@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "list.h"
+#include "parallel.h"
+
+namespace {
+
+// Enough elements for every one of kThreads segments to get a worker.
+constexpr size_t kThreads = 4;
+constexpr long kSize = 100'000;
+// The most threads any call asks for.
+constexpr size_t kMostThreads = kThreads + 3;
+
+List<long> MakeList(long size, unsigned seed) {
+  std::mt19937 random(seed);
+  List<long> list;
+  for (long i = 0; i < size; ++i) {
+    list.push_back(static_cast<long>(random() % 1000));
+  }
+  return list;
+}
+
+TEST(ParallelTest, ForEachVisitsEveryElementOnce) {
+  List<long> list;
+  for (long i = 0; i < kSize; ++i) {
+    list.push_back(i);
+  }
+  ParallelForEach(list, [](long& value) { value *= 2; }, kThreads);
+  long expected = 0;
+  for (long value : list) {
+    ASSERT_EQ(value, expected);
+    expected += 2;
+  }
+}
+
+TEST(ParallelTest, TransformReduceMatchesSequential) {
+  List<long> list = MakeList(kSize, 1);
+  long expected = 7;
+  for (long value : list) {
+    expected += value * value;
+  }
+  auto square = [](long value) { return value * value; };
+  EXPECT_EQ(ParallelTransformReduce(list, 7l, std::plus<>(), square, kThreads), expected);
+  EXPECT_EQ(ParallelTransformReduce(List<long>(), 7l, std::plus<>(), square, kThreads), 7);
+}
+
+TEST(ParallelTest, SortIsStable) {
+  std::mt19937 random(2);
+  List<std::pair<int, long>> list;
+  for (long i = 0; i < 3 * kSize; ++i) {
+    list.push_back({static_cast<int>(random() % 100), i});
+  }
+  auto by_key = [](const auto& a, const auto& b) { return a.first < b.first; };
+  ParallelSort(list, by_key, kMostThreads);
+  ASSERT_EQ(list.size(), static_cast<size_t>(3 * kSize));
+  auto previous = *list.begin();
+  for (const auto& value : list) {
+    ASSERT_TRUE(previous.first < value.first || (previous.first == value.first && previous.second <= value.second));
+    previous = value;
+  }
+}
+
+TEST(ParallelTest, ExceptionsReachTheCallerAndSortKeepsElements) {
+  List<long> list = MakeList(kSize, 3);
+  std::atomic<int> calls{0};
+  auto throwing = [&calls](long a, long b) {
+    if (++calls == 50'000) {
+      throw std::runtime_error("comp");
+    }
+    return a < b;
+  };
+  EXPECT_THROW(ParallelSort(list, throwing, kThreads), std::runtime_error);
+  EXPECT_EQ(list.size(), static_cast<size_t>(kSize));
+  EXPECT_THROW(ParallelForEach(list, [](long value) {
+    if (value == 999) {
+      throw std::runtime_error("f");
+    }
+  }, kThreads), std::runtime_error);
+}
+
+// Calls made from within a task wait for their own tasks while every worker
+// may be waiting too, which must not deadlock.
+TEST(ParallelTest, NestedCallsFinish) {
+  std::vector<List<long>> lists;
+  for (unsigned i = 0; i < kThreads; ++i) {
+    lists.push_back(MakeList(kSize, i));
+  }
+  // One segment per list, each starting a call of its own on its first
+  // element.
+  List<long> indices;
+  for (long i = 0; i < static_cast<long>(kThreads) * kSize; ++i) {
+    indices.push_back(i);
+  }
+  std::atomic<long> total{0};
+  ParallelForEach(indices, [&](long i) {
+    if (i % kSize == 0) {
+      total += ParallelTransformReduce(lists[i / kSize], 0l, std::plus<>(), [](long value) { return value; },
+                                       kThreads);
+    }
+  }, kThreads);
+  long expected = 0;
+  for (const auto& list : lists) {
+    for (long value : list) {
+      expected += value;
+    }
+  }
+  EXPECT_EQ(total, expected);
+}
+
+std::atomic<size_t> threads_seen{0};
+
+// Counts the threads that ever ran a task.
+struct ThreadMarker {
+  ThreadMarker() {
+    ++threads_seen;
+  }
+};
+
+TEST(ParallelTest, CallsReuseWorkerThreads) {
+  List<long> list = MakeList(kSize, 4);
+  for (int call = 0; call < 50; ++call) {
+    ParallelForEach(list, [](long) {
+      thread_local ThreadMarker marker;
+    }, kThreads);
+  }
+  EXPECT_LE(threads_seen, kMostThreads);
+}
+
+}  // namespace
@@ -0,0 +1,245 @@
+#ifndef LIST__POOL_ALLOCATOR_H_
+#define LIST__POOL_ALLOCATOR_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+// Thread-safe pool of small fixed-size blocks, behind PoolAllocator.
+//
+// Every thread owns a heap with one free list per size class, refilled from
+// superblocks the heap carves up. A superblock is aligned to its size and
+// starts with a header naming its owning heap, so a free finds the owner by
+// masking the address. Frees on the owning thread go to the local free list
+// without any synchronization. Frees from other threads are pushed onto a
+// lock-free stack of the owner, which the owner takes over as a whole when
+// its local list runs dry; with a single consumer taking everything at once
+// the stack has no ABA problem.
+//
+// When a thread exits its heap is orphaned rather than destroyed, since
+// blocks it owns may still be freed elsewhere; the next new thread adopts
+// it along with its free blocks. A thread allocating once its heap is
+// orphaned, from the destructor of another thread_local object, takes its
+// blocks from an orphaned heap under the orphans lock and frees them as
+// remote frees. Memory is kept for reuse and never given back to the
+// system.
+class NodePool {
+ public:
+  static const size_t kBlockAlignment = 16;
+  static const size_t kMaxBlock = 256;
+
+  static void* Allocate(size_t bytes);
+  static void Deallocate(void* block, size_t bytes);
+
+ private:
+  static const size_t kSuperblockSize = size_t(1) << 16;
+  static const size_t kClasses = kMaxBlock / kBlockAlignment;
+
+  struct FreeBlock {
+    FreeBlock* next;
+  };
+
+  struct SizeClass {
+    FreeBlock* free = nullptr;
+    char* cursor = nullptr;
+    char* limit = nullptr;
+    std::atomic<FreeBlock*> remote{nullptr};
+  };
+
+  struct Heap {
+    SizeClass classes[kClasses];
+    Heap* next_orphan = nullptr;
+  };
+
+  struct alignas(64) Superblock {
+    Heap* owner;
+  };
+
+  // Orphans the heap of the thread when the thread exits.
+  struct Releaser {
+    ~Releaser();
+  };
+
+  static size_t ClassOf(size_t bytes);
+  static Heap*& CurrentHeap();
+  static bool& HeapGone();
+  static Heap* LocalHeap();
+  static Heap* AdoptHeap();
+  static void Refill(Heap* heap, size_t index);
+  static void* Take(Heap* heap, size_t index);
+
+  static inline std::mutex orphans_mutex_;
+  static inline Heap* orphans_ = nullptr;
+};
+
+// Allocator for List and other node-based containers drawing single
+// objects of up to NodePool::kMaxBlock bytes from NodePool. Arrays, larger
+// and over-aligned objects go to operator new. All PoolAllocators compare
+// equal, and memory allocated on one thread may be freed on any other.
+template<typename T>
+class PoolAllocator {
+ public:
+  using value_type = T;
+
+  PoolAllocator() = default;
+  template<typename U>
+  PoolAllocator(const PoolAllocator<U>& other);
+
+  T* allocate(size_t n);
+  void deallocate(T* p, size_t n);
+
+  template<typename U>
+  bool operator==(const PoolAllocator<U>& other) const;
+  template<typename U>
+  bool operator!=(const PoolAllocator<U>& other) const;
+
+ private:
+  static const bool kPooled = sizeof(T) <= NodePool::kMaxBlock && alignof(T) <= NodePool::kBlockAlignment;
+};
+
+inline size_t NodePool::ClassOf(size_t bytes) {
+  return (bytes + kBlockAlignment - 1) / kBlockAlignment - 1;
+}
+
+inline NodePool::Heap*& NodePool::CurrentHeap() {
+  // Trivially destructible, so it stays usable while other thread_local
+  // objects are destroyed, and after the Releaser has run.
+  thread_local Heap* heap = nullptr;
+  return heap;
+}
+
+inline bool& NodePool::HeapGone() {
+  thread_local bool gone = false;
+  return gone;
+}
+
+inline NodePool::Releaser::~Releaser() {
+  Heap* heap = CurrentHeap();
+  CurrentHeap() = nullptr;
+  HeapGone() = true;
+  std::lock_guard lock(orphans_mutex_);
+  heap->next_orphan = orphans_;
+  orphans_ = heap;
+}
+
+// The heap of the thread, or nullptr once the thread orphaned it: adopting
+// another one then would keep it from ever being orphaned again.
+inline NodePool::Heap* NodePool::LocalHeap() {
+  Heap*& heap = CurrentHeap();
+  if (heap == nullptr && !HeapGone()) {
+    heap = AdoptHeap();
+    thread_local Releaser releaser;
+  }
+  return heap;
+}
+
+inline NodePool::Heap* NodePool::AdoptHeap() {
+  {
+    std::lock_guard lock(orphans_mutex_);
+    if (orphans_ != nullptr) {
+      Heap* heap = orphans_;
+      orphans_ = heap->next_orphan;
+      return heap;
+    }
+  }
+  return new Heap;
+}
+
+// Takes over the blocks freed by other threads, or carves new ones.
+inline void NodePool::Refill(Heap* heap, size_t index) {
+  SizeClass& size_class = heap->classes[index];
+  if (size_class.remote.load(std::memory_order_relaxed) != nullptr) {
+    size_class.free = size_class.remote.exchange(nullptr, std::memory_order_acquire);
+    return;
+  }
+  size_t size = (index + 1) * kBlockAlignment;
+  if (size_class.cursor == nullptr || size_t(size_class.limit - size_class.cursor) < size) {
+    auto superblock = static_cast<Superblock*>(operator new(kSuperblockSize, std::align_val_t(kSuperblockSize)));
+    superblock->owner = heap;
+    size_class.cursor = reinterpret_cast<char*>(superblock + 1);
+    size_class.limit = reinterpret_cast<char*>(superblock) + kSuperblockSize;
+  }
+  auto block = reinterpret_cast<FreeBlock*>(size_class.cursor);
+  block->next = nullptr;
+  size_class.free = block;
+  size_class.cursor += size;
+}
+
+inline void* NodePool::Take(Heap* heap, size_t index) {
+  SizeClass& size_class = heap->classes[index];
+  if (size_class.free == nullptr) {
+    Refill(heap, index);
+  }
+  FreeBlock* block = size_class.free;
+  size_class.free = block->next;
+  return block;
+}
+
+inline void* NodePool::Allocate(size_t bytes) {
+  size_t index = ClassOf(bytes);
+  if (Heap* heap = LocalHeap()) {
+    return Take(heap, index);
+  }
+  // No thread owns an orphaned heap, so the lock keeps its local lists to
+  // this one while it allocates.
+  std::lock_guard lock(orphans_mutex_);
+  if (orphans_ == nullptr) {
+    orphans_ = new Heap;
+  }
+  return Take(orphans_, index);
+}
+
+inline void NodePool::Deallocate(void* block, size_t bytes) {
+  size_t index = ClassOf(bytes);
+  auto superblock = reinterpret_cast<Superblock*>(reinterpret_cast<uintptr_t>(block) & ~(kSuperblockSize - 1));
+  Heap* owner = superblock->owner;
+  auto freed = static_cast<FreeBlock*>(block);
+  SizeClass& size_class = owner->classes[index];
+  if (owner == LocalHeap()) {
+    freed->next = size_class.free;
+    size_class.free = freed;
+    return;
+  }
+  FreeBlock* head = size_class.remote.load(std::memory_order_relaxed);
+  do {
+    freed->next = head;
+  } while (!size_class.remote.compare_exchange_weak(head, freed, std::memory_order_release,
+                                                    std::memory_order_relaxed));
+}
+
+template<typename T>
+template<typename U>
+PoolAllocator<T>::PoolAllocator([[maybe_unused]]const PoolAllocator<U>& other) {}
+
+template<typename T>
+T* PoolAllocator<T>::allocate(size_t n) {
+  if (kPooled && n == 1) {
+    return static_cast<T*>(NodePool::Allocate(sizeof(T)));
+  }
+  return static_cast<T*>(operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+}
+
+template<typename T>
+void PoolAllocator<T>::deallocate(T* p, size_t n) {
+  if (kPooled && n == 1) {
+    NodePool::Deallocate(p, sizeof(T));
+    return;
+  }
+  operator delete(p, n * sizeof(T), std::align_val_t(alignof(T)));
+}
+
+template<typename T>
+template<typename U>
+bool PoolAllocator<T>::operator==([[maybe_unused]]const PoolAllocator<U>& other) const {
+  return true;
+}
+
+template<typename T>
+template<typename U>
+bool PoolAllocator<T>::operator!=([[maybe_unused]]const PoolAllocator<U>& other) const {
+  return false;
+}
+
+#endif//LIST__POOL_ALLOCATOR_H_
@@ -0,0 +1,101 @@
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+
+#include "list.h"
+#include "pool_allocator.h"
+
+namespace {
+
+template<typename Allocator>
+void BM_ListPushPop(benchmark::State& state) {
+  List<long, Allocator> list;
+  for (auto _ : state) {
+    for (long i = 0; i < state.range(0); ++i) {
+      list.push_back(i);
+    }
+    for (long i = 0; i < state.range(0); ++i) {
+      list.pop_front();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK_TEMPLATE(BM_ListPushPop, std::allocator<long>)->Arg(1000)->Arg(100'000);
+BENCHMARK_TEMPLATE(BM_ListPushPop, PoolAllocator<long>)->Arg(1000)->Arg(100'000);
+
+struct Payload {
+  long values[6];
+};
+
+// Blocks handed from the producer to the consumer, one slot each.
+class Ring {
+ public:
+  bool push(Payload* payload) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == kSize) {
+      return false;
+    }
+    slots_[tail % kSize] = payload;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  Payload* pop() {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    Payload* payload = slots_[head % kSize];
+    head_.store(head + 1, std::memory_order_release);
+    return payload;
+  }
+
+ private:
+  static const size_t kSize = 4096;
+
+  Payload* slots_[kSize];
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+};
+
+// A producer thread allocates every block and the benchmark thread frees
+// it, the producer/consumer churn which has every free cross threads.
+template<typename Allocator>
+void BM_CrossThreadChurn(benchmark::State& state) {
+  const long kBlocks = 100'000;
+  Allocator allocator;
+  auto ring = std::make_unique<Ring>();
+  for (auto _ : state) {
+    std::thread producer([&allocator, &ring, kBlocks] {
+      for (long i = 0; i < kBlocks; ++i) {
+        Payload* payload = allocator.allocate(1);
+        payload->values[0] = i;
+        while (!ring->push(payload)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+    for (long i = 0; i < kBlocks;) {
+      if (Payload* payload = ring->pop()) {
+        benchmark::DoNotOptimize(payload->values[0]);
+        allocator.deallocate(payload, 1);
+        ++i;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+    producer.join();
+  }
+  state.SetItemsProcessed(state.iterations() * kBlocks);
+}
+
+BENCHMARK_TEMPLATE(BM_CrossThreadChurn, std::allocator<Payload>)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_CrossThreadChurn, PoolAllocator<Payload>)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "list.h"
+#include "pool_allocator.h"
+
+namespace {
+
+// Superblocks are the only aligned allocations of NodePool.
+std::atomic<long> aligned_allocations{0};
+
+}  // namespace
+
+void* operator new(size_t bytes, std::align_val_t alignment) {
+  ++aligned_allocations;
+  size_t align = static_cast<size_t>(alignment);
+  void* ptr = std::aligned_alloc(align, (bytes + align - 1) / align * align);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+
+namespace {
+
+struct Payload {
+  long values[6];
+};
+
+TEST(PoolAllocatorTest, ListUsesPool) {
+  List<long, PoolAllocator<long>> list;
+  for (long i = 0; i < 100'000; ++i) {
+    list.push_back(i);
+  }
+  for (long i = 0; i < 50'000; ++i) {
+    list.pop_front();
+  }
+  long expected = 50'000;
+  for (long value : list) {
+    ASSERT_EQ(value, expected++);
+  }
+}
+
+// A producer allocates and a consumer frees, so every block goes through
+// the remote free stack of the producer's heap and comes back from it.
+TEST(PoolAllocatorTest, CrossThreadFreesAreReused) {
+  PoolAllocator<Payload> allocator;
+  std::mutex mutex;
+  std::vector<Payload*> handed_over;
+  std::atomic<bool> done{false};
+  long before = aligned_allocations;
+  std::thread consumer([&] {
+    while (true) {
+      std::vector<Payload*> batch;
+      {
+        std::lock_guard lock(mutex);
+        batch.swap(handed_over);
+      }
+      for (Payload* payload : batch) {
+        for (long value : payload->values) {
+          ASSERT_EQ(value, payload->values[0]);
+        }
+        allocator.deallocate(payload, 1);
+      }
+      if (batch.empty()) {
+        if (done) {
+          break;
+        }
+        std::this_thread::yield();
+      }
+    }
+  });
+  for (long i = 0; i < 1'000'000; ++i) {
+    Payload* payload = allocator.allocate(1);
+    for (long& value : payload->values) {
+      value = i;
+    }
+    std::unique_lock lock(mutex);
+    handed_over.push_back(payload);
+    // Keeps the blocks in flight to a few superblocks.
+    while (handed_over.size() > 10'000) {
+      lock.unlock();
+      std::this_thread::yield();
+      lock.lock();
+    }
+  }
+  done = true;
+  consumer.join();
+  // 48 MB went through, and the 20000 blocks in flight at most take 15
+  // superblocks.
+  EXPECT_LT(aligned_allocations - before, 30);
+}
+
+// Allocates and frees from its destructor, which runs after the Releaser
+// of the thread once the thread used the pool after constructing it.
+struct LateUser {
+  ~LateUser() {
+    PoolAllocator<Payload> allocator;
+    std::vector<Payload*> payloads;
+    for (int i = 0; i < 100; ++i) {
+      payloads.push_back(allocator.allocate(1));
+    }
+    for (Payload* payload : payloads) {
+      allocator.deallocate(payload, 1);
+    }
+  }
+};
+
+TEST(PoolAllocatorTest, AllocationsAfterThreadExitReuseOrphanedHeaps) {
+  long before = aligned_allocations;
+  for (int t = 0; t < 200; ++t) {
+    std::thread([] {
+      thread_local LateUser late_user;
+      PoolAllocator<Payload> allocator;
+      allocator.deallocate(allocator.allocate(1), 1);
+    }).join();
+  }
+  // A heap kept by every exiting thread would take a superblock each.
+  EXPECT_LT(aligned_allocations - before, 10);
+}
+
+}  // namespace
@@ -0,0 +1,629 @@
+#ifndef LIST__UNORDERED_MAP_H_
+#define LIST__UNORDERED_MAP_H_
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "list.h"
+
+// Hash map whose entries all live in one List, so nodes come from the same
+// allocator, StackAllocator or PoolAllocator included, and have the same
+// layout as in the other list based containers. Iteration walks the list.
+//
+// As in libstdc++, the entries of a bucket are adjacent in the list and the
+// bucket array holds an iterator to the first of them, or end() for an empty
+// bucket. A new entry goes in front of its bucket, or to the front of the
+// list if the bucket is empty; both keep every bucket contiguous. Entries
+// keep their hash, so that buckets are told apart without hashing again.
+//
+// The bucket count is a power of two and doubles once there are as many
+// entries as buckets. Growing does not move all entries at once: the old
+// bucket array stays in use, and every insertion carries a few of its
+// buckets over to the new one by splicing their entries into their new
+// buckets. Until a bucket is carried over, its keys are looked up in the old
+// array. Iterators and references stay valid throughout, but insertions may
+// change the order of iteration; erasures never do.
+template<typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>,
+    typename Allocator = std::allocator<std::pair<const K, V>>>
+class UnorderedMap {
+ private:
+  struct Entry;
+  using list_type = List<Entry, typename std::allocator_traits<Allocator>::template rebind_alloc<Entry>>;
+  using list_iterator = typename list_type::iterator;
+
+  template<bool is_const>
+  class CommonIterator;
+
+ public:
+  using key_type = K;
+  using mapped_type = V;
+  using value_type = std::pair<const K, V>;
+  using hasher = Hash;
+  using key_equal = KeyEqual;
+  using allocator_type = Allocator;
+  using iterator = CommonIterator<false>;
+  using const_iterator = CommonIterator<true>;
+
+  UnorderedMap();
+  explicit UnorderedMap(Allocator allocator);
+  explicit UnorderedMap(size_t bucket_count, Hash hash = Hash(), KeyEqual key_equal = KeyEqual(),
+                        Allocator allocator = Allocator());
+  UnorderedMap(const UnorderedMap& other);
+  ~UnorderedMap();
+
+  UnorderedMap& operator=(const UnorderedMap& other);
+
+  iterator begin();
+  const_iterator begin() const;
+  const_iterator cbegin() const;
+  iterator end();
+  const_iterator end() const;
+  const_iterator cend() const;
+
+  size_t size() const;
+  bool empty() const;
+
+  iterator find(const K& key);
+  const_iterator find(const K& key) const;
+  bool contains(const K& key) const;
+  size_t count(const K& key) const;
+  V& at(const K& key);
+  const V& at(const K& key) const;
+  V& operator[](const K& key);
+
+  std::pair<iterator, bool> insert(const value_type& value);
+  std::pair<iterator, bool> insert(value_type&& value);
+  template<typename... Args>
+  std::pair<iterator, bool> emplace(Args&&... args);
+  // Constructs the value from args only if key is not in the map yet.
+  template<typename... Args>
+  std::pair<iterator, bool> try_emplace(const K& key, Args&&... args);
+  iterator erase(const_iterator pos);
+  size_t erase(const K& key);
+  void clear();
+
+  // Makes room for count entries without growing again. Unlike the growth
+  // on insertion, this moves all entries to their new buckets at once.
+  void reserve(size_t count);
+  size_t bucket_count() const;
+  float load_factor() const;
+
+  allocator_type get_allocator() const;
+  hasher hash_function() const;
+  key_equal key_eq() const;
+
+ private:
+  using bucket_allocator_type = typename std::allocator_traits<Allocator>::template rebind_alloc<list_iterator>;
+
+  static const size_t kMinBuckets = 8;
+  // Old buckets carried over per insertion. Growing starts with as many
+  // entries as old buckets, and the next growth needs as many insertions
+  // again, so the old array is always gone by then.
+  static const size_t kRehashStep = 4;
+
+  bool Migrated(size_t hash) const;
+  list_iterator& Bucket(size_t hash);
+  bool SameBucket(size_t hash, size_t other_hash) const;
+  list_iterator Find(const K& key, size_t hash);
+  template<typename... Args>
+  list_iterator Insert(size_t hash, Args&&... args);
+  list_iterator Erase(list_iterator pos);
+  list_iterator* AllocateBuckets(size_t count);
+  void DeallocateBuckets(list_iterator* buckets, size_t count);
+  void StartRehash(size_t count);
+  void Migrate(size_t count);
+  void FinishRehash();
+
+  list_type entries_;
+  Hash hasher_;
+  KeyEqual key_equal_;
+  bucket_allocator_type bucket_allocator_;
+  // Both arrays are empty until the first insertion.
+  list_iterator* buckets_ = nullptr;
+  size_t mask_ = 0;
+  // Array being carried over while growing, whose buckets before migrated_
+  // are empty and looked up in buckets_ instead.
+  list_iterator* old_buckets_ = nullptr;
+  size_t old_mask_ = 0;
+  size_t migrated_ = 0;
+};
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+struct UnorderedMap<K, V, Hash, KeyEqual, Allocator>::Entry {
+  template<typename... Args>
+  explicit Entry(size_t hash, Args&&... args) : value(std::forward<Args>(args)...), hash(hash) {}
+
+  value_type value;
+  size_t hash;
+};
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+template<bool is_const>
+class UnorderedMap<K, V, Hash, KeyEqual, Allocator>::CommonIterator {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = std::pair<const K, V>;
+  using difference_type = ssize_t;
+  using pointer = typename std::conditional<is_const, const value_type*, value_type*>::type;
+  using reference = typename std::conditional<is_const, const value_type&, value_type&>::type;
+
+  CommonIterator();
+  CommonIterator(const CommonIterator<false>& other);
+
+  CommonIterator<is_const>& operator++();
+  CommonIterator<is_const> operator++(int);
+
+  bool operator==(const CommonIterator<true>& other) const;
+  bool operator!=(const CommonIterator<true>& other) const;
+
+  reference operator*();
+  pointer operator->();
+
+  friend class CommonIterator<!is_const>;
+  friend class UnorderedMap;
+
+ private:
+  using base_iterator = typename std::conditional<is_const, typename list_type::const_iterator, list_iterator>::type;
+
+  explicit CommonIterator(base_iterator it);
+
+  base_iterator it_;
+};
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+template<bool is_const>
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::CommonIterator<is_const>::CommonIterator() = default;
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+template<bool is_const>
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::CommonIterator<is_const>::CommonIterator(base_iterator it) : it_(it) {}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+template<bool is_const>
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::CommonIterator<is_const>::CommonIterator(
+    const CommonIterator<false>& other) : it_(other.it_) {}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+template<bool is_const>
+typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::template CommonIterator<is_const>&
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::CommonIterator<is_const>::operator++() {
+  ++it_;
+  return *this;
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+template<bool is_const>
+typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::template CommonIterator<is_const>
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::CommonIterator<is_const>::operator++(int) {
+  CommonIterator<is_const> tmp = *this;
+  ++it_;
+  return tmp;
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+template<bool is_const>
+bool UnorderedMap<K, V, Hash, KeyEqual, Allocator>::CommonIterator<is_const>::operator==(
+    const CommonIterator<true>& other) const {
+  return it_ == other.it_;
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+template<bool is_const>
+bool UnorderedMap<K, V, Hash, KeyEqual, Allocator>::CommonIterator<is_const>::operator!=(
+    const CommonIterator<true>& other) const {
+  return it_ != other.it_;
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+template<bool is_const>
+typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::template CommonIterator<is_const>::reference
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::CommonIterator<is_const>::operator*() {
+  return it_->value;
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+template<bool is_const>
+typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::template CommonIterator<is_const>::pointer
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::CommonIterator<is_const>::operator->() {
+  return &it_->value;
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::UnorderedMap() : UnorderedMap(Allocator()) {}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::UnorderedMap(Allocator allocator)
+    : entries_(allocator), bucket_allocator_(allocator) {}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::UnorderedMap(size_t bucket_count, Hash hash, KeyEqual key_equal,
+                                                            Allocator allocator)
+    : entries_(allocator), hasher_(hash), key_equal_(key_equal), bucket_allocator_(allocator) {
+  reserve(bucket_count);
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::UnorderedMap(const UnorderedMap& other)
+    : entries_(std::allocator_traits<Allocator>::select_on_container_copy_construction(other.get_allocator())),
+      hasher_(other.hasher_), key_equal_(other.key_equal_), bucket_allocator_(entries_.get_allocator()) {
+  reserve(other.size());
+  // Keys are known to be distinct and their hashes are kept.
+  for (auto it = other.entries_.begin(); it != other.entries_.end(); ++it) {
+    Insert(it->hash, it->value);
+  }
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::~UnorderedMap() {
+  DeallocateBuckets(buckets_, mask_ + 1);
+  DeallocateBuckets(old_buckets_, old_mask_ + 1);
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>& UnorderedMap<K, V, Hash, KeyEqual, Allocator>::operator=(
+    const UnorderedMap& other) {
+  if (this == &other) {
+    return *this;
+  }
+  clear();
+  hasher_ = other.hasher_;
+  key_equal_ = other.key_equal_;
+  reserve(other.size());
+  for (auto it = other.entries_.begin(); it != other.entries_.end(); ++it) {
+    Insert(it->hash, it->value);
+  }
+  return *this;
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::iterator UnorderedMap<K, V, Hash, KeyEqual, Allocator>::begin() {
+  return iterator(entries_.begin());
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::const_iterator
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::begin() const {
+  return const_iterator(entries_.begin());
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::const_iterator
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::cbegin() const {
+  return const_iterator(entries_.begin());
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::iterator UnorderedMap<K, V, Hash, KeyEqual, Allocator>::end() {
+  return iterator(entries_.end());
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::const_iterator
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::end() const {
+  return const_iterator(entries_.end());
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::const_iterator
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::cend() const {
+  return const_iterator(entries_.end());
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+size_t UnorderedMap<K, V, Hash, KeyEqual, Allocator>::size() const {
+  return entries_.size();
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+bool UnorderedMap<K, V, Hash, KeyEqual, Allocator>::empty() const {
+  return entries_.size() == 0;
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::iterator
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::find(const K& key) {
+  return iterator(Find(key, hasher_(key)));
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::const_iterator
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::find(const K& key) const {
+  // Find changes nothing, but hands out iterators which could.
+  return const_iterator(const_cast<UnorderedMap*>(this)->Find(key, hasher_(key)));
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+bool UnorderedMap<K, V, Hash, KeyEqual, Allocator>::contains(const K& key) const {
+  return find(key) != end();
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+size_t UnorderedMap<K, V, Hash, KeyEqual, Allocator>::count(const K& key) const {
+  return contains(key) ? 1 : 0;
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+V& UnorderedMap<K, V, Hash, KeyEqual, Allocator>::at(const K& key) {
+  auto it = find(key);
+  if (it == end()) {
+    throw std::out_of_range("out of range");
+  }
+  return it->second;
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+const V& UnorderedMap<K, V, Hash, KeyEqual, Allocator>::at(const K& key) const {
+  auto it = find(key);
+  if (it == end()) {
+    throw std::out_of_range("out of range");
+  }
+  return it->second;
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+V& UnorderedMap<K, V, Hash, KeyEqual, Allocator>::operator[](const K& key) {
+  return try_emplace(key).first->second;
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+std::pair<typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::iterator, bool>
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::insert(const value_type& value) {
+  size_t hash = hasher_(value.first);
+  auto it = Find(value.first, hash);
+  if (it != entries_.end()) {
+    return {iterator(it), false};
+  }
+  return {iterator(Insert(hash, value)), true};
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+std::pair<typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::iterator, bool>
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::insert(value_type&& value) {
+  size_t hash = hasher_(value.first);
+  auto it = Find(value.first, hash);
+  if (it != entries_.end()) {
+    return {iterator(it), false};
+  }
+  return {iterator(Insert(hash, std::move(value))), true};
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+template<typename... Args>
+std::pair<typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::iterator, bool>
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::emplace(Args&&... args) {
+  // The key has to be known before a node is made for it.
+  return insert(value_type(std::forward<Args>(args)...));
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+template<typename... Args>
+std::pair<typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::iterator, bool>
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::try_emplace(const K& key, Args&&... args) {
+  size_t hash = hasher_(key);
+  auto it = Find(key, hash);
+  if (it != entries_.end()) {
+    return {iterator(it), false};
+  }
+  it = Insert(hash, std::piecewise_construct, std::forward_as_tuple(key),
+              std::forward_as_tuple(std::forward<Args>(args)...));
+  return {iterator(it), true};
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::iterator
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::erase(const_iterator pos) {
+  // Every entry of the list is an iterator of this map, so the const one may
+  // be turned back into a mutable one.
+  return iterator(Erase(list_iterator(pos.it_.GetNode())));
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+size_t UnorderedMap<K, V, Hash, KeyEqual, Allocator>::erase(const K& key) {
+  auto it = Find(key, hasher_(key));
+  if (it == entries_.end()) {
+    return 0;
+  }
+  Erase(it);
+  return 1;
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+void UnorderedMap<K, V, Hash, KeyEqual, Allocator>::clear() {
+  entries_ = list_type(entries_.get_allocator());
+  DeallocateBuckets(buckets_, mask_ + 1);
+  DeallocateBuckets(old_buckets_, old_mask_ + 1);
+  buckets_ = old_buckets_ = nullptr;
+  mask_ = old_mask_ = migrated_ = 0;
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+void UnorderedMap<K, V, Hash, KeyEqual, Allocator>::reserve(size_t count) {
+  size_t buckets = kMinBuckets;
+  while (buckets < count) {
+    buckets *= 2;
+  }
+  if (buckets_ != nullptr && buckets <= mask_ + 1) {
+    return;
+  }
+  FinishRehash();
+  StartRehash(buckets);
+  FinishRehash();
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+size_t UnorderedMap<K, V, Hash, KeyEqual, Allocator>::bucket_count() const {
+  return buckets_ == nullptr ? 0 : mask_ + 1;
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+float UnorderedMap<K, V, Hash, KeyEqual, Allocator>::load_factor() const {
+  return buckets_ == nullptr ? 0 : static_cast<float>(size()) / bucket_count();
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::allocator_type
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::get_allocator() const {
+  return allocator_type(entries_.get_allocator());
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::hasher
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::hash_function() const {
+  return hasher_;
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::key_equal
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::key_eq() const {
+  return key_equal_;
+}
+
+// Tells whether the bucket of hash is looked up in buckets_ rather than in
+// old_buckets_.
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+bool UnorderedMap<K, V, Hash, KeyEqual, Allocator>::Migrated(size_t hash) const {
+  return old_buckets_ == nullptr || (hash & old_mask_) < migrated_;
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::list_iterator&
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::Bucket(size_t hash) {
+  return Migrated(hash) ? buckets_[hash & mask_] : old_buckets_[hash & old_mask_];
+}
+
+// Whether an entry with other_hash next to one with hash in the list is part
+// of the same bucket. Entries of old and new buckets never mix: an entry of
+// the new array maps to an old bucket which was carried over already, and an
+// entry of the old array to one which was not.
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+bool UnorderedMap<K, V, Hash, KeyEqual, Allocator>::SameBucket(size_t hash, size_t other_hash) const {
+  size_t mask = Migrated(hash) ? mask_ : old_mask_;
+  return ((hash ^ other_hash) & mask) == 0;
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::list_iterator
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::Find(const K& key, size_t hash) {
+  if (buckets_ == nullptr) {
+    return entries_.end();
+  }
+  for (auto it = Bucket(hash); it != entries_.end() && SameBucket(hash, it->hash); ++it) {
+    if (it->hash == hash && key_equal_(it->value.first, key)) {
+      return it;
+    }
+  }
+  return entries_.end();
+}
+
+// Links a new entry constructed from args into the bucket of hash, growing
+// the bucket array first if the entry would not fit.
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+template<typename... Args>
+typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::list_iterator
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::Insert(size_t hash, Args&&... args) {
+  if (buckets_ == nullptr) {
+    StartRehash(kMinBuckets);
+  } else if (old_buckets_ != nullptr) {
+    Migrate(kRehashStep);
+  } else if (entries_.size() > mask_) {
+    StartRehash(2 * (mask_ + 1));
+  }
+  list_iterator& bucket = Bucket(hash);
+  auto pos = bucket == entries_.end() ? entries_.begin() : bucket;
+  bucket = entries_.emplace(pos, hash, std::forward<Args>(args)...);
+  return bucket;
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::list_iterator
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::Erase(list_iterator pos) {
+  list_iterator& bucket = Bucket(pos->hash);
+  if (bucket == pos) {
+    auto next = std::next(pos);
+    bucket = next != entries_.end() && SameBucket(pos->hash, next->hash) ? next : entries_.end();
+  }
+  return entries_.erase(pos);
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+typename UnorderedMap<K, V, Hash, KeyEqual, Allocator>::list_iterator*
+UnorderedMap<K, V, Hash, KeyEqual, Allocator>::AllocateBuckets(size_t count) {
+  auto buckets = bucket_allocator_.allocate(count);
+  for (size_t i = 0; i < count; ++i) {
+    std::allocator_traits<bucket_allocator_type>::construct(bucket_allocator_, buckets + i, entries_.end());
+  }
+  return buckets;
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+void UnorderedMap<K, V, Hash, KeyEqual, Allocator>::DeallocateBuckets(list_iterator* buckets, size_t count) {
+  if (buckets == nullptr) {
+    return;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    std::allocator_traits<bucket_allocator_type>::destroy(bucket_allocator_, buckets + i);
+  }
+  bucket_allocator_.deallocate(buckets, count);
+}
+
+// Makes a new array of count buckets current, leaving the entries in the
+// old one to be carried over by Migrate. Needs no rehash in progress.
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+void UnorderedMap<K, V, Hash, KeyEqual, Allocator>::StartRehash(size_t count) {
+  auto buckets = AllocateBuckets(count);
+  if (buckets_ == nullptr) {
+    buckets_ = buckets;
+    mask_ = count - 1;
+    return;
+  }
+  old_buckets_ = buckets_;
+  old_mask_ = mask_;
+  migrated_ = 0;
+  buckets_ = buckets;
+  mask_ = count - 1;
+}
+
+// Carries up to count old buckets over to the new array. Every entry of an
+// old bucket moves to the front of its new bucket, which splits no bucket of
+// either array.
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+void UnorderedMap<K, V, Hash, KeyEqual, Allocator>::Migrate(size_t count) {
+  size_t last = std::min(migrated_ + count, old_mask_ + 1);
+  for (; migrated_ < last; ++migrated_) {
+    // Moved entries may land right behind the rest of the old bucket, so
+    // its length is taken before any of them moves.
+    size_t length = 0;
+    for (auto it = old_buckets_[migrated_];
+         it != entries_.end() && (it->hash & old_mask_) == migrated_; ++it) {
+      ++length;
+    }
+    auto it = old_buckets_[migrated_];
+    for (size_t i = 0; i < length; ++i) {
+      auto next = std::next(it);
+      list_iterator& bucket = buckets_[it->hash & mask_];
+      entries_.splice(bucket == entries_.end() ? entries_.begin() : bucket, entries_, it);
+      bucket = it;
+      it = next;
+    }
+    old_buckets_[migrated_] = entries_.end();
+  }
+  if (migrated_ > old_mask_) {
+    DeallocateBuckets(std::exchange(old_buckets_, nullptr), old_mask_ + 1);
+    old_mask_ = migrated_ = 0;
+  }
+}
+
+template<typename K, typename V, typename Hash, typename KeyEqual, typename Allocator>
+void UnorderedMap<K, V, Hash, KeyEqual, Allocator>::FinishRehash() {
+  if (old_buckets_ != nullptr) {
+    Migrate(old_mask_ + 1);
+  }
+}
+
+#endif//LIST__UNORDERED_MAP_H_
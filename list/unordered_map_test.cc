@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "unordered_map.h"
+
+namespace {
+
+// Multiples of eight: all keys start out in one bucket and every doubling
+// of the bucket count splits the buckets they share.
+struct SpreadingHash {
+  size_t operator()(int key) const {
+    return static_cast<size_t>(key) * 8;
+  }
+};
+
+template<typename Map>
+void ExpectEqual(const Map& map, const std::unordered_map<int, std::string>& expected, int max_key) {
+  ASSERT_EQ(map.size(), expected.size());
+  for (int key = 0; key < max_key; ++key) {
+    auto it = expected.find(key);
+    auto found = map.find(key);
+    if (it == expected.end()) {
+      ASSERT_TRUE(found == map.end()) << "key " << key;
+      ASSERT_FALSE(map.contains(key));
+    } else {
+      ASSERT_TRUE(found != map.end()) << "key " << key;
+      ASSERT_EQ(found->second, it->second) << "key " << key;
+    }
+  }
+  // Iteration visits every entry once.
+  size_t visited = 0;
+  for (const auto& [key, value] : map) {
+    ASSERT_EQ(expected.at(key), value);
+    ++visited;
+  }
+  ASSERT_EQ(visited, expected.size());
+}
+
+// Checks every key after every insertion and erasure, so that lookups are
+// made while old buckets are being carried over, whatever their state.
+template<typename Hash>
+void RunAgainstStdUnorderedMap(unsigned seed) {
+  std::mt19937 random(seed);
+  UnorderedMap<int, std::string, Hash> map;
+  std::unordered_map<int, std::string> expected;
+  const int kKeys = 600;
+  for (int i = 0; i < 6000; ++i) {
+    int key = static_cast<int>(random() % kKeys);
+    // Grows for the first half, then shrinks and grows again.
+    bool grow = i < 3000 ? random() % 4 != 0 : random() % 2 == 0;
+    if (grow) {
+      auto [it, inserted] = map.insert({key, std::to_string(i)});
+      auto expected_inserted = expected.insert({key, std::to_string(i)}).second;
+      ASSERT_EQ(inserted, expected_inserted);
+      ASSERT_EQ(it->first, key);
+    } else {
+      ASSERT_EQ(map.erase(key), expected.erase(key));
+    }
+    ASSERT_LE(map.load_factor(), 1.0f);
+    ExpectEqual(map, expected, kKeys);
+  }
+}
+
+TEST(UnorderedMapTest, LookupsMatchWhileRehashing) {
+  RunAgainstStdUnorderedMap<std::hash<int>>(1);
+  RunAgainstStdUnorderedMap<SpreadingHash>(2);
+}
+
+// Pointers to values stay valid while the entries are spliced to new
+// buckets, and erasing through iterators works in any bucket state.
+TEST(UnorderedMapTest, ReferencesSurviveRehashing) {
+  UnorderedMap<int, std::string, SpreadingHash> map;
+  std::vector<std::string*> values;
+  for (int key = 0; key < 5000; ++key) {
+    values.push_back(&map[key]);
+    *values.back() = std::to_string(key);
+    if (key % 3 == 0) {
+      ASSERT_EQ(&map.at(key / 2), values[key / 2]);
+    }
+  }
+  for (int key = 0; key < 5000; ++key) {
+    ASSERT_EQ(*values[key], std::to_string(key));
+    ASSERT_EQ(&map.find(key)->second, values[key]);
+  }
+  std::unordered_map<int, std::string> expected;
+  for (auto it = map.begin(); it != map.end();) {
+    if (it->first % 2 == 0) {
+      it = map.erase(it);
+    } else {
+      expected.insert({it->first, it->second});
+      ++it;
+    }
+  }
+  ExpectEqual(map, expected, 5000);
+}
+
+TEST(UnorderedMapTest, CopiesAndReserveMidRehash) {
+  UnorderedMap<int, std::string> map;
+  std::unordered_map<int, std::string> expected;
+  // The 65th entry starts growing to 128 buckets, and the 66th carries over
+  // only a few of the old ones.
+  for (int key = 0; key < 66; ++key) {
+    map.emplace(key, std::to_string(key));
+    expected.emplace(key, std::to_string(key));
+  }
+  UnorderedMap<int, std::string> copy = map;
+  ExpectEqual(copy, expected, 100);
+  UnorderedMap<int, std::string> assigned;
+  assigned[1000] = "x";
+  assigned = map;
+  ExpectEqual(assigned, expected, 1001);
+  map.reserve(1000);
+  EXPECT_GE(map.bucket_count(), 1000u);
+  ExpectEqual(map, expected, 100);
+  size_t buckets = map.bucket_count();
+  for (int key = 66; key < 1000; ++key) {
+    map.try_emplace(key, std::to_string(key));
+    expected.emplace(key, std::to_string(key));
+  }
+  EXPECT_EQ(map.bucket_count(), buckets);
+  ExpectEqual(map, expected, 1000);
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_THROW(map.at(1), std::out_of_range);
+}
+
+}  // namespace
@@ -0,0 +1,659 @@
+#ifndef LIST__UNROLLED_LIST_H_
+#define LIST__UNROLLED_LIST_H_
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <sys/types.h>
+
+// Doubly linked list which keeps up to K elements in every node. Nodes are
+// split when an insert hits a full one. An erase leaving a node less than
+// half full merges it with a neighbour or has it borrow from the next one,
+// so erasing never leaves a node but the last under K / 2 elements, and
+// traversal touches about one node per K / 2 elements at worst. insert and
+// erase invalidate iterators into the nodes they reshape, iterators into
+// other nodes stay valid.
+//
+// Elements are shifted within and between nodes in place if they move
+// without throwing. Otherwise the nodes an insert or erase reshapes are
+// rebuilt from copies first, so that a throwing copy leaves the list as it
+// was.
+template<typename T, size_t K, typename Allocator = std::allocator<T>>
+class UnrolledList {
+  static_assert(K > 0, "UnrolledList needs at least one element per node");
+
+ private:
+  template <bool is_const>
+  class CommonIterator;
+
+ public:
+  using iterator = CommonIterator<false>;
+  using const_iterator = CommonIterator<true>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  using allocator_type = Allocator;
+
+  UnrolledList();
+  UnrolledList(size_t n);
+  UnrolledList(size_t n, const T& value);
+  UnrolledList(Allocator allocator);
+  UnrolledList(size_t n, Allocator allocator);
+  UnrolledList(size_t n, const T& value, Allocator allocator);
+  UnrolledList(const UnrolledList& other);
+  ~UnrolledList();
+
+  UnrolledList& operator=(const UnrolledList& other);
+
+  void push_back(const T& value);
+  void push_front(const T& value);
+  void pop_back();
+  void pop_front();
+
+  iterator begin();
+  const_iterator begin() const;
+  const_iterator cbegin() const;
+  iterator end();
+  const_iterator end() const;
+  const_iterator cend() const;
+
+  reverse_iterator rbegin();
+  const_reverse_iterator rbegin() const;
+  const_reverse_iterator crbegin() const;
+  reverse_iterator rend();
+  const_reverse_iterator rend() const;
+  const_reverse_iterator crend() const;
+
+  iterator insert(const_iterator pos, const T& value);
+  iterator insert(const_iterator pos);
+  iterator erase(const_iterator pos);
+
+  size_t size() const;
+  allocator_type get_allocator() const;
+
+ private:
+  struct BaseNode;
+  struct Node;
+
+  using base_allocator_type = typename std::allocator_traits<Allocator>::template rebind_alloc<BaseNode>;
+  using inner_allocator_type = typename std::allocator_traits<Allocator>::template rebind_alloc<Node>;
+
+  static T* Slot(BaseNode* node, size_t idx);
+  static void Relocate(T* to, T* from);
+  static constexpr bool RelocatesInPlace();
+
+  template<typename... Args>
+  iterator Emplace(const_iterator pos, Args&&... args);
+  BaseNode* CreateNode(BaseNode* prev);
+  void DestroyNode(BaseNode* node);
+  void ClearNode(BaseNode* node);
+  void Append(BaseNode* to, BaseNode* from, size_t n);
+  BaseNode* Rebuild(BaseNode* first, BaseNode* last, const T* skip, size_t put, T* value, size_t cut);
+  iterator IteratorAt(BaseNode* node, size_t idx);
+  void Swap(UnrolledList& other);
+
+  size_t size_ = 0;
+  BaseNode* sentinel_;
+  inner_allocator_type allocator_;
+  base_allocator_type base_allocator_;
+};
+
+template<typename T, size_t K, typename Allocator>
+struct UnrolledList<T, K, Allocator>::BaseNode {
+  BaseNode* prev;
+  BaseNode* next;
+  size_t count = 0;
+};
+
+template<typename T, size_t K, typename Allocator>
+struct UnrolledList<T, K, Allocator>::Node : BaseNode {
+  Node() {}
+  alignas(T) unsigned char storage[sizeof(T) * K];
+};
+
+template<typename T, size_t K, typename Allocator>
+template <bool is_const>
+class UnrolledList<T, K, Allocator>::CommonIterator {
+ public:
+  using iterator_category = std::bidirectional_iterator_tag;
+  using value_type = T;
+  using difference_type = ssize_t;
+  using pointer = typename std::conditional<is_const, const T*, T*>::type;
+  using reference = typename std::conditional<is_const, const T&, T&>::type;
+
+  CommonIterator() = default;
+  CommonIterator(BaseNode* node, size_t idx);
+
+  CommonIterator<is_const>& operator++();
+  CommonIterator<is_const>& operator--();
+  CommonIterator<is_const> operator++(int);
+  CommonIterator<is_const> operator--(int);
+
+  bool operator==(const CommonIterator<true>& other) const;
+  bool operator!=(const CommonIterator<true>& other) const;
+
+  reference operator*() const;
+  pointer operator->() const;
+
+  BaseNode* GetNode() const {
+    return node_;
+  }
+  size_t GetIdx() const {
+    return idx_;
+  }
+
+  operator CommonIterator<true>() const;
+
+  friend class CommonIterator<!is_const>;
+
+ private:
+  BaseNode* node_ = nullptr;
+  size_t idx_ = 0;
+};
+
+template<typename T, size_t K, typename Allocator>
+template<bool is_const>
+UnrolledList<T, K, Allocator>::CommonIterator<is_const>::CommonIterator(BaseNode* node, size_t idx)
+    : node_(node), idx_(idx) {
+}
+
+template<typename T, size_t K, typename Allocator>
+template<bool is_const>
+typename UnrolledList<T, K, Allocator>::template CommonIterator<is_const>&
+UnrolledList<T, K, Allocator>::CommonIterator<is_const>::operator++() {
+  if (++idx_ == node_->count) {
+    node_ = node_->next;
+    idx_ = 0;
+  }
+  return *this;
+}
+
+template<typename T, size_t K, typename Allocator>
+template<bool is_const>
+typename UnrolledList<T, K, Allocator>::template CommonIterator<is_const>&
+UnrolledList<T, K, Allocator>::CommonIterator<is_const>::operator--() {
+  if (idx_ == 0) {
+    node_ = node_->prev;
+    idx_ = node_->count;
+  }
+  --idx_;
+  return *this;
+}
+
+template<typename T, size_t K, typename Allocator>
+template<bool is_const>
+typename UnrolledList<T, K, Allocator>::template CommonIterator<is_const>
+UnrolledList<T, K, Allocator>::CommonIterator<is_const>::operator++(int) {
+  auto tmp = *this;
+  ++(*this);
+  return tmp;
+}
+
+template<typename T, size_t K, typename Allocator>
+template<bool is_const>
+typename UnrolledList<T, K, Allocator>::template CommonIterator<is_const>
+UnrolledList<T, K, Allocator>::CommonIterator<is_const>::operator--(int) {
+  auto tmp = *this;
+  --(*this);
+  return tmp;
+}
+
+template<typename T, size_t K, typename Allocator>
+template<bool is_const>
+bool UnrolledList<T, K, Allocator>::CommonIterator<is_const>::operator==(const CommonIterator<true>& other) const {
+  return node_ == other.node_ && idx_ == other.idx_;
+}
+
+template<typename T, size_t K, typename Allocator>
+template<bool is_const>
+bool UnrolledList<T, K, Allocator>::CommonIterator<is_const>::operator!=(const CommonIterator<true>& other) const {
+  return !(*this == other);
+}
+
+template<typename T, size_t K, typename Allocator>
+template<bool is_const>
+typename UnrolledList<T, K, Allocator>::template CommonIterator<is_const>::reference
+UnrolledList<T, K, Allocator>::CommonIterator<is_const>::operator*() const {
+  return *Slot(node_, idx_);
+}
+
+template<typename T, size_t K, typename Allocator>
+template<bool is_const>
+typename UnrolledList<T, K, Allocator>::template CommonIterator<is_const>::pointer
+UnrolledList<T, K, Allocator>::CommonIterator<is_const>::operator->() const {
+  return Slot(node_, idx_);
+}
+
+template<typename T, size_t K, typename Allocator>
+template<bool is_const>
+UnrolledList<T, K, Allocator>::CommonIterator<is_const>::operator CommonIterator<true>() const {
+  return const_iterator(node_, idx_);
+}
+
+template<typename T, size_t K, typename Allocator>
+T* UnrolledList<T, K, Allocator>::Slot(BaseNode* node, size_t idx) {
+  return std::launder(reinterpret_cast<T*>(static_cast<Node*>(node)->storage)) + idx;
+}
+
+template<typename T, size_t K, typename Allocator>
+void UnrolledList<T, K, Allocator>::Relocate(T* to, T* from) {
+  new (to) T(std::move_if_noexcept(*from));
+  from->~T();
+}
+
+// Whether Relocate cannot throw, which shifting elements in place relies
+// on: a throw halfway would leave slots counted as live moved out of.
+template<typename T, size_t K, typename Allocator>
+constexpr bool UnrolledList<T, K, Allocator>::RelocatesInPlace() {
+  return std::is_nothrow_move_constructible_v<T>;
+}
+
+template<typename T, size_t K, typename Allocator>
+UnrolledList<T, K, Allocator>::UnrolledList(Allocator allocator) : allocator_(allocator), base_allocator_(allocator) {
+  sentinel_ = base_allocator_.allocate(1);
+  std::allocator_traits<base_allocator_type>::construct(base_allocator_, sentinel_);
+  sentinel_->prev = sentinel_->next = sentinel_;
+}
+
+template<typename T, size_t K, typename Allocator>
+UnrolledList<T, K, Allocator>::UnrolledList(size_t n, Allocator allocator) : UnrolledList(allocator) {
+  while (n--) {
+    insert(end());
+  }
+}
+
+template<typename T, size_t K, typename Allocator>
+UnrolledList<T, K, Allocator>::UnrolledList(size_t n, const T& value, Allocator allocator) : UnrolledList(allocator) {
+  while (n--) {
+    push_back(value);
+  }
+}
+
+template<typename T, size_t K, typename Allocator>
+UnrolledList<T, K, Allocator>::UnrolledList() : UnrolledList(Allocator()) {}
+
+template<typename T, size_t K, typename Allocator>
+UnrolledList<T, K, Allocator>::UnrolledList(size_t n) : UnrolledList(n, Allocator()) {}
+
+template<typename T, size_t K, typename Allocator>
+UnrolledList<T, K, Allocator>::UnrolledList(size_t n, const T& value) : UnrolledList(n, value, Allocator()) {}
+
+template<typename T, size_t K, typename Allocator>
+UnrolledList<T, K, Allocator>::UnrolledList(const UnrolledList& other)
+    : UnrolledList(std::allocator_traits<inner_allocator_type>::select_on_container_copy_construction(other.allocator_)) {
+  for (const auto& elem : other) {
+    push_back(elem);
+  }
+}
+
+template<typename T, size_t K, typename Allocator>
+UnrolledList<T, K, Allocator>::~UnrolledList() {
+  while (sentinel_->next != sentinel_) {
+    ClearNode(sentinel_->next);
+  }
+  std::allocator_traits<base_allocator_type>::destroy(base_allocator_, sentinel_);
+  base_allocator_.deallocate(sentinel_, 1);
+}
+
+template<typename T, size_t K, typename Allocator>
+UnrolledList<T, K, Allocator>& UnrolledList<T, K, Allocator>::operator=(const UnrolledList& other) {
+  if (this == &other) {
+    return *this;
+  }
+  Allocator allocator = allocator_;
+  if (std::allocator_traits<allocator_type>::propagate_on_container_copy_assignment::value) {
+    allocator = other.get_allocator();
+  }
+  UnrolledList tmp(allocator);
+  for (const auto& elem : other) {
+    tmp.push_back(elem);
+  }
+  Swap(tmp);
+  return *this;
+}
+
+template<typename T, size_t K, typename Allocator>
+void UnrolledList<T, K, Allocator>::Swap(UnrolledList& other) {
+  std::swap(size_, other.size_);
+  std::swap(sentinel_, other.sentinel_);
+  std::swap(allocator_, other.allocator_);
+  std::swap(base_allocator_, other.base_allocator_);
+}
+
+template<typename T, size_t K, typename Allocator>
+void UnrolledList<T, K, Allocator>::push_back(const T& value) {
+  insert(end(), value);
+}
+
+template<typename T, size_t K, typename Allocator>
+void UnrolledList<T, K, Allocator>::push_front(const T& value) {
+  insert(begin(), value);
+}
+
+template<typename T, size_t K, typename Allocator>
+void UnrolledList<T, K, Allocator>::pop_back() {
+  erase(std::prev(end()));
+}
+
+template<typename T, size_t K, typename Allocator>
+void UnrolledList<T, K, Allocator>::pop_front() {
+  erase(begin());
+}
+
+template<typename T, size_t K, typename Allocator>
+typename UnrolledList<T, K, Allocator>::iterator UnrolledList<T, K, Allocator>::begin() {
+  return iterator(sentinel_->next, 0);
+}
+
+template<typename T, size_t K, typename Allocator>
+typename UnrolledList<T, K, Allocator>::const_iterator UnrolledList<T, K, Allocator>::begin() const {
+  return const_iterator(sentinel_->next, 0);
+}
+
+template<typename T, size_t K, typename Allocator>
+typename UnrolledList<T, K, Allocator>::const_iterator UnrolledList<T, K, Allocator>::cbegin() const {
+  return begin();
+}
+
+template<typename T, size_t K, typename Allocator>
+typename UnrolledList<T, K, Allocator>::iterator UnrolledList<T, K, Allocator>::end() {
+  return iterator(sentinel_, 0);
+}
+
+template<typename T, size_t K, typename Allocator>
+typename UnrolledList<T, K, Allocator>::const_iterator UnrolledList<T, K, Allocator>::end() const {
+  return const_iterator(sentinel_, 0);
+}
+
+template<typename T, size_t K, typename Allocator>
+typename UnrolledList<T, K, Allocator>::const_iterator UnrolledList<T, K, Allocator>::cend() const {
+  return end();
+}
+
+template<typename T, size_t K, typename Allocator>
+typename UnrolledList<T, K, Allocator>::reverse_iterator UnrolledList<T, K, Allocator>::rbegin() {
+  return reverse_iterator(end());
+}
+
+template<typename T, size_t K, typename Allocator>
+typename UnrolledList<T, K, Allocator>::const_reverse_iterator UnrolledList<T, K, Allocator>::rbegin() const {
+  return const_reverse_iterator(end());
+}
+
+template<typename T, size_t K, typename Allocator>
+typename UnrolledList<T, K, Allocator>::const_reverse_iterator UnrolledList<T, K, Allocator>::crbegin() const {
+  return const_reverse_iterator(end());
+}
+
+template<typename T, size_t K, typename Allocator>
+typename UnrolledList<T, K, Allocator>::reverse_iterator UnrolledList<T, K, Allocator>::rend() {
+  return reverse_iterator(begin());
+}
+
+template<typename T, size_t K, typename Allocator>
+typename UnrolledList<T, K, Allocator>::const_reverse_iterator UnrolledList<T, K, Allocator>::rend() const {
+  return const_reverse_iterator(begin());
+}
+
+template<typename T, size_t K, typename Allocator>
+typename UnrolledList<T, K, Allocator>::const_reverse_iterator UnrolledList<T, K, Allocator>::crend() const {
+  return const_reverse_iterator(begin());
+}
+
+template<typename T, size_t K, typename Allocator>
+typename UnrolledList<T, K, Allocator>::BaseNode* UnrolledList<T, K, Allocator>::CreateNode(BaseNode* prev) {
+  Node* ptr = allocator_.allocate(1);
+  std::allocator_traits<inner_allocator_type>::construct(allocator_, ptr);
+  ptr->prev = prev;
+  ptr->next = prev->next;
+  prev->next->prev = ptr;
+  prev->next = ptr;
+  return ptr;
+}
+
+template<typename T, size_t K, typename Allocator>
+void UnrolledList<T, K, Allocator>::DestroyNode(BaseNode* node) {
+  node->prev->next = node->next;
+  node->next->prev = node->prev;
+  Node* ptr = static_cast<Node*>(node);
+  std::allocator_traits<inner_allocator_type>::destroy(allocator_, ptr);
+  allocator_.deallocate(ptr, 1);
+}
+
+template<typename T, size_t K, typename Allocator>
+void UnrolledList<T, K, Allocator>::ClearNode(BaseNode* node) {
+  if constexpr (!std::is_trivially_destructible_v<T>) {
+    for (size_t i = 0; i < node->count; ++i) {
+      Slot(node, i)->~T();
+    }
+  }
+  node->count = 0;
+  DestroyNode(node);
+}
+
+// Moves the first n elements of from to the end of to.
+template<typename T, size_t K, typename Allocator>
+void UnrolledList<T, K, Allocator>::Append(BaseNode* to, BaseNode* from, size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    Relocate(Slot(to, to->count + i), Slot(from, i));
+  }
+  for (size_t i = n; i < from->count; ++i) {
+    Relocate(Slot(from, i - n), Slot(from, i));
+  }
+  to->count += n;
+  from->count -= n;
+}
+
+// Replaces the nodes from first to last with new ones holding copies of
+// their elements but skip, with value put at index put of the result, the
+// first cut of them in one node and the others in a second. The old nodes
+// are destroyed only once every copy succeeded, and a throwing copy leaves
+// them in the list as they were. Returns the first new node.
+template<typename T, size_t K, typename Allocator>
+typename UnrolledList<T, K, Allocator>::BaseNode* UnrolledList<T, K, Allocator>::Rebuild(
+    BaseNode* first, BaseNode* last, const T* skip, size_t put, T* value, size_t cut) {
+  BaseNode* front = CreateNode(first->prev);
+  BaseNode* back = nullptr;
+  try {
+    BaseNode* to = front;
+    size_t built = 0;
+    auto append = [&](T& from) {
+      if (built++ == cut) {
+        back = CreateNode(last);
+        to = back;
+      }
+      new (Slot(to, to->count)) T(std::move_if_noexcept(from));
+      ++to->count;
+    };
+    for (BaseNode* node = first;; node = node->next) {
+      for (size_t i = 0; i < node->count; ++i) {
+        if (value != nullptr && built == put) {
+          append(*value);
+        }
+        if (Slot(node, i) != skip) {
+          append(*Slot(node, i));
+        }
+      }
+      if (node == last) {
+        break;
+      }
+    }
+    if (value != nullptr && built == put) {
+      append(*value);
+    }
+  } catch (...) {
+    if (back != nullptr) {
+      ClearNode(back);
+    }
+    ClearNode(front);
+    throw;
+  }
+  BaseNode* after = last->next;
+  for (BaseNode* node = front->next; node != after;) {
+    BaseNode* next = node->next;
+    ClearNode(node);
+    node = next;
+  }
+  return front;
+}
+
+// Iterator to the element idx places into the list from the start of node.
+template<typename T, size_t K, typename Allocator>
+typename UnrolledList<T, K, Allocator>::iterator UnrolledList<T, K, Allocator>::IteratorAt(BaseNode* node,
+                                                                                          size_t idx) {
+  while (node != sentinel_ && idx >= node->count) {
+    idx -= node->count;
+    node = node->next;
+  }
+  return iterator(node, idx);
+}
+
+template<typename T, size_t K, typename Allocator>
+template<typename... Args>
+typename UnrolledList<T, K, Allocator>::iterator UnrolledList<T, K, Allocator>::Emplace(const_iterator pos,
+                                                                                       Args&&... args) {
+  T value(std::forward<Args>(args)...);
+  BaseNode* node = pos.GetNode();
+  size_t idx = pos.GetIdx();
+  if constexpr (!RelocatesInPlace()) {
+    // Anything but appending to a node, or opening one, shifts elements.
+    if (node != sentinel_ && (idx != 0 || node->count < K)) {
+      BaseNode* rebuilt = Rebuild(node, node, nullptr, idx, &value, node->count == K ? K / 2 : K);
+      ++size_;
+      return IteratorAt(rebuilt, idx);
+    }
+  }
+  if (node == sentinel_) {
+    node = sentinel_->prev;
+    idx = node->count;
+    if (node == sentinel_ || node->count == K) {
+      node = CreateNode(sentinel_->prev);
+      idx = 0;
+    }
+  } else if (node->count == K && idx == 0) {
+    // Appending to a previous node with room or opening a fresh one keeps
+    // repeated push_front from splitting every node in half.
+    if (node->prev == sentinel_ || node->prev->count == K) {
+      node = CreateNode(node->prev);
+    } else {
+      node = node->prev;
+      idx = node->count;
+    }
+  } else if (node->count == K) {
+    // Relocate does not throw here, so node is never left counting slots
+    // moved out of.
+    BaseNode* fresh = CreateNode(node);
+    for (size_t i = K / 2; i < K; ++i) {
+      Relocate(Slot(fresh, i - K / 2), Slot(node, i));
+    }
+    node->count = K / 2;
+    fresh->count = K - K / 2;
+    if (idx > K / 2) {
+      node = fresh;
+      idx -= K / 2;
+    }
+  }
+
+  for (size_t i = node->count; i > idx; --i) {
+    Relocate(Slot(node, i), Slot(node, i - 1));
+  }
+  try {
+    new (Slot(node, idx)) T(std::move(value));
+  } catch (...) {
+    // Only elements with throwing moves get here, which shifted nothing.
+    if (node->count == 0) {
+      DestroyNode(node);
+    }
+    throw;
+  }
+  ++node->count;
+  ++size_;
+  return iterator(node, idx);
+}
+
+template<typename T, size_t K, typename Allocator>
+typename UnrolledList<T, K, Allocator>::iterator UnrolledList<T, K, Allocator>::insert(const_iterator pos,
+                                                                                      const T& value) {
+  return Emplace(pos, value);
+}
+
+template<typename T, size_t K, typename Allocator>
+typename UnrolledList<T, K, Allocator>::iterator UnrolledList<T, K, Allocator>::insert(const_iterator pos) {
+  return Emplace(pos);
+}
+
+template<typename T, size_t K, typename Allocator>
+typename UnrolledList<T, K, Allocator>::iterator UnrolledList<T, K, Allocator>::erase(const_iterator pos) {
+  BaseNode* node = pos.GetNode();
+  size_t idx = pos.GetIdx();
+  BaseNode* prev = node->prev;
+  BaseNode* next = node->next;
+  size_t count = node->count - 1;
+  if (count == 0) {
+    ClearNode(node);
+    --size_;
+    return iterator(next, 0);
+  }
+
+  // A node left less than half full merges into the previous node if they
+  // fit in one, else takes in the next node if they fit, else borrows the
+  // first element of the next node. The next node has more than K - count
+  // elements then, and keeps at least K / 2 of them.
+  bool into_prev = false;
+  bool take_next = false;
+  bool borrow = false;
+  if (count < K / 2 && next != sentinel_) {
+    into_prev = prev != sentinel_ && prev->count + count <= K;
+    take_next = !into_prev && count + next->count <= K;
+    borrow = !into_prev && !take_next;
+  }
+
+  if constexpr (!RelocatesInPlace()) {
+    if (into_prev || take_next || borrow || idx != count) {
+      BaseNode* first = into_prev ? prev : node;
+      BaseNode* last = into_prev ? node : (take_next || borrow ? next : node);
+      size_t before = into_prev ? prev->count : 0;
+      BaseNode* rebuilt = Rebuild(first, last, Slot(node, idx), 0, nullptr, borrow ? count + 1 : K);
+      --size_;
+      return IteratorAt(rebuilt, before + idx);
+    }
+  }
+
+  Slot(node, idx)->~T();
+  for (size_t i = idx + 1; i < node->count; ++i) {
+    Relocate(Slot(node, i - 1), Slot(node, i));
+  }
+  --node->count;
+  --size_;
+
+  if (into_prev) {
+    idx += prev->count;
+    Append(prev, node, node->count);
+    DestroyNode(node);
+    node = prev;
+  } else if (take_next) {
+    Append(node, next, next->count);
+    DestroyNode(next);
+  } else if (borrow) {
+    Append(node, next, 1);
+  }
+  if (idx == node->count) {
+    return iterator(node->next, 0);
+  }
+  return iterator(node, idx);
+}
+
+template<typename T, size_t K, typename Allocator>
+size_t UnrolledList<T, K, Allocator>::size() const {
+  return size_;
+}
+
+template<typename T, size_t K, typename Allocator>
+typename UnrolledList<T, K, Allocator>::allocator_type UnrolledList<T, K, Allocator>::get_allocator() const {
+  return allocator_;
+}
+
+#endif//LIST__UNROLLED_LIST_H_
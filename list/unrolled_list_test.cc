@@ -0,0 +1,224 @@
+#include <gtest/gtest.h>
+
+#include <iterator>
+#include <list>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "unrolled_list.h"
+
+namespace {
+
+// Elements per node, in list order, read off the nodes iterators point into.
+template<typename List>
+std::vector<size_t> NodeCounts(const List& list) {
+  std::vector<size_t> counts;
+  const void* node = nullptr;
+  for (auto it = list.begin(); it != list.end(); ++it) {
+    if (it.GetNode() != node) {
+      node = it.GetNode();
+      counts.push_back(0);
+    }
+    ++counts.back();
+  }
+  return counts;
+}
+
+template<typename List, typename T>
+void ExpectEqual(const List& list, const std::list<T>& expected) {
+  ASSERT_EQ(list.size(), expected.size());
+  auto it = expected.begin();
+  for (const auto& value : list) {
+    ASSERT_EQ(value, *it++);
+  }
+}
+
+template<typename T, size_t K>
+void ExpectHalfFull(const UnrolledList<T, K>& list) {
+  std::vector<size_t> counts = NodeCounts(list);
+  for (size_t i = 0; i + 1 < counts.size(); ++i) {
+    ASSERT_GE(counts[i], K / 2) << "node " << i << " of " << counts.size();
+  }
+}
+
+// A string whose copies may throw, as far as the list can tell, which has
+// it rebuild the nodes it reshapes instead of shifting in place.
+struct CopiedString : std::string {
+  explicit CopiedString(std::string value) : std::string(std::move(value)) {}
+  CopiedString(const CopiedString& other) : std::string(other) {}
+  CopiedString& operator=(const CopiedString& other) = default;
+};
+
+template<typename T, size_t K>
+void RunAgainstStdList() {
+  std::mt19937 random(K);
+  UnrolledList<T, K> list;
+  std::list<T> expected;
+  auto it = list.begin();
+  auto expected_it = expected.begin();
+  for (int i = 0; i < 20'000; ++i) {
+    size_t choice = random() % 8;
+    if (choice < 3 || expected.empty()) {
+      T value(std::to_string(i));
+      it = list.insert(it, value);
+      expected_it = expected.insert(expected_it, value);
+    } else if (choice < 5 && expected_it != expected.end()) {
+      it = list.erase(it);
+      expected_it = expected.erase(expected_it);
+    } else if (choice == 5) {
+      it = list.begin();
+      expected_it = expected.begin();
+    } else if (choice == 6 && expected_it != expected.end()) {
+      ++it;
+      ++expected_it;
+    } else if (expected_it != expected.begin()) {
+      --it;
+      --expected_it;
+    }
+    if (expected_it == expected.end()) {
+      ASSERT_TRUE(it == list.end());
+    } else {
+      ASSERT_EQ(*it, *expected_it);
+    }
+  }
+  ExpectEqual(list, expected);
+}
+
+template<typename Size>
+class UnrolledListTest : public ::testing::Test {};
+
+using NodeSizes = ::testing::Types<std::integral_constant<size_t, 1>, std::integral_constant<size_t, 2>,
+                                   std::integral_constant<size_t, 5>, std::integral_constant<size_t, 16>>;
+TYPED_TEST_SUITE(UnrolledListTest, NodeSizes);
+
+TYPED_TEST(UnrolledListTest, MatchesStdList) {
+  RunAgainstStdList<std::string, TypeParam::value>();
+}
+
+TYPED_TEST(UnrolledListTest, CopiedElementsMatchStdList) {
+  static_assert(!std::is_nothrow_move_constructible_v<CopiedString>);
+  RunAgainstStdList<CopiedString, TypeParam::value>();
+}
+
+TYPED_TEST(UnrolledListTest, ErasingKeepsNodesHalfFull) {
+  constexpr size_t K = TypeParam::value;
+  UnrolledList<std::string, K> list;
+  std::list<std::string> expected;
+  for (int i = 0; i < 5000; ++i) {
+    list.push_back(std::to_string(i));
+    expected.push_back(std::to_string(i));
+  }
+  // Splits leave every node half full, then erasing every other element
+  // from the front drains each node in turn.
+  for (int i = 0; i < 2000; ++i) {
+    auto it = list.begin();
+    auto expected_it = expected.begin();
+    for (int k = 0; k < 7; ++k) {
+      it = std::next(list.insert(it, "x"));
+      expected_it = std::next(expected.insert(expected_it, "x"));
+    }
+  }
+  size_t erased = 0;
+  for (auto it = list.begin(); it != list.end();) {
+    it = list.erase(it);
+    if (it != list.end()) {
+      ++it;
+    }
+    if (++erased % 97 == 0) {
+      ExpectHalfFull(list);
+    }
+  }
+  for (auto it = expected.begin(); it != expected.end();) {
+    it = expected.erase(it);
+    if (it != expected.end()) {
+      ++it;
+    }
+  }
+  ExpectEqual(list, expected);
+  while (list.size() > 0) {
+    list.pop_front();
+    if (list.size() % 97 == 0) {
+      ExpectHalfFull(list);
+    }
+  }
+}
+
+TEST(UnrolledListTest, PopFrontFreesNodes) {
+  UnrolledList<int, 64> list;
+  for (int i = 0; i < 100'000; ++i) {
+    list.push_back(i);
+  }
+  for (int i = 0; i < 99'000; ++i) {
+    list.pop_front();
+  }
+  EXPECT_LE(NodeCounts(list).size(), 1000 / 32 + 1);
+  EXPECT_EQ(*list.begin(), 99'000);
+}
+
+// Counts its live instances, and throws from the copy which copies_left
+// runs out on. Without a move constructor, moves are copies which throw.
+struct ThrowingCopy {
+  static inline int live = 0;
+  static inline int copies_left = -1;
+
+  explicit ThrowingCopy(int value) : value(value) {
+    ++live;
+  }
+  ThrowingCopy(const ThrowingCopy& other) : value(other.value) {
+    if (copies_left >= 0 && copies_left-- == 0) {
+      throw std::runtime_error("copy");
+    }
+    ++live;
+  }
+  ~ThrowingCopy() {
+    --live;
+  }
+
+  int value;
+};
+
+TEST(UnrolledListTest, ThrowingCopiesLeaveListUnchanged) {
+  UnrolledList<ThrowingCopy, 8> list;
+  for (int i = 0; i < 100; ++i) {
+    list.push_back(ThrowingCopy(i));
+  }
+  auto expect_unchanged = [&list] {
+    ASSERT_EQ(list.size(), 100u);
+    int i = 0;
+    for (const auto& value : list) {
+      ASSERT_EQ(value.value, i++);
+    }
+    EXPECT_EQ(ThrowingCopy::live, 100);
+  };
+  for (size_t pos : {0, 1, 4, 7, 8, 50, 99, 100}) {
+    for (int copies : {0, 1, 2, 5, 9, 20}) {
+      ThrowingCopy::copies_left = copies;
+      try {
+        auto it = list.insert(std::next(list.cbegin(), pos), ThrowingCopy(-1));
+        ThrowingCopy::copies_left = -1;
+        list.erase(it);
+      } catch (const std::runtime_error&) {
+      }
+      ThrowingCopy::copies_left = -1;
+      expect_unchanged();
+      if (pos == 100) {
+        continue;
+      }
+      ThrowingCopy::copies_left = copies;
+      try {
+        auto it = list.erase(std::next(list.cbegin(), pos));
+        ThrowingCopy::copies_left = -1;
+        list.insert(it, ThrowingCopy(static_cast<int>(pos)));
+      } catch (const std::runtime_error&) {
+      }
+      ThrowingCopy::copies_left = -1;
+      expect_unchanged();
+    }
+  }
+}
+
+}  // namespace